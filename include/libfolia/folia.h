@@ -29,11 +29,14 @@
 #include "libfolia/folia_types.h"
 #include "libfolia/folia_utils.h"
 #include "libfolia/folia_textpolicy.h"
+#include "libfolia/folia_arena.h"
 #include "libfolia/folia_metadata.h"
 #include "libfolia/folia_impl.h"
 #include "libfolia/folia_subclasses.h"
 #include "libfolia/folia_document.h"
 #include "libfolia/folia_engine.h"
+#include "libfolia/folia_index.h"
+#include "libfolia/folia_view.h"
 #include "libfolia/folia_provenance.h"
 
 #endif
@@ -0,0 +1,84 @@
+/*
+  Copyright (c) 2006 - 2024
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of libfolia
+
+  libfolia is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  libfolia is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcutils/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#ifndef FOLIA_ARENA_H
+#define FOLIA_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+namespace folia {
+
+  /// a simple bump allocator for the FoliaElements of one Document
+  /*!
+    When a Document uses the 'arena' mode, all FoliaElements that are created
+    while parsing are allocated from an ElementArena owned by the Document.
+    Destroying a single element runs its destructor, but the memory is only
+    released when the arena itself is deleted, together with the Document.
+    Elements on the heap carry no extra bookkeeping: release_element()
+    recognizes arena memory by looking in the blocks of the living arenas.
+
+    An ElementArena is NOT thread-safe. Use one arena per Document.
+  */
+  class ElementArena {
+  public:
+    ElementArena();
+    ~ElementArena();
+    void *allocate( size_t );
+    size_t bytes_used() const { return _used; };
+    static ElementArena *current();
+    static void *allocate_element( size_t );
+    static void release_element( void * );
+  private:
+    ElementArena( const ElementArena& ) = delete; // inhibit copies
+    ElementArena& operator=( const ElementArena& ) = delete; // inhibit copies
+    std::vector<char*> _blocks; ///< all memory blocks allocated
+    char *_pos;                 ///< the first free byte in the current block
+    size_t _left;               ///< free bytes in the current block
+    size_t _used;               ///< the total amount of bytes handed out
+  };
+
+  /// make an ElementArena the active arena for the current thread
+  /*!
+    All FoliaElements created in this thread while an arena_scope is alive
+    are allocated from that arena. The previous active arena (if any) is
+    restored when the arena_scope goes out of scope.
+    A 0 pointer is allowed, which means: use the heap.
+  */
+  class arena_scope {
+  public:
+    explicit arena_scope( ElementArena * );
+    ~arena_scope();
+  private:
+    arena_scope( const arena_scope& ) = delete; // inhibit copies
+    arena_scope& operator=( const arena_scope& ) = delete; // inhibit copies
+    ElementArena *_previous;
+  };
+
+} // namespace folia
+
+#endif // FOLIA_ARENA_H
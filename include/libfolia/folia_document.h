@@ -38,6 +38,7 @@
 #include "unicode/regex.h"
 #include "libxml/tree.h"
 #include "libxml/xpath.h"
+#include "libxml/xmlreader.h"
 #include "libfolia/folia.h"
 
 using namespace icu;
@@ -80,7 +81,17 @@ namespace folia {
   class Paragraph;
   class processor;
   class Provenance;
-
+  class ElementArena;
+  class FragmentIndex;
+  struct binary_writer;
+  struct binary_reader;
+
+  /// A FoLiA Document
+  /*!
+    Different Document objects may safely be used in different threads
+    concurrently. One Document (and its nodes) should be used by one thread
+    at a time.
+  */
   class Document {
     friend std::ostream& operator<<( std::ostream& os, const Document *d );
     /// enum Mode determines runtime characteristic of the document
@@ -95,9 +106,13 @@ namespace folia {
       STRIP=8,         //!< on output, strip
       CANONICAL=16,    //!< sort ouput in a reproducable way.
       AUTODECLARE=32,  //!< Automagicly add missing Annotation Declarations
-      EXPLICIT=64      //!< add all set information
+      EXPLICIT=64,     //!< add all set information
+      ARENA=128,       //!< allocate the FoliaElements in an ElementArena
+      TEXTCACHE=256,   //!< remember text() results until the tree changes
+      TRUSTEDOUTPUT=512 //!< don't check the text consistency on output
     };
     friend class Engine;
+    friend class Word; // uses the word index for navigation
 
   public:
     Document();
@@ -116,6 +131,9 @@ namespace folia {
       /// backward compatability. read_from_file() is preferred
       return read_from_file( s );
     }
+    FoliaElement *load_fragment( const FragmentIndex&, const std::string& );
+    bool read_binary( const std::string& );
+    void save_binary( const std::string& ) const;
     bool save( std::ostream&, const std::string&, bool = false ) const;
     bool save( std::ostream& os, bool canonical = false ) const {
       /// save a Document to a stream without using a namespace name
@@ -188,10 +206,13 @@ namespace folia {
     processor *get_processor( const std::string& ) const;
     std::vector<processor*> get_processors_by_name( const std::string& ) const;
     void add_doc_index( FoliaElement * );
-    void del_doc_index( const std::string& );
+    void del_doc_index( std::string_view, const FoliaElement * =0 );
+    void structure_changed( const FoliaElement * ) const;
+    void structure_added( const FoliaElement * ) const;
+    void structure_removed( const FoliaElement * ) const;
 
-    FoliaElement *index( const std::string& ) const; //retrieve element with specified ID
-    FoliaElement* operator []( const std::string& ) const ; //index as operator
+    FoliaElement *index( std::string_view ) const; //retrieve element with specified ID
+    FoliaElement* operator []( std::string_view ) const ; //index as operator
     bool declared( const AnnotationType&,
 		   const std::string& = "" ) const;
     bool declared( ElementType, const std::string& = "" ) const;
@@ -249,9 +270,14 @@ namespace folia {
       /// add FoliaElement \e p to the delSet
       /*!
 	\param p the FoliaElement to keep for later annihilation
-	the delSet is kept until the destruction of the Document
+	the delSet is kept until the destruction of the Document.
+	Nodes kept while the Engine flushes its output are also remembered
+	for release_kept()
        */
-      delSet.insert( p );
+      if ( delSet.insert( p ).second
+	   && _collect_released ){
+	_release_list.push_back( p );
+      }
     };
     void addExternal( External *p ) {
       /// add a node to the _externals list
@@ -276,6 +302,14 @@ namespace folia {
     /// is the AUTODECLARE mode set?
     bool autodeclare() const { return mode & AUTODECLARE; };
     bool has_explicit() const { return mode & EXPLICIT; };
+    /// is the ARENA mode set?
+    bool arena() const { return mode & ARENA; };
+    /// is the TEXTCACHE mode set?
+    bool textcache() const { return mode & TEXTCACHE; };
+    /// is the TRUSTEDOUTPUT mode set?
+    bool trusted_output() const { return mode & TRUSTEDOUTPUT; };
+    /// are we reading a tree that was validated before? (see read_binary())
+    bool trusted_input() const { return _trusted_input; };
     bool set_permissive( bool ) const; // defined const, but the mode is mutable!
     bool set_checktext( bool ) const; // defined const, but the mode is mutable!
     bool set_fixtext( bool ) const; // defined const, but the mode is mutable!
@@ -283,6 +317,9 @@ namespace folia {
     bool set_canonical( bool ) const; // defined const, but the mode is mutable!
     bool set_autodeclare( bool ) const; // defined const, but the mode is mutable!
     bool set_explicit( bool ) const; // defined const, but the mode is mutable!
+    bool set_arena( bool ) const; // defined const, but the mode is mutable!
+    bool set_textcache( bool ) const; // defined const, but the mode is mutable!
+    bool set_trusted_output( bool ) const; // defined const, but the mode is mutable!
     /// this class holds annotation declaration information
     class annotation_info {
       friend std::ostream& operator<<( std::ostream& os,
@@ -355,6 +392,7 @@ namespace folia {
       p_offset_validation_buffer.push_back( pc );
     }
     bool validate_offsets() const;
+    void validate_text() const;
     int compare_to_build_version() const;
     const std::string& version() const {
       /// return the version string
@@ -447,13 +485,37 @@ namespace folia {
     void parse_provenance( const xmlNode * );
     void parse_submeta( const xmlNode * );
     void parse_styles();
+    void parse_prelude( const xmlNode * );
+    FoliaElement *parse_reader( xmlTextReader *, const int& );
+    void text_sweep( FoliaElement *, bool, bool,
+		     bool = false, bool = false ) const;
+    void write_binary_node( binary_writer&, const FoliaElement * ) const;
+    void read_binary_node( binary_reader&, FoliaElement * );
     void add_annotations( xmlNode * ) const;
     void add_provenance( xmlNode * ) const;
     void add_metadata( xmlNode * ) const;
     void add_submetadata( xmlNode *) const;
     void add_styles( xmlDoc* ) const;
+    const std::vector<Word*>& word_index() const;
+    const std::vector<Sentence*>& sentence_index() const;
+    const std::vector<Paragraph*>& paragraph_index() const;
+    void invalidate_type_index() const;
+    void restamp_words( size_t ) const;
     void append_processor( xmlNode *, const processor * ) const;
-    xmlDoc *to_xmlDoc( const std::string& ="" ) const;
+    xmlDoc *to_xmlDoc( const std::string& ="",
+		       std::vector<std::string> * =0 ) const;
+    bool write_xml( xmlOutputBuffer *, const std::string&, int ) const;
+    xmlDoc *open_stream( std::ostream&, const std::string&,
+			 const FoliaElement *, std::string& ) const;
+    bool stream_tags( xmlDoc *, const FoliaElement *, int,
+		      std::string&, std::string&,
+		      std::set<const FoliaElement*>& ) const;
+    void stream_node( std::ostream&, xmlDoc *,
+		      const FoliaElement *, int ) const;
+    void destroy_flushed( FoliaElement * );
+    void release_kept();
+    void disown( FoliaElement * );
+    void reserve_index( std::streamoff );
     void add_one_anno( const std::pair<AnnotationType,std::string>&,
 		       xmlNode * ) const;
     void internal_declare( AnnotationType,
@@ -462,12 +524,26 @@ namespace folia {
 			   const std::string&, const std::string&,
 			   const std::set<std::string>&,
 			   const std::string& = "" );
-    std::map<std::string, FoliaElement* > sindex; ///< the lookup table
-    ///< for FoliaElements by index (xml:id) (not all nodes do have an index)
+    IdIndex sindex; ///< the lookup table for FoliaElements by index (xml:id)
+    ///< (not all nodes do have an index)
     //    std::vector<FoliaElement*> data;
+    mutable std::vector<Word*> _word_index; ///< cached result of words()
+    mutable std::vector<Sentence*> _sentence_index; ///< cached result of
+    ///< sentences()
+    mutable std::vector<Paragraph*> _paragraph_index; ///< cached result of
+    ///< paragraphs()
+    mutable bool _words_indexed; ///< is _word_index up to date?
+    mutable bool _sentences_indexed; ///< is _sentence_index up to date?
+    mutable bool _paragraphs_indexed; ///< is _paragraph_index up to date?
     std::vector<External*> _externals;
     std::string _id;
     std::set<FoliaElement *> delSet;
+    std::vector<FoliaElement *> _release_list; ///< the part of the delSet
+    ///< that release_kept() may free
+    bool _collect_released; ///< add kept nodes to the _release_list?
+    bool _trusted_input; ///< skip the checks that read_binary() trusts
+    ElementArena *element_arena();
+    ElementArena *_arena; ///< the arena for our FoliaElements (ARENA mode)
     FoliaElement *foliadoc;
     std::list<FoliaElement*> preludes;
     xmlDoc *_xmldoc;
@@ -32,6 +32,7 @@
 #include <set>
 #include <vector>
 #include <iostream>
+#include <functional>
 #include "ticcutils/LogStream.h"
 #include "libfolia/folia.h"
 #include "libxml/xmlreader.h"
@@ -55,12 +56,35 @@ namespace folia {
 
   void print( std::ostream&, const xml_tree* );
 
+  class text_parent_scanner;
+
   class Engine {
   public:
     /// the document type, determines the type of the top node (\<text> or \<speech>)
     enum doctype { TEXT, //!< the topnode is \<text>
 		   SPEECH //!< the topnode is \<speech>
     };
+    /// the type of the user callback for process()
+    typedef std::function<void(FoliaElement*)> node_handler;
+    class NodeMatcher {
+      /// a precompiled set of tags to search for with get_node()
+    public:
+      explicit NodeMatcher( const std::string& );
+      explicit NodeMatcher( const ElementTypeSet& );
+      void bind( xmlTextReader * ) const;
+      bool matches( const xmlChar * ) const;
+      /// does this matcher also match Processing Instructions?
+      bool match_pi() const { return _match_pi; };
+      /// the tags of this matcher, as a '|' separated list
+      const std::string& tags() const { return _tags; };
+    private:
+      void add( const std::string& );
+      std::vector<std::string> _names; //!< the tags to match
+      std::string _tags;               //!< the tags, as given
+      bool _match_pi;                  //!< match Processing Instructions too?
+      mutable std::vector<const xmlChar*> _interned; //!< _names, interned
+      ///< in the dictionary of the reader given to bind()
+    };
     Engine(); //!< default constructor. needs a call to init_doc() to get started
     explicit Engine( const std::string& i, const std::string& o="" ):
       Engine() {
@@ -74,6 +98,7 @@ namespace folia {
     virtual ~Engine();
     virtual bool init_doc( const std::string&, const std::string& ="" );
     FoliaElement *get_node( const std::string& );
+    FoliaElement *get_node( const NodeMatcher& );
     bool next() { return true; }; /// A stub. NOT needed!
     void save( const std::string&, bool=false );
     void save( std::ostream&, bool=false );
@@ -81,6 +106,9 @@ namespace folia {
     void output_footer();
     void flush();
     void finish();
+    void set_flush_limit( size_t );
+    void process( const std::string&, const node_handler&,
+		  unsigned int=0, size_t=0 );
     /// return the status of the Engine. True when still valid. False otherwise.
     bool ok() const { return _ok; };
     void un_declare( const AnnotationType&,
@@ -118,6 +146,15 @@ namespace folia {
     bool _header_done;      //!< is the header outputed yet?
     bool _finished;         //!< did we finish the whole process?
     bool _debug;            //!< is debug on?
+    bool _last_open;        //!< may _last_added still get children?
+    xmlDoc *_stream_doc;    //!< the skeleton used for incremental output
+    std::vector<std::pair<FoliaElement*,std::string>> _open_tags; //!< the
+    ///< elements (and their end tags) which are partially output
+    size_t _flush_limit;    //!< auto flush when more nodes are pending
+    size_t _pending_nodes;  //!< (estimated) number of nodes in _out_doc
+    size_t _kept_nodes;     //!< number of nodes kept by the last flush()
+    std::set<FoliaElement*> _pinned; //!< nodes still handled by a worker
+    NodeMatcher *_last_matcher; //!< the matcher for the last get_node( tag )
 
     FoliaElement *handle_match( const std::string&, int );
     void handle_element( const std::string&, int );
@@ -127,6 +164,13 @@ namespace folia {
     void add_PI( int );
     void add_text( int );
     void append_node( FoliaElement *, int );
+    std::vector<FoliaElement*> open_path() const;
+    bool flush_children( size_t, const std::vector<FoliaElement*>&,
+			 const std::set<FoliaElement*>& );
+    void auto_flush();
+    std::string scratch_template() const;
+    void run_pipeline( const std::function<FoliaElement*()>&,
+		       const node_handler&, unsigned int, size_t );
   };
 
   class TextEngine: public Engine {
@@ -134,9 +178,12 @@ namespace folia {
     TextEngine(): Engine(), //!< default construcor. Needs a call to init_doc()
 		  _next_text_node(0),
 		  _node_count(0),
+		  _scanner(0),
+		  _has_text_parents(false),
 		  _is_setup(false)
     {
     };
+    ~TextEngine() override;
     explicit TextEngine( const std::string& i, const std::string& o="" ):
       TextEngine(){
       /// construct a TextEngine
@@ -148,14 +195,13 @@ namespace folia {
       TextEngine::init_doc( i, o );
     }
     bool init_doc( const std::string&, const std::string& ="" ) override;
-    void setup( const std::string& ="", bool = false );
+    void setup( const std::string& ="", bool = false, bool = false );
     const std::map<int,int>& enumerate_text_parents( const std::string& ="",
 						     bool = false );
-    size_t text_parent_count() const {
-      /// return the number of textparents found
-      return text_parent_map.size();
-    };
+    size_t text_parent_count() const;
     FoliaElement *next_text_parent();
+    using Engine::process;
+    void process( const node_handler&, unsigned int=0, size_t=0 );
   private:
     int _next_text_node;
     int _node_count;
@@ -163,6 +209,10 @@ namespace folia {
     std::map<int,int> text_parent_map;
     std::map<int,int> search_text_parents( const xml_tree*,
 					   const std::string&, bool ) const;
+    text_parent_scanner *_scanner; //!< a second reader, that finds the text
+    //!< parents just ahead of the main one. Only without prefer_struct
+    std::string _textclass;  //!< the textclass given to setup()
+    bool _has_text_parents;  //!< are there any text parents at all?
     bool _is_setup;
   };
 
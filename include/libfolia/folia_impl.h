@@ -34,6 +34,8 @@
 #include <string>
 #include <iostream>
 #include <exception>
+#include <iterator>
+#include <memory>
 #include "unicode/unistr.h"
 #include "libxml/tree.h"
 
@@ -69,6 +71,7 @@ namespace folia {
   class Morpheme;
   class MetaData;
   class ProcessingInstruction;
+  template <typename F> class select_range;
 
   /// class used to steer 'select()' behaviour
   enum class SELECT_FLAGS {
@@ -97,6 +100,7 @@ namespace folia {
     friend std::ostream& operator<<( std::ostream&, const FoliaElement* );
     friend bool operator==( const FoliaElement&, const FoliaElement& );
     friend void destroy( FoliaElement * );
+    friend class Document; // bulk deletion in ARENA mode
   protected:
     virtual ~FoliaElement(){};
   public:
@@ -189,69 +193,53 @@ namespace folia {
 
     template <typename F>
       std::vector<F*> select( const std::string& st,
-			      const std::set<ElementType>& exclude,
+			      const ElementTypeSet& exclude,
 			      bool recurse = true ) const {
-      std::vector<FoliaElement*> tmp = select( F::PROPS.ELEMENT_ID,
-					       st,
-					       exclude,
-					       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) );
-      std::vector<F*> res;
-      for ( size_t i = 0; i < tmp.size(); ++i ){
-	res.push_back( dynamic_cast<F*>( tmp[i]) );
-      }
-      return res;
+      return collect( iter<F>( st,
+			       exclude,
+			       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) ) );
     }
 
     template <typename F>
       std::vector<F*> select( const std::string& st,
 			      bool recurse = true ) const {
-      std::vector<FoliaElement*> tmp = select( F::PROPS.ELEMENT_ID,
-					       st,
-					       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) );
-      std::vector<F*> res;
-      for ( size_t i = 0; i < tmp.size(); ++i ){
-	res.push_back( dynamic_cast<F*>( tmp[i]) );
-      }
-      return res;
+      return collect( iter<F>( st,
+			       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) ) );
     }
 
     template <typename F>
       std::vector<F*> select( const char* st,
 			      bool recurse = true ) const {
-      std::vector<FoliaElement*> tmp = select( F::PROPS.ELEMENT_ID,
-					       std::string(st),
-					       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) );
-      std::vector<F*> res;
-      for ( size_t i = 0; i < tmp.size(); ++i ){
-	res.push_back( dynamic_cast<F*>( tmp[i]) );
-      }
-      return res;
+      return collect( iter<F>( std::string(st),
+			       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) ) );
     }
 
     template <typename F>
-      std::vector<F*> select( const std::set<ElementType>& exclude,
+      std::vector<F*> select( const ElementTypeSet& exclude,
 			      bool recurse = true ) const {
-      std::vector<FoliaElement*> tmp = select( F::PROPS.ELEMENT_ID,
-					       exclude,
-					       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) );
-      std::vector<F*> res;
-      for ( size_t i = 0; i < tmp.size(); ++i ){
-	res.push_back( dynamic_cast<F*>( tmp[i]) );
-      }
-      return res;
+      return collect( iter<F>( exclude,
+			       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) ) );
     }
 
     template <typename F>
       std::vector<F*> select( bool recurse = true ) const {
-      std::vector<FoliaElement*> tmp = select( F::PROPS.ELEMENT_ID,
-					       (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) );
-      std::vector<F*> res;
-      for ( size_t i = 0; i < tmp.size(); ++i ){
-	res.push_back( dynamic_cast<F*>( tmp[i]) );
-      }
-      return res;
+      return collect( iter<F>( (recurse?SELECT_FLAGS::RECURSE : SELECT_FLAGS::LOCAL) ) );
     }
 
+    // lazy Selections. Like select(), but walking the tree on demand
+    template <typename F>
+      select_range<F> iter( const std::string&,
+			    const ElementTypeSet&,
+			    SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const;
+    template <typename F>
+      select_range<F> iter( const std::string&,
+			    SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const;
+    template <typename F>
+      select_range<F> iter( const ElementTypeSet&,
+			    SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const;
+    template <typename F>
+      select_range<F> iter( SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const;
+
     // annotations
 
     virtual bool allowannotations() const { return false; };
@@ -335,6 +323,8 @@ namespace folia {
     const std::string xmlstring( bool=true ) const; // serialize to a string (XML fragment)
     const std::string xmlstring( bool, int=0, bool=true ) const; // serialize to a string (XML fragment)
     virtual xmlNode *xml( bool, bool = false ) const = 0; //serialize to XML
+    virtual xmlNode *xml_head( bool,
+			       std::vector<std::pair<const FoliaElement*,bool>>& ) const = 0; // serialize the node only, for streaming
 
     // text/string content
     bool hastext( const std::string& = "current" ) const;
@@ -542,20 +532,24 @@ namespace folia {
     virtual std::vector<FoliaElement*> select( ElementType,
 					       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const = 0;
     virtual std::vector<FoliaElement*> select( ElementType,
-					       const std::set<ElementType>& ,
+					       const ElementTypeSet& ,
 					       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const = 0;
     virtual std::vector<FoliaElement*> select( ElementType,
 					       const std::string&,
 					       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const = 0;
     virtual std::vector<FoliaElement*> select( ElementType,
 					       const std::string&,
-					       const std::set<ElementType>& ,
+					       const ElementTypeSet& ,
 					       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const = 0;
-    virtual std::vector<FoliaElement*> select_set( const std::set<ElementType>&,
+    virtual std::vector<FoliaElement*> select_set( const ElementTypeSet&,
 						   const std::string&,
-						   const std::set<ElementType>& ,
+						   const ElementTypeSet& ,
 						   SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const = 0;
     // some 'internal stuff
+    virtual void drop_text_cache() const = 0;
+    virtual bool text_checked() const = 0;
+    virtual void set_text_checked( bool ) const = 0;
+    bool text_check_pending() const;
     virtual int refcount() const = 0;
     virtual void increfcount() = 0;
     virtual void decrefcount() = 0;
@@ -573,14 +567,175 @@ namespace folia {
     virtual const std::string& textclass() const NOT_IMPLEMENTED;
     virtual void unravel( std::set<FoliaElement*>& ) NOT_IMPLEMENTED;
     static FoliaElement *private_createElement( ElementType );
+    template <typename F>
+      static std::vector<F*> collect( select_range<F>&& );
   public:
     static FoliaElement *createElement( ElementType, Document * =0 );
     static FoliaElement *createElement( const std::string&, Document * =0 );
 
   };
 
+  /// a lazy, forward only, view on the nodes a select() would return
+  /*!
+   * The tree is walked depth-first using an explicit stack, and only as far
+   * as the caller iterates. So:
+   * \code
+   *   for ( auto *w : sent->iter<Word>() ){
+   *     if ( ... ) break;
+   *   }
+   * \endcode
+   * never builds a vector of results and stops searching at the 'break'.
+   *
+   * The semantics of the SELECT_FLAGS and the exclude set are exactly those
+   * of select(). The tree may NOT be modified while iterating.
+   */
+  template <typename F>
+    class select_range {
+  public:
+    class iterator {
+    public:
+      typedef std::input_iterator_tag iterator_category;
+      typedef F* value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef F* const* pointer;
+      typedef F* reference;
+    iterator( select_range *r=0 ): _range(r) {};
+      F* operator*() const { return dynamic_cast<F*>( _range->_current ); };
+      iterator& operator++() { _range->advance(); return *this; };
+      void operator++(int) { _range->advance(); };
+      bool operator==( const iterator& it ) const {
+	return at_end() == it.at_end();
+      };
+      bool operator!=( const iterator& it ) const { return !(*this == it); };
+    private:
+      bool at_end() const { return _range == 0 || _range->_current == 0; };
+      select_range *_range;
+    };
+
+  select_range( const FoliaElement *node,
+		const std::string *set_handle,
+		const ElementTypeSet& exclude,
+		SELECT_FLAGS flag ):
+    _root(node),
+      _set(set_handle),
+      _exclude(exclude),
+      _flag(flag),
+      _current(0)
+      {};
+    iterator begin() {
+      /// (re)start the walk, and position on the first match
+      _stack.clear();
+      _current = 0;
+      if ( _root ){
+	_stack.reserve( 16 );
+	_stack.push_back( { &_root->data(), 0, _flag } );
+	advance();
+      }
+      return iterator(this);
+    };
+    iterator end() { return iterator(); };
+  private:
+    struct frame {
+      const std::vector<FoliaElement*> *nodes; ///< the children we iterate
+      size_t pos;                              ///< the next child to visit
+      SELECT_FLAGS flag;                       ///< the strategy at this level
+    };
+    void advance() {
+      /// step to the next matching node, or to the end
+      /*!
+       * this mimics the recursion of select(): a node is tested first,
+       * and then its children are visited before its next sibbling.
+       * After a hit at a level, a TOP_HIT search becomes LOCAL for the
+       * remainder of that level.
+       */
+      _current = 0;
+      while ( !_stack.empty() ){
+	frame& f = _stack.back();
+	if ( f.pos >= f.nodes->size() ){
+	  _stack.pop_back();
+	  continue;
+	}
+	FoliaElement *el = (*f.nodes)[f.pos++];
+	bool hit = el->element_id() == F::PROPS.ELEMENT_ID
+	  && ( !_set || &el->sett() == _set );
+	if ( hit && f.flag == SELECT_FLAGS::TOP_HIT ){
+	  f.flag = SELECT_FLAGS::LOCAL;
+	}
+	if ( f.flag != SELECT_FLAGS::LOCAL
+	     && !_exclude.contains( el->element_id() ) ){
+	  SELECT_FLAGS flag = f.flag;
+	  _stack.push_back( { &el->data(), 0, flag } );
+	}
+	if ( hit ){
+	  _current = el;
+	  return;
+	}
+      }
+    }
+    const FoliaElement *_root;
+    const std::string *_set;
+    const ElementTypeSet _exclude;
+    SELECT_FLAGS _flag;
+    FoliaElement *_current;
+    std::vector<frame> _stack;
+  };
+
+  template <typename F>
+    select_range<F> FoliaElement::iter( const std::string& st,
+					const ElementTypeSet& exclude,
+					SELECT_FLAGS flag ) const {
+    /// return a lazy range over all matching nodes of type F
+    /*!
+     * \param st when not empty ("") we also must match on the 'sett' of
+     * the nodes
+     * \param exclude a set of ElementType to exclude from searching.
+     * These are skipped, and NOT recursed into.
+     * \param flag the SELECT_FLAGS strategy, as in select()
+     */
+    const std::string *set_handle = 0;
+    if ( !st.empty() ){
+      set_handle = interned_string::lookup( st );
+      if ( !set_handle ){
+	// no element can have this set. return an empty range
+	return select_range<F>( 0, 0, exclude, flag );
+      }
+    }
+    return select_range<F>( this, set_handle, exclude, flag );
+  }
+
+  template <typename F>
+    select_range<F> FoliaElement::iter( const std::string& st,
+					SELECT_FLAGS flag ) const {
+    /// wrapper around iter(), using the default ignore set
+    return iter<F>( st, default_ignore, flag );
+  }
+
+  template <typename F>
+    select_range<F> FoliaElement::iter( const ElementTypeSet& exclude,
+					SELECT_FLAGS flag ) const {
+    /// wrapper around iter(), using the default setname
+    return iter<F>( "", exclude, flag );
+  }
+
+  template <typename F>
+    select_range<F> FoliaElement::iter( SELECT_FLAGS flag ) const {
+    /// wrapper around iter(), using the default setname and ignore set
+    return iter<F>( "", default_ignore, flag );
+  }
+
+  template <typename F>
+    std::vector<F*> FoliaElement::collect( select_range<F>&& range ){
+    /// materialize a select_range into a vector
+    std::vector<F*> res;
+    for ( auto *el : range ){
+      res.push_back( el );
+    }
+    return res;
+  }
+
   class AbstractElement: public virtual FoliaElement {
     friend void destroy( FoliaElement * );
+    friend class Document; // moves subtrees between Documents
   private:
     //Constructor
     AbstractElement( const AbstractElement& ) = delete; // inhibit copies
@@ -590,6 +745,8 @@ namespace folia {
     AbstractElement( const properties& p, FoliaElement * );
     virtual ~AbstractElement() override;
   public:
+    static void *operator new( size_t );
+    static void operator delete( void * );
     void destroy() override;
     void classInit();
     void classInit( const KWargs& );
@@ -637,7 +794,7 @@ namespace folia {
 
     template <typename F>
       std::vector<F*> select( const std::string& st,
-			      const std::set<ElementType>& exclude,
+			      const ElementTypeSet& exclude,
 			      bool recurse = true ) const {
       return FoliaElement::select<F>( st, exclude, recurse );
     }
@@ -655,7 +812,7 @@ namespace folia {
     }
 
     template <typename F>
-      std::vector<F*> select( const std::set<ElementType>& exclude,
+      std::vector<F*> select( const ElementTypeSet& exclude,
 			      bool recurse = true ) const {
       return FoliaElement::select<F>( exclude, recurse );
     }
@@ -729,7 +886,10 @@ namespace folia {
 
     // attributes
     const std::string& cls() const override { return _class; };
-    void set_cls( const std::string& cls ) override { _class = cls; };
+    void set_cls( const std::string& cls ) override {
+      _class = cls;
+      text_changed();
+    };
     void update_cls( const std::string& c ){ set_cls( c ); } // deprecated
 
     const std::string& sett() const override { return _set; };
@@ -764,10 +924,18 @@ namespace folia {
     void set_speech_speaker( const std::string& ) override NOT_IMPLEMENTED;
 
     bool space() const override { return _space; };
-    bool set_space( bool b ) override { bool s =_space; _space =  b; return s; };
+    bool set_space( bool b ) override {
+      bool s =_space;
+      _space =  b;
+      text_changed();
+      return s;
+    };
 
     SPACE_FLAGS spaces_flag() const override { return _preserve_spaces; };
-    void set_spaces_flag( SPACE_FLAGS f ) override { _preserve_spaces = f; };
+    void set_spaces_flag( SPACE_FLAGS f ) override {
+      _preserve_spaces = f;
+      text_changed();
+    };
 
     double confidence() const override { return _confidence; };
     void confidence( double d ) override { _confidence = d; };
@@ -805,24 +973,31 @@ namespace folia {
     std::vector<FoliaElement*> select( ElementType,
 				       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const override;
     std::vector<FoliaElement*> select( ElementType,
-				       const std::set<ElementType>& ,
+				       const ElementTypeSet& ,
 				       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const override;
     std::vector<FoliaElement*> select( ElementType,
 				       const std::string&,
 				       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const override;
     std::vector<FoliaElement*> select( ElementType,
 				       const std::string&,
-				       const std::set<ElementType>& ,
+				       const ElementTypeSet& ,
 				       SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const override;
-    std::vector<FoliaElement*> select_set( const std::set<ElementType>&,
+    std::vector<FoliaElement*> select_set( const ElementTypeSet&,
 					   const std::string&,
-					   const std::set<ElementType>& ,
+					   const ElementTypeSet& ,
 					   SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const override;
 
     void unravel( std::set<FoliaElement*>& ) override;
 
+    void drop_text_cache() const override { _text_cache.reset(); };
+    bool text_checked() const override { return _text_checked; };
+    void set_text_checked( bool b ) const override { _text_checked = b; };
+    void text_changed() const;
+
   protected:
     xmlNode *xml( bool, bool = false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override;
     void set_processor_name( const std::string& ) override;
     void annotator2processor( const std::string&,
 			      const std::string& ) override;
@@ -859,7 +1034,7 @@ namespace folia {
     int _refcount;
     long int _line_no;
     double _confidence;
-    std::string _annotator;
+    interned_string _annotator;
     std::string _n;
     std::string _datetime;
     std::string _begintime;
@@ -867,15 +1042,25 @@ namespace folia {
     std::string _speaker;
     std::string _textclass;
     std::string _metadata;
-    std::string _processor_id;
-    std::string _set;
-    std::string _class;
+    interned_string _processor_id;
+    interned_string _set;
+    interned_string _class;
     std::string _id;
     std::string _src;
     std::string _tags;
     SPACE_FLAGS _preserve_spaces;
     std::vector<FoliaElement*> _data;
     const properties& _props;
+    /// a text() result, as remembered in TEXTCACHE mode
+    struct cached_text {
+      std::string cls;
+      TEXT_FLAGS flags;
+      CORRECTION_HANDLING handling;
+      UnicodeString value;
+    };
+    mutable std::unique_ptr<std::vector<cached_text>> _text_cache;
+    mutable bool _text_checked; ///< the text is consistent, and unchanged
+    ///< since the last check of the whole tree
   };
 
   template <typename T1, typename T2>
@@ -0,0 +1,104 @@
+/*
+  Copyright (c) 2006 - 2024
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of libfolia
+
+  libfolia is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  libfolia is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcutils/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+
+#ifndef FOLIA_INDEX_H
+#define FOLIA_INDEX_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace folia {
+
+  /// a sidecar index with the byte offsets of elements in a FoLiA file
+  /*!
+    A FragmentIndex is built in one streaming pass over a FoLiA file. For
+    every element with one of the requested tags it records the byte offset,
+    the length in bytes, the line number and the xml:id. The enclosing
+    elements of those are recorded too, so a fragment can be rebuilt with
+    its original ancestors.
+
+    Document::load_fragment() uses the index to parse only the metadata
+    and one subtree of a huge file, instead of the whole document.
+
+    Plain files and gzip files are supported. A gzip file is only seekable
+    when it consists of many small gzip members, as created by
+    write_seekable_gz(). A normal gzip file works too, but every lookup
+    has to decompress it from the start.
+  */
+  class FragmentIndex {
+  public:
+    /// the location of one element in the file
+    struct entry {
+      size_t offset;   ///< byte offset of the start tag
+      size_t head;     ///< the length of the start tag in bytes
+      size_t length;   ///< the length of the complete element in bytes
+      size_t line;     ///< the line number of the start tag
+      int parent;      ///< the index of the enclosing entry, or -1
+      std::string tag; ///< the tag, as found in the file (maybe prefixed)
+      std::string id;  ///< the xml:id (if any)
+      std::vector<std::pair<size_t,size_t>> texts; ///< offset and length of
+      ///< the \<t> and \<ph> children. Only kept for ancestors of other
+      ///< entries, to resolve text offsets
+    };
+    FragmentIndex();
+    void build( const std::string&, const std::string& ="s|p|div" );
+    void save( const std::string& ) const;
+    void load( const std::string&, const std::string& ="" );
+    const entry *find( const std::string& ) const;
+    std::string fragment( const std::string& ) const;
+    std::string read_bytes( size_t, size_t ) const;
+    /// return the name of the indexed FoLiA file
+    const std::string& file_name() const { return _file; };
+    /// return the number of entries in the index
+    size_t size() const { return _entries.size(); };
+    /// return all entries, in document order
+    const std::vector<entry>& entries() const { return _entries; };
+    static std::string default_name( const std::string& );
+  private:
+    void clear();
+    std::string _file;      ///< the indexed FoLiA file
+    size_t _file_size;      ///< its size, to detect changes
+    std::string _tags;      ///< the tags we indexed, '|' separated
+    std::string _root_tag;  ///< the tag of the root node, as in the file
+    std::string _top_tag;   ///< the tag of the \<text> or \<speech> node
+    size_t _header_end;     ///< the offset just behind the \<text> start tag
+    bool _gzipped;          ///< is the file gzip compressed?
+    std::vector<std::pair<size_t,size_t>> _blocks; ///< for gzip files: the
+    ///< uncompressed and the compressed offset of every gzip member
+    std::vector<entry> _entries; ///< all entries in document order
+    std::unordered_map<std::string,size_t> _ids; ///< xml:id to entry
+  };
+
+  void write_seekable_gz( const std::string&, const std::string&,
+			  size_t = 64*1024 );
+
+} // namespace folia
+
+#endif // FOLIA_INDEX_H
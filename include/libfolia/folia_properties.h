@@ -28,10 +28,13 @@
 #define PROPERTIES_H
 
 #include <set>
+#include <map>
+#include <array>
+#include <unordered_map>
 #include <string>
+#include "libfolia/folia_types.h"
 
 namespace folia {
-  enum ElementType : unsigned int;
   enum Attrib : int;
   enum AnnotatorType: int;
   enum AnnotationType : int;
@@ -68,24 +71,26 @@ namespace folia {
 
   extern const std::map<ElementType,std::string> et_s_map;
   extern const std::map<std::string,ElementType> s_et_map;
+  extern const std::array<std::string,LastElement>& element_tags;
+  extern const std::unordered_map<std::string,ElementType>& tag_elementtypes;
 
   extern const std::map<AnnotationType,std::string> ant_s_map;
   extern const std::map<std::string,AnnotationType> s_ant_map;
 
   extern const std::map<AnnotationType, ElementType> annotationtype_elementtype_map;
-  extern std::map<ElementType,AnnotationType> element_annotation_map;
+  extern const std::map<ElementType,AnnotationType>& element_annotation_map;
 
   extern const std::map<AnnotationType,std::string> annotationtype_xml_map;
   extern const std::map<std::string,std::string> oldtags;
-  extern std::map<std::string,std::string> reverse_old;
-  extern std::map<ElementType,properties*> element_props;
-  extern std::map<ElementType,ElementType> abstract_parents;
-  extern const std::set<ElementType> default_ignore;
-  extern const std::set<ElementType> default_ignore_annotations;
-  extern const std::set<ElementType> default_ignore_structure;
-  extern const std::set<ElementType> AnnoExcludeSet;
-  extern const std::set<ElementType> SpanSet;
-  extern const std::set<ElementType> wrefables;
+  extern const std::map<std::string,std::string>& reverse_old;
+  extern const std::array<properties*,LastElement>& element_props;
+  extern const std::map<ElementType,ElementType>& abstract_parents;
+  extern const ElementTypeSet default_ignore;
+  extern const ElementTypeSet default_ignore_annotations;
+  extern const ElementTypeSet default_ignore_structure;
+  extern const ElementTypeSet AnnoExcludeSet;
+  extern const ElementTypeSet SpanSet;
+  extern const ElementTypeSet wrefables;
 
   extern const int MAJOR_VERSION;
   extern const int MINOR_VERSION;
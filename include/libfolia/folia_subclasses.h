@@ -152,6 +152,10 @@ public:									\
     ADD_PROTECTED_CONSTRUCTORS( AbstractSpanAnnotation, AbstractElement );
   public:
     xmlNode *xml( bool, bool=false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     FoliaElement *append( FoliaElement* ) override;
 
     std::vector<FoliaElement*> wrefs() const override;
@@ -266,7 +270,7 @@ public:									\
   private:
     void init() override;
     virtual FoliaElement *find_default_reference() const = 0;
-    void set_offset( int o ) const override { _offset = o; };
+    void set_offset( int o ) const override { _offset = o; text_changed(); };
     mutable int _offset;
     std::string _ref;
   };
@@ -358,6 +362,10 @@ public:									\
 
     FoliaElement* parseXml( const xmlNode * ) override;
     xmlNode *xml( bool, bool = false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     const std::string content() const override { return value; };
     void setAttributes( KWargs& ) override;
   private:
@@ -431,7 +439,11 @@ public:									\
 					  std::vector<MorphologyLayer*>& ) const override;
     bool is_placeholder() const { return _is_placeholder; };
   private:
+    friend class Document; // maintains _doc_pos
+    void init() override;
+    bool doc_position( size_t& ) const;
     bool _is_placeholder;
+    size_t _doc_pos; ///< the last known position in Document::words()
   };
 
   class Hiddenword:
@@ -903,6 +915,10 @@ public:									\
     void setAttributes( KWargs& ) override;
     FoliaElement* parseXml( const xmlNode * ) override;
     xmlNode *xml( bool, bool=false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     void setvalue( const std::string& s ){ _value = s; };
   private:
     std::string _value;
@@ -916,6 +932,10 @@ public:									\
     void setAttributes( KWargs& ) override;
     FoliaElement* parseXml( const xmlNode * ) override;
     xmlNode *xml( bool, bool=false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     void setvalue( const std::string& s ){ _value = s; };
   private:
     std::string _value;
@@ -926,7 +946,13 @@ public:									\
     ADD_DEFAULT_CONSTRUCTORS( XmlComment, AbstractElement );
     FoliaElement* parseXml( const xmlNode * ) override;
     xmlNode *xml( bool, bool=false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     void setvalue( const std::string& s ){ _value = s; };
+    /// return the text of the comment
+    const std::string& value() const { return _value; };
   private:
     const UnicodeString private_text( const TextPolicy& ) const override {
       return "";
@@ -940,6 +966,10 @@ public:									\
     ADD_DEFAULT_CONSTRUCTORS( ProcessingInstruction, AbstractElement );
     FoliaElement* parseXml( const xmlNode * ) override;
     xmlNode *xml( bool, bool=false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     const std::string& target() const { return _target; };
     const std::string content() const override { return _content; };
   private:
@@ -955,8 +985,14 @@ public:									\
     ADD_DEFAULT_CONSTRUCTORS( XmlText, AbstractElement );
     FoliaElement* parseXml( const xmlNode * ) override;
     xmlNode *xml( bool, bool=false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     void setvalue( const std::string& );
     void setuvalue( const UnicodeString& );
+    /// return the UTF8 value of the text node
+    const std::string& value() const { return _value; };
     const std::string& get_delimiter( const TextPolicy& ) const override {
       return EMPTY_STRING; };
     void setAttributes( KWargs& ) override;
@@ -1164,6 +1200,10 @@ public:									\
     ~ForeignData() override;
     FoliaElement* parseXml( const xmlNode * ) override;
     xmlNode *xml( bool, bool=false ) const override;
+    xmlNode *xml_head( bool,
+		       std::vector<std::pair<const FoliaElement*,bool>>& ) const override {
+      return 0; // not streamable, use xml()
+    };
     void set_data( const xmlNode * );
     xmlNode* get_data() const;
   private:
@@ -79,6 +79,8 @@ namespace folia {
     void add_handler( const std::string&, const tag_handler& );
     const tag_handler remove_handler( const std::string& );
     const tag_handler get_handler( const std::string& ) const;
+    TEXT_FLAGS get_flags() const { return _text_flags; };
+    bool has_handlers() const { return !_tag_handlers.empty(); };
     const std::string& get_class() const { return _class; };
     void set_class( const std::string& c ) { _class = c; };
     CORRECTION_HANDLING get_correction_handling() const {
@@ -27,6 +27,10 @@
 #ifndef TYPES_H
 #define TYPES_H
 #include <string>
+#include <set>
+#include <bitset>
+#include <iterator>
+#include <initializer_list>
 #include "ticcutils/StringOps.h"
 
 namespace folia {
@@ -40,6 +44,85 @@ namespace folia {
       : ElementType(et+1);
   }
 
+  ///
+  /// ElementTypeSet is a set of ElementTypes, stored as a bitset
+  ///
+  /// It is used for the types to search for, and the types to skip, in
+  /// select() and friends. Testing for membership is just a bit test.
+  /// Iteration is in ElementType order, like for a std::set<ElementType>,
+  /// which can still be passed wherever an ElementTypeSet is expected.
+  ///
+  class ElementTypeSet {
+  public:
+    class const_iterator {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef ElementType value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const ElementType* pointer;
+      typedef ElementType reference;
+      const_iterator( const std::bitset<LastElement> *bits, size_t pos ):
+	_bits(bits), _pos(pos) { skip(); };
+      ElementType operator*() const { return ElementType(_pos); };
+      const_iterator& operator++() { ++_pos; skip(); return *this; };
+      const_iterator operator++(int) {
+	const_iterator tmp = *this; ++*this; return tmp;
+      };
+      bool operator==( const const_iterator& it ) const {
+	return _pos == it._pos;
+      };
+      bool operator!=( const const_iterator& it ) const {
+	return _pos != it._pos;
+      };
+    private:
+      void skip() {
+	while ( _pos < LastElement && !_bits->test( _pos ) ){
+	  ++_pos;
+	}
+      };
+      const std::bitset<LastElement> *_bits;
+      size_t _pos;
+    };
+    typedef const_iterator iterator;
+    ElementTypeSet() {};
+    ElementTypeSet( std::initializer_list<ElementType> types ){
+      for ( const auto& et : types ){
+	insert( et );
+      }
+    };
+    ElementTypeSet( const std::set<ElementType>& types ){
+      for ( const auto& et : types ){
+	insert( et );
+      }
+    };
+    void insert( ElementType et ) { _bits.set( et ); };
+    size_t erase( ElementType et ) {
+      size_t result = count( et );
+      _bits.reset( et );
+      return result;
+    };
+    bool contains( ElementType et ) const {
+      return et < LastElement && _bits.test( et );
+    };
+    size_t count( ElementType et ) const { return contains( et ); };
+    const_iterator find( ElementType et ) const {
+      return contains( et ) ? const_iterator( &_bits, et ) : end();
+    };
+    size_t size() const { return _bits.count(); };
+    bool empty() const { return _bits.none(); };
+    void clear() { _bits.reset(); };
+    const_iterator begin() const { return const_iterator( &_bits, 0 ); };
+    const_iterator end() const { return const_iterator( &_bits, LastElement ); };
+    bool operator==( const ElementTypeSet& other ) const {
+      return _bits == other._bits;
+    };
+    bool operator!=( const ElementTypeSet& other ) const {
+      return _bits != other._bits;
+    };
+  private:
+    std::bitset<LastElement> _bits;
+  };
+
   /** AnnotatorType is the Internal representation of the Annatator attribute
    *
    */
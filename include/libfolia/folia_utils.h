@@ -29,13 +29,18 @@
 
 #include <map>
 #include <set>
+#include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <atomic>
 #include <iostream>
 #include <exception>
 #include <ctime>
 #include "unicode/unistr.h"
 #include <unicode/ustream.h>
 #include "libxml/tree.h"
+#include "libxml/xmlreader.h"
 
 #include "ticcutils/StringOps.h"
 
@@ -165,21 +170,213 @@ namespace folia {
   /// it is used to pass argument lists to and from functions
   /// including attributes for FoLiA constructs
   ///
-  /// KWargs is a map, so it kan be indexed (on attribute), iterated etc.
+  /// KWargs behaves like a std::map<std::string,std::string>, so it kan be
+  /// indexed (on attribute), iterated (in attribute order) etc.
   ///
-  class KWargs : public std::map<std::string, std::string> {
+  /// The entries are kept in one sorted vector. Every node that is parsed or
+  /// serialized builds a KWargs with only a handful of entries. A flat
+  /// vector needs one allocation for those, where a map needs one per entry.
+  ///
+  class KWargs {
   public:
+    typedef std::string key_type;
+    typedef std::string mapped_type;
+    typedef std::pair<std::string,std::string> value_type;
+    typedef std::vector<value_type>::size_type size_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
     explicit KWargs( const std::string& ="" );
-    bool is_present( const std::string& ) const;
-    std::string lookup( const std::string& );
-    std::string extract( const std::string& );
+    bool is_present( std::string_view ) const;
+    std::string lookup( std::string_view );
+    std::string extract( std::string_view );
     std::string toString();
     void init( const std::string& );
+    iterator begin() { return _entries.begin(); };
+    iterator end() { return _entries.end(); };
+    const_iterator begin() const { return _entries.begin(); };
+    const_iterator end() const { return _entries.end(); };
+    const_iterator cbegin() const { return _entries.cbegin(); };
+    const_iterator cend() const { return _entries.cend(); };
+    size_type size() const { return _entries.size(); };
+    bool empty() const { return _entries.empty(); };
+    void clear() { _entries.clear(); };
+    iterator find( std::string_view );
+    const_iterator find( std::string_view ) const;
+    size_type count( std::string_view k ) const { return is_present( k ); };
+    std::string& at( std::string_view );
+    const std::string& at( std::string_view ) const;
+    std::string& operator[]( std::string_view );
+    std::pair<iterator,bool> insert( const value_type& );
+    template <typename InputIt>
+      void insert( InputIt first, InputIt last ){
+      for ( ; first != last; ++first ){
+	insert( *first );
+      }
+    }
+    iterator erase( const_iterator it ) { return _entries.erase( it ); };
+    size_type erase( std::string_view );
+    bool operator==( const KWargs& other ) const {
+      return _entries == other._entries;
+    }
+    bool operator!=( const KWargs& other ) const {
+      return _entries != other._entries;
+    }
+  private:
+    iterator position( std::string_view );
+    std::vector<value_type> _entries;
   };
 
   KWargs getArgs( const std::string& );
   std::string toString( const KWargs& );
 
+  ///
+  /// interned_string is a compact handle to a string in a global pool
+  ///
+  /// Attributes like set, class, annotator and processor use a small
+  /// vocabulary which is repeated a lot. Every distinct value is stored only
+  /// once. Equal values share the same address, so comparing two
+  /// interned_strings is just a pointer compare.
+  ///
+  /// The pool is shared by all Documents and is thread-safe. Every value
+  /// counts the interned_strings that use it, and is removed from the pool
+  /// when the last one goes. So the pool holds the values of the living
+  /// nodes only, not of every Document ever read.
+  ///
+  /// The pool is split in shards, each with its own lock, so threads that
+  /// set attributes at the same time seldom wait for each other. Copying an
+  /// interned_string, or assigning the value it already has, takes no lock.
+  ///
+  class interned_string {
+  public:
+    /// a pooled value
+    struct entry {
+      explicit entry( const std::string& s ): value( s ), refs( 1 ) {};
+      const std::string value;   ///< the value itself
+      std::atomic<size_t> refs;  ///< the number of interned_strings using it
+    };
+    interned_string(): _entry( 0 ) {};
+    interned_string( const std::string& s ): _entry( intern( s ) ) {};
+    interned_string( const interned_string& other ): _entry( other._entry ) {
+      if ( _entry ){
+	++_entry->refs;
+      }
+    };
+    interned_string( interned_string&& other ): _entry( other._entry ) {
+      other._entry = 0;
+    };
+    ~interned_string() { release( _entry ); };
+    interned_string& operator=( const interned_string& other ){
+      if ( other._entry ){
+	++other._entry->refs;
+      }
+      release( _entry );
+      _entry = other._entry;
+      return *this;
+    }
+    interned_string& operator=( interned_string&& other ){
+      std::swap( _entry, other._entry );
+      return *this;
+    }
+    interned_string& operator=( const std::string& s ){
+      if ( str() != s ){
+	entry *e = intern( s );
+	release( _entry );
+	_entry = e;
+      }
+      return *this;
+    }
+    operator const std::string&() const { return str(); };
+    const std::string& str() const {
+      return _entry ? _entry->value : empty_string;
+    };
+    const char *c_str() const { return str().c_str(); };
+    bool empty() const { return _entry == 0; };
+    void clear() { release( _entry ); _entry = 0; };
+    bool operator==( const interned_string& other ) const {
+      return _entry == other._entry;
+    }
+    bool operator!=( const interned_string& other ) const {
+      return _entry != other._entry;
+    }
+    static const std::string *lookup( const std::string& );
+    static size_t pool_size();
+  private:
+    static entry *intern( const std::string& );
+    static void release( entry * );
+    inline static const std::string empty_string; ///< the value of ""
+    entry *_entry; ///< the pooled value, 0 for an empty value
+  };
+
+  inline bool operator==( const interned_string& is, const std::string& s ){
+    return is.str() == s;
+  }
+  inline bool operator==( const std::string& s, const interned_string& is ){
+    return is.str() == s;
+  }
+  inline bool operator!=( const interned_string& is, const std::string& s ){
+    return is.str() != s;
+  }
+  inline bool operator!=( const std::string& s, const interned_string& is ){
+    return is.str() != s;
+  }
+  inline std::string operator+( const std::string& s,
+				const interned_string& is ){
+    return s + is.str();
+  }
+  inline std::string operator+( const char *s,
+				const interned_string& is ){
+    return s + is.str();
+  }
+  inline std::string operator+( const interned_string& is,
+				const std::string& s ){
+    return is.str() + s;
+  }
+  inline std::ostream& operator<<( std::ostream& os,
+				   const interned_string& is ){
+    os << is.str();
+    return os;
+  }
+
+  ///
+  /// IdIndex maps xml:id values to the FoliaElement that carries them
+  ///
+  /// It is an open addressing hash table with linear probing. Lookups take a
+  /// std::string_view, so a caller never has to build a std::string just to
+  /// search an id. The keys are copied into a few large character chunks
+  /// owned by the index, instead of a separate allocation per id.
+  ///
+  /// Erased entries leave a tombstone. They, and the key space they use, are
+  /// reclaimed when the table is rebuilt.
+  ///
+  class IdIndex {
+  public:
+    IdIndex(): _size(0), _used(0), _pool_pos(0), _pool_left(0) {};
+    IdIndex( const IdIndex& ) = delete;
+    IdIndex& operator=( const IdIndex& ) = delete;
+    FoliaElement *find( std::string_view ) const;
+    bool insert( std::string_view, FoliaElement * );
+    bool erase( std::string_view, const FoliaElement * =0 );
+    void reserve( size_t );
+    void clear();
+    size_t size() const { return _size; };
+    bool empty() const { return _size == 0; };
+  private:
+    struct slot {
+      size_t hash;
+      std::string_view key; ///< a data() of 0 marks a never used slot
+      FoliaElement *el;     ///< 0 in a used slot marks an erased entry
+    };
+    size_t locate( std::string_view, size_t ) const;
+    std::string_view store( std::string_view );
+    void rehash( size_t );
+    std::vector<slot> _slots;
+    size_t _size;  ///< the number of live entries
+    size_t _used;  ///< live entries plus tombstones
+    std::vector<std::unique_ptr<char[]>> _pool;
+    char *_pool_pos;
+    size_t _pool_left;
+  };
+
   void addAttributes( const xmlNode *, const KWargs& );
   KWargs getAttributes( const xmlNode * );
 
@@ -217,6 +414,8 @@ namespace folia {
   std::string get_fqdn();
   std::string get_user();
 
+  xmlTextReader *create_file_reader( const std::string& );
+
 } // namespace folia
 
 namespace TiCC {
@@ -0,0 +1,134 @@
+/*
+  Copyright (c) 2006 - 2024
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of libfolia
+
+  libfolia is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  libfolia is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcutils/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+
+
+#ifndef FOLIA_VIEW_H
+#define FOLIA_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "libfolia/folia.h"
+
+namespace folia {
+
+  class Document;
+  struct view_header;
+  struct view_node;
+
+  /// a read-only view on a FoLiA tree, mapped from a file
+  /*!
+    A DocumentView is built from a file written by DocumentView::write().
+    That file holds the tree as flat arrays of nodes and child indices, and
+    a table with all strings. It doesn't contain any pointers, so it can be
+    memory mapped as is. Nothing is parsed or copied on open(), and all
+    processes that open the same file share its pages in the page cache.
+
+    The view supports the common read-only queries on a Document: select(),
+    words(), sentences(), lookup by xml:id, and the id(), cls(), sett() and
+    text() of nodes. The text() of every node is stored as computed by
+    FoliaElement::str() with the default "current" textclass. Other
+    textclasses and TextPolicy settings need a full Document.
+
+    A file written on one platform can only be used on platforms with the
+    same byte order.
+  */
+  class DocumentView {
+  public:
+    /// a handle to one node in a DocumentView
+    /*!
+      A Node is just an index in the view. It is cheap to copy, and stays
+      valid as long as the DocumentView is open.
+    */
+    class Node {
+      friend class DocumentView;
+    public:
+      Node(): _view(0), _index(0) {};
+      /// is this a handle to an existing node?
+      explicit operator bool() const { return _view != 0; };
+      bool operator==( const Node& other ) const {
+	return _view == other._view && _index == other._index; };
+      bool operator!=( const Node& other ) const { return !(*this == other); };
+      ElementType element_id() const;
+      std::string xmltag() const;
+      std::string_view id() const;
+      std::string_view cls() const;
+      std::string_view sett() const;
+      bool hastext() const;
+      std::string_view text() const;
+      size_t size() const;
+      Node index( size_t ) const;
+      Node parent() const;
+      std::vector<Node> select( ElementType,
+				SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const;
+      std::vector<Node> select( ElementType,
+				const std::string&,
+				SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const;
+    private:
+      Node( const DocumentView *v, uint32_t i ): _view(v), _index(i) {};
+      const view_node& node() const;
+      const DocumentView *_view; ///< the view we belong to
+      uint32_t _index;           ///< our position in the node array
+    };
+    DocumentView();
+    explicit DocumentView( const std::string& );
+    ~DocumentView();
+    DocumentView( const DocumentView& ) = delete;
+    DocumentView& operator=( const DocumentView& ) = delete;
+    void open( const std::string& );
+    void close();
+    /// return the name of the mapped file
+    const std::string& file_name() const { return _file; };
+    /// return the number of nodes in the view
+    size_t size() const;
+    Node doc() const;
+    Node index( std::string_view ) const;
+    std::vector<Node> select( ElementType,
+			      SELECT_FLAGS = SELECT_FLAGS::RECURSE ) const;
+    std::vector<Node> words() const;
+    std::vector<Node> sentences() const;
+    static void write( const Document&, const std::string& );
+  private:
+    std::string_view string_at( uint32_t ) const;
+    std::vector<Node> node_list( uint64_t, uint32_t ) const;
+    std::string _file;      ///< the file we view
+    const char *_data;      ///< the contents of the file
+    size_t _size;           ///< the size of the file
+    bool _mapped;           ///< is _data mapped, or read into _buffer?
+    std::vector<uint64_t> _buffer; ///< the contents, when not mapped
+    const view_header *_header; ///< the header at the start of _data
+    const view_node *_nodes;    ///< the node array
+    const uint32_t *_children;  ///< the children of all nodes
+    const uint64_t *_strings;   ///< the offsets of the strings
+  };
+
+} // namespace folia
+
+#endif // FOLIA_VIEW_H
@@ -0,0 +1,183 @@
+/*
+  Copyright (c) 2006 - 2024
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of libfolia
+
+  libfolia is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  libfolia is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcutils/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include "libfolia/folia_arena.h"
+
+using namespace std;
+
+namespace folia {
+
+  /// the size of the blocks the arena requests from the heap
+  const size_t ARENA_BLOCK_SIZE = 1024*1024;
+
+  /// the alignment of every element handed out by an arena
+  const size_t ELEMENT_ALIGNMENT = alignof(std::max_align_t);
+
+  /// the active arena for the current thread. 0 means: use the heap
+  static thread_local ElementArena *active_arena = 0;
+
+  /// the memory blocks of all living arenas
+  /*!
+    release_element() uses this to tell arena memory from heap memory, so
+    elements don't need a header for that.
+  */
+  struct block_registry {
+    mutex lock;                             ///< guards blocks
+    map<const char*,const char*> blocks;    ///< begin -> end of every block
+  };
+  /// never deleted, because Documents with an arena may be destroyed after
+  /// the static objects
+  static block_registry& arena_blocks = *new block_registry;
+  /// the number of registered blocks. When 0, no lookup is needed at all
+  static atomic<size_t> arena_block_count( 0 );
+
+  ElementArena::ElementArena():
+    _pos(0),
+    _left(0),
+    _used(0)
+  {
+    /// create an empty ElementArena
+  }
+
+  ElementArena::~ElementArena(){
+    /// release all memory in one go
+    /*!
+      \note the destructors of the elements in the arena are NOT called here.
+      It is up to the owner (the Document) to do that first.
+    */
+    if ( !_blocks.empty() ){
+      lock_guard<mutex> lock( arena_blocks.lock );
+      for ( const auto& block : _blocks ){
+	arena_blocks.blocks.erase( block );
+      }
+      arena_block_count = arena_blocks.blocks.size();
+    }
+    for ( const auto& block : _blocks ){
+      free( block );
+    }
+  }
+
+  void *ElementArena::allocate( size_t size ){
+    /// hand out size bytes from the arena
+    /*!
+      \param size the number of bytes requested
+      \return a pointer to a suitable aligned memory area
+      A new block is taken from the heap when the current one is exhausted.
+    */
+    size = ( size + ELEMENT_ALIGNMENT - 1 ) & ~( ELEMENT_ALIGNMENT - 1 );
+    if ( size > _left ){
+      size_t block_size = std::max( size, ARENA_BLOCK_SIZE );
+      char *block = static_cast<char*>( malloc( block_size ) );
+      if ( !block ){
+	throw bad_alloc();
+      }
+      _blocks.push_back( block );
+      {
+	lock_guard<mutex> lock( arena_blocks.lock );
+	arena_blocks.blocks[block] = block + block_size;
+	arena_block_count = arena_blocks.blocks.size();
+      }
+      _pos = block;
+      _left = block_size;
+    }
+    void *result = _pos;
+    _pos += size;
+    _left -= size;
+    _used += size;
+    return result;
+  }
+
+  ElementArena *ElementArena::current(){
+    /// return the active ElementArena for this thread, (may be 0)
+    return active_arena;
+  }
+
+  void *ElementArena::allocate_element( size_t size ){
+    /// allocate memory for a FoliaElement
+    /*!
+      \param size the size of the element
+      \return a pointer to the memory for the element.
+      When an arena is active, it is used. Otherwise the heap.
+    */
+    if ( active_arena ){
+      return active_arena->allocate( size );
+    }
+    return ::operator new( size );
+  }
+
+  static bool in_arena( const void *p ){
+    /// is p part of the memory of some arena?
+    if ( arena_block_count == 0 ){
+      return false;
+    }
+    const char *pos = static_cast<const char*>(p);
+    lock_guard<mutex> lock( arena_blocks.lock );
+    auto it = arena_blocks.blocks.upper_bound( pos );
+    if ( it == arena_blocks.blocks.begin() ){
+      return false;
+    }
+    --it;
+    return pos < it->second;
+  }
+
+  void ElementArena::release_element( void *p ){
+    /// release the memory of a FoliaElement allocated by allocate_element()
+    /*!
+      \param p the pointer that allocate_element() returned.
+      Memory from the heap is freed. Memory from an arena is left alone. It
+      will be released together with the arena.
+
+      Only when some arena is alive, the blocks of the arenas are searched
+      for p. Without arenas, this is a plain delete.
+    */
+    if ( p && !in_arena( p ) ){
+      ::operator delete( p );
+    }
+  }
+
+  arena_scope::arena_scope( ElementArena *arena ):
+    _previous( active_arena )
+  {
+    /// activate arena for the current thread
+    /*!
+      \param arena the ElementArena to use. (may be 0)
+    */
+    active_arena = arena;
+  }
+
+  arena_scope::~arena_scope(){
+    /// restore the previous active arena
+    active_arena = _previous;
+  }
+
+} // namespace folia
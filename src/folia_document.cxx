@@ -27,10 +27,13 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <algorithm>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <functional>
 #include <stdexcept>
 #include "config.h"
 #include "ticcutils/PrettyPrint.h"
@@ -41,6 +44,7 @@
 #include "libfolia/folia.h"
 #include "libfolia/folia_properties.h"
 #include "libxml/xmlstring.h"
+#include "libxml/xmlIO.h"
 
 using namespace std;
 using namespace icu;
@@ -199,7 +203,13 @@ namespace folia {
     _foreign_metadata = 0;
     _provenance = 0;
     _xmldoc = 0;
+    _arena = 0;
     foliadoc = 0;
+    _collect_released = false;
+    _trusted_input = false;
+    _words_indexed = false;
+    _sentences_indexed = false;
+    _paragraphs_indexed = false;
     _foliaNsIn_href = 0;
     _foliaNsIn_prefix = 0;
     _foliaNsOut = 0;
@@ -219,20 +229,45 @@ namespace folia {
     /*!
       This also finally deletes FoLiA nodes that were marked for deletion
       but not yet really destroyed. (because they might still be referenced)
+
+      In ARENA mode, the nodes are just collected and deleted. Their memory
+      is released in one go when the ElementArena is deleted.
      */
     xmlFreeDoc( _xmldoc );
     xmlFree( const_cast<xmlChar*>(_foliaNsIn_href) );
     xmlFree( const_cast<xmlChar*>(_foliaNsIn_prefix) );
     sindex.clear();
-    if ( foliadoc ){
-      foliadoc->destroy();
-    }
-    set<FoliaElement*> bulk;
-    for ( const auto& it : delSet ){
-      it->unravel( bulk );
+    if ( _arena ){
+      vector<FoliaElement*> bulk;
+      vector<FoliaElement*> todo( delSet.begin(), delSet.end() );
+      if ( foliadoc ){
+	todo.push_back( foliadoc );
+      }
+      while ( !todo.empty() ){
+	FoliaElement *el = todo.back();
+	todo.pop_back();
+	bulk.push_back( el );
+	todo.insert( todo.end(), el->data().begin(), el->data().end() );
+      }
+      // referenced nodes (like in a wref) and nodes in the delSet
+      // may be found more then once
+      sort( bulk.begin(), bulk.end() );
+      bulk.erase( unique( bulk.begin(), bulk.end() ), bulk.end() );
+      for ( const auto& el : bulk ){
+	delete el;
+      }
     }
-    for ( const auto& it : bulk ){
-      it->destroy();
+    else {
+      if ( foliadoc ){
+	foliadoc->destroy();
+      }
+      set<FoliaElement*> bulk;
+      for ( const auto& it : delSet ){
+	it->unravel( bulk );
+      }
+      for ( const auto& it : bulk ){
+	it->destroy();
+      }
     }
     delete _metadata;
     delete _foreign_metadata;
@@ -240,6 +275,7 @@ namespace folia {
       delete it.second;
     }
     delete _provenance;
+    delete _arena;
   }
 
   void Document::setmode( const string& ms ) const {
@@ -255,6 +291,9 @@ namespace folia {
       '(no)checktext' (default is checktext),
       '(no)fixtext' (default is NO),
       '(no)autodeclare' (default is NO)
+      '(no)arena' (default is NO)
+      '(no)textcache' (default is NO)
+      '(no)trustedoutput' (default is NO)
 
       example:
 
@@ -310,6 +349,24 @@ namespace folia {
       else if ( mod == "noexplicit" ){
 	mode = Mode( int(mode) & ~EXPLICIT );
       }
+      else if ( mod == "arena" ){
+	mode = Mode( int(mode) | ARENA );
+      }
+      else if ( mod == "noarena" ){
+	mode = Mode( int(mode) & ~ARENA );
+      }
+      else if ( mod == "textcache" ){
+	set_textcache( true );
+      }
+      else if ( mod == "notextcache" ){
+	set_textcache( false );
+      }
+      else if ( mod == "trustedoutput" ){
+	set_trusted_output( true );
+      }
+      else if ( mod == "notrustedoutput" ){
+	set_trusted_output( false );
+      }
       else {
 	throw invalid_argument( "FoLiA::Document: unsupported mode value: "+ mod );
       }
@@ -353,6 +410,15 @@ namespace folia {
     if ( mode & EXPLICIT ){
       result += "explicit,";
     }
+    if ( mode & ARENA ){
+      result += "arena,";
+    }
+    if ( mode & TEXTCACHE ){
+      result += "textcache,";
+    }
+    if ( mode & TRUSTEDOUTPUT ){
+      result += "trustedoutput,";
+    }
     return result;
   }
 
@@ -469,6 +535,101 @@ namespace folia {
     return old_val;
   }
 
+  bool Document::set_arena( bool new_val ) const{
+    /// sets the 'arena' mode to on/off
+    /*!
+      \param new_val the boolean to use for on/off
+      \return the previous value
+
+      In ARENA mode all FoliaElements that are created while reading a
+      Document are allocated in an ElementArena, which is released as a whole
+      when the Document is destroyed.
+      \note switching the mode off again, only affects future reads.
+    */
+    bool old_val = (mode & ARENA);
+    if ( new_val ){
+      mode = Mode( (int)mode | ARENA );
+    }
+    else {
+      mode = Mode( (int)mode & ~ARENA );
+    }
+    return old_val;
+  }
+
+  static void drop_text_caches( const FoliaElement *root ){
+    /// forget the cached text() results in the whole tree below root
+    vector<const FoliaElement*> todo = { root };
+    while ( !todo.empty() ){
+      const FoliaElement *el = todo.back();
+      todo.pop_back();
+      el->drop_text_cache();
+      todo.insert( todo.end(), el->data().begin(), el->data().end() );
+    }
+  }
+
+  bool Document::set_textcache( bool new_val ) const{
+    /// sets the 'textcache' mode to on/off
+    /*!
+      \param new_val the boolean to use for on/off
+      \return the previous value
+
+      In TEXTCACHE mode every node remembers the results of text(), until
+      that node or one of its descendants is modified. So repeated text()
+      and str() calls, and the text consistency checks, don't need to
+      rebuild the text of the same subtrees over and over.
+      \note switching the mode off drops all remembered texts.
+      \note text() fills the cache, so in this mode a Document should not be
+      queried from several threads at once.
+    */
+    bool old_val = (mode & TEXTCACHE);
+    if ( new_val ){
+      mode = Mode( (int)mode | TEXTCACHE );
+    }
+    else {
+      mode = Mode( (int)mode & ~TEXTCACHE );
+      if ( old_val && foliadoc ){
+	drop_text_caches( foliadoc );
+      }
+    }
+    return old_val;
+  }
+
+  bool Document::set_trusted_output( bool new_val ) const{
+    /// sets the 'trustedoutput' mode to on/off
+    /*!
+      \param new_val the boolean to use for on/off
+      \return the previous value
+
+      In TRUSTEDOUTPUT mode the text consistency is not checked on output.
+      Meant for pipelines that guarantee consistent text themselves.
+      Without it, only the parts that changed since the Document was
+      parsed or last checked are checked.
+    */
+    bool old_val = (mode & TRUSTEDOUTPUT);
+    if ( new_val ){
+      mode = Mode( (int)mode | TRUSTEDOUTPUT );
+    }
+    else {
+      mode = Mode( (int)mode & ~TRUSTEDOUTPUT );
+    }
+    return old_val;
+  }
+
+  ElementArena *Document::element_arena(){
+    /// return the ElementArena to use for new FoliaElements
+    /*!
+      \return the arena, created on first use. Returns 0 when the ARENA mode
+      isn't set.
+    */
+    if ( !arena() ){
+      return 0;
+    }
+    if ( !_arena ){
+      _arena = new ElementArena();
+    }
+    return _arena;
+  }
+
   void Document::add_doc_index( FoliaElement* el ){
     /// add a FoliaElement to the index
     /*!
@@ -479,19 +640,18 @@ namespace folia {
     if ( my_id.empty() ) {
       return;
     }
-    auto it = sindex.find( my_id );
-    if ( it == sindex.end() ){
-      sindex[my_id] = el;
-    }
-    else {
+    if ( !sindex.insert( my_id, el ) ){
       throw DuplicateIDError( my_id );
     }
   }
 
-  void Document::del_doc_index( const string& id ){
+  void Document::del_doc_index( string_view id,
+				const FoliaElement *el ){
     /// remove an id from the index
     /*!
       \param id The id to remove
+      \param el when not 0, only remove the id when it still refers to el.
+      (The id might be re-used by a newer node already)
     */
     if ( sindex.empty() ){
       // only when ~Document is in progress
@@ -500,7 +660,95 @@ namespace folia {
     if ( id.empty() ) {
       return;
     }
-    sindex.erase(id);
+    sindex.erase( id, el );
+  }
+
+  void Document::destroy_flushed( FoliaElement *el ){
+    /// destroy a node that the Engine has output
+    /*!
+      \param el the node to destroy
+
+      Referable nodes in el which are still referenced are kept in the
+      delSet, and also in the _release_list, so release_kept() can free
+      them later.
+    */
+    _collect_released = true;
+    try {
+      el->destroy();
+    }
+    catch ( ... ){
+      _collect_released = false;
+      throw;
+    }
+    _collect_released = false;
+  }
+
+  void Document::disown( FoliaElement *tree ){
+    /// detach a parentless subtree from this Document
+    /*!
+      \param tree the root of the subtree
+
+      The xml:id's in the subtree are removed from the index, and the nodes
+      forget about this Document. So the subtree can be moved to another
+      Document, using assignDoc().
+    */
+    structure_changed( tree );
+    vector<FoliaElement*> stack( 1, tree );
+    set<FoliaElement*> seen;
+    while ( !stack.empty() ){
+      FoliaElement *el = stack.back();
+      stack.pop_back();
+      if ( seen.insert( el ).second ){
+	del_doc_index( el->id(), el );
+	dynamic_cast<AbstractElement*>(el)->_mydoc = 0;
+	stack.insert( stack.end(), el->data().begin(), el->data().end() );
+      }
+    }
+  }
+
+  void Document::release_kept(){
+    /// delete the nodes in the _release_list that are no longer referenced
+    /*!
+      Referable nodes (like Word) which the Engine destroyed while they were
+      still referenced are kept. When all their references are destroyed
+      too, the refcount has dropped to 0, and we can safely delete them,
+      together with their children. The Engine uses this to release memory
+      while processing a Document.
+
+      Other nodes in the delSet, like the placeholders returned by
+      Word::context(), are left alone. The caller may still use those.
+    */
+    vector<FoliaElement*> free_list;
+    size_t kept = 0;
+    for ( const auto& el : _release_list ){
+      if ( el->refcount() == 0 ){
+	free_list.push_back( el );
+	delSet.erase( el );
+      }
+      else {
+	_release_list[kept++] = el;
+      }
+    }
+    _release_list.resize( kept );
+    _collect_released = true;
+    try {
+      for ( const auto& el : free_list ){
+	// the node itself is already 'destroyed' and only needs deletion.
+	// its children are not.
+	del_doc_index( el->id(), el );
+	vector<FoliaElement*> children = el->data();
+	for ( const auto& child : children ){
+	  child->set_parent( 0 );
+	  child->destroy();
+	}
+	delete el;
+      }
+    }
+    catch ( ... ){
+      _collect_released = false;
+      throw;
+    }
+    _collect_released = false;
   }
 
   string Document::annotation_type_to_string( AnnotationType ann ) const {
@@ -562,6 +810,22 @@ namespace folia {
     return;
   }
 
+  /// a low estimate of the number of bytes of FoLiA per xml:id
+  const streamoff BYTES_PER_ID = 64;
+
+  void Document::reserve_index( streamoff bytes ){
+    /// size the id index for a document of a given size
+    /*!
+      \param bytes the size of the document to parse. For a compressed file
+      this underestimates the number of ids, which is harmless.
+
+      This avoids rebuilding the index over and over while parsing.
+    */
+    if ( bytes > 0 ){
+      sindex.reserve( bytes / BYTES_PER_ID );
+    }
+  }
+
   bool Document::read_from_file( const string& file_name ){
     /// read a FoLiA document from a file
     /*!
@@ -579,38 +843,38 @@ namespace folia {
       throw logic_error( "Document is already initialized" );
     }
     _source_name = file_name;
-    if ( TiCC::match_back( file_name, ".bz2" ) ){
-      string buffer = TiCC::bz2ReadFile( file_name );
-      return read_from_string( buffer );
-    }
+    is.seekg( 0, ios::end );
+    reserve_index( is.tellg() );
+    is.close();
     int cnt = 0;
-    xmlSetStructuredErrorFunc( &cnt, (xmlStructuredErrorFunc)error_sink );
-    _xmldoc = xmlReadFile( file_name.c_str(),
-			   0,
-			   XML_PARSER_OPTIONS );
-    if ( _xmldoc ){
-      if ( cnt > 0 ){
-	throw DocumentError( file_name, "document is invalid" );
-      }
+    xmlTextReader *reader = create_file_reader( file_name );
+    if ( reader ){
+      xmlTextReaderSetStructuredErrorHandler( reader,
+					      (xmlStructuredErrorFunc)error_sink,
+					      &cnt );
       if ( debug ){
 	cout << "read a doc from " << file_name << endl;
       }
-      foliadoc = parseXml();
+      arena_scope scope( element_arena() );
+      try {
+	foliadoc = parse_reader( reader, cnt );
+	invalidate_type_index();
+      }
+      catch ( ... ){
+	xmlFreeTextReader( reader );
+	throw;
+      }
+      xmlFreeTextReader( reader );
+    }
+    if ( foliadoc ){
       if ( !validate_offsets() ){
 	// cannot happen. validate_offsets() throws on error
 	throw InconsistentText("MEH");
       }
       if ( debug ){
-	if ( foliadoc ){
-	  cout << "successful parsed the doc from: " << file_name << endl;
-	}
-	else {
-	  cout << "failed to parse the doc from: " << file_name << endl;
-	}
+	cout << "successful parsed the doc from: " << file_name << endl;
       }
-      xmlFreeDoc( _xmldoc );
-      _xmldoc = 0;
-      return foliadoc != 0;
+      return true;
     }
     if ( debug ){
       cout << "Failed to read a doc from " << file_name << endl;
@@ -627,34 +891,40 @@ namespace folia {
     if ( foliadoc ){
       throw logic_error( "Document is already initialized" );
     }
+    reserve_index( buffer.length() );
     int cnt = 0;
-    xmlSetStructuredErrorFunc( &cnt, (xmlStructuredErrorFunc)error_sink );
-    _xmldoc = xmlReadMemory( buffer.c_str(), buffer.length(), 0, 0,
-			     XML_PARSER_OPTIONS );
-    if ( _xmldoc ){
+    xmlTextReader *reader = xmlReaderForMemory( buffer.c_str(),
+						buffer.length(),
+						0, 0,
+						XML_PARSER_OPTIONS );
+    if ( reader ){
+      xmlTextReaderSetStructuredErrorHandler( reader,
+					      (xmlStructuredErrorFunc)error_sink,
+					      &cnt );
       _source_name = "memory-buffer";
-      if ( cnt > 0 ){
-	throw DocumentError( _source_name, "document is invalid" );
-      }
       if ( debug ){
 	cout << "read a doc from string" << endl;
       }
-      foliadoc = parseXml();
+      arena_scope scope( element_arena() );
+      try {
+	foliadoc = parse_reader( reader, cnt );
+	invalidate_type_index();
+      }
+      catch ( ... ){
+	xmlFreeTextReader( reader );
+	throw;
+      }
+      xmlFreeTextReader( reader );
+    }
+    if ( foliadoc ){
       if ( !validate_offsets() ){
 	// cannot happen. validate_offsets() throws on error
 	throw InconsistentText("MEH");
       }
       if ( debug ){
-	if ( foliadoc ){
-	  cout << "successful parsed the doc" << endl;
-	}
-	else{
-	  cout << "failed to parse the doc" << endl;
-	}
+	cout << "successful parsed the doc" << endl;
       }
-      xmlFreeDoc( _xmldoc );
-      _xmldoc = 0;
-      return foliadoc != 0;
+      return true;
     }
     if ( debug ){
       throw runtime_error( "Failed to read a doc from a string" );
@@ -662,6 +932,402 @@ namespace folia {
     return false;
   }
 
+  FoliaElement *Document::load_fragment( const FragmentIndex& index,
+					 const string& id ){
+    /// read the metadata and one indexed element of a (large) FoLiA file
+    /*!
+      \param index a FragmentIndex for the file
+      \param id the xml:id of the element to read
+      \return the element with that id
+
+      The Document gets the metadata and the declarations of the file, the
+      ancestors of the element (with their text, but without their other
+      children) and the element itself with all its children. So references
+      to elements outside that subtree cannot be resolved.
+      Text consistency is not checked while parsing the fragment.
+    */
+    if ( foliadoc ){
+      throw logic_error( "Document is already initialized" );
+    }
+    // the ancestors miss most of their children, so their text cannot be
+    // consistent.
+    Mode old_mode = mode;
+    mode = Mode( int(mode) & ~CHECKTEXT );
+    try {
+      if ( !read_from_string( index.fragment( id ) ) ){
+	throw DocumentError( index.file_name(), "No valid FoLiA read" );
+      }
+    }
+    catch ( ... ){
+      mode = old_mode;
+      throw;
+    }
+    mode = old_mode;
+    _source_name = index.file_name();
+    return this->index( id );
+  }
+
+  /// the first bytes of a file written by save_binary()
+  const string BINARY_MAGIC = "FoLiAbin";
+  /// the version of the binary format. Increment on every change
+  const uint64_t BINARY_VERSION = 1;
+
+  /// the record types in the body of a binary file
+  enum binary_record : char {
+    BIN_ELEMENT = 'E',   ///< a FoliaElement with attributes and children
+    BIN_TEXT = 'T',      ///< an XmlText
+    BIN_COMMENT = 'C',   ///< an XmlComment
+    BIN_PI = 'P',        ///< a ProcessingInstruction
+    BIN_REFERENCE = 'R', ///< a reference to an existing element (a \<wref>)
+    BIN_XML = 'X'        ///< a small subtree, stored as XML
+  };
+
+  struct binary_writer {
+    /// collects the string table and the body of a binary file
+    unordered_map<string,uint64_t> ids; ///< the index of every string
+    vector<const string*> table;        ///< the strings, in index order
+    string body;                        ///< the encoded tree
+    void number( uint64_t val ){
+      /// append an unsigned value, 7 bits per byte
+      while ( val >= 0x80 ){
+	body += static_cast<char>( (val & 0x7f) | 0x80 );
+	val >>= 7;
+      }
+      body += static_cast<char>( val );
+    }
+    void str( const string& s ){
+      /// append a string, as an index in the string table
+      auto it = ids.find( s );
+      if ( it == ids.end() ){
+	it = ids.emplace( s, table.size() ).first;
+	table.push_back( &it->first );
+      }
+      number( it->second );
+    }
+  };
+
+  struct binary_reader {
+    /// decodes the contents of a binary file
+    const string& data;     ///< the complete file
+    size_t pos;             ///< the read position in data
+    const string& file;     ///< the file name, for error messages
+    vector<string> strings; ///< the string table
+    void need( size_t len ) const {
+      /// make sure len more bytes are available
+      if ( len > data.size() - pos ){
+	throw DocumentError( file, "truncated binary FoLiA file" );
+      }
+    }
+    uint64_t number(){
+      /// read an unsigned value, as written by binary_writer::number()
+      uint64_t result = 0;
+      for ( int shift=0; shift < 64; shift += 7 ){
+	need( 1 );
+	unsigned char c = data[pos++];
+	result |= uint64_t( c & 0x7f ) << shift;
+	if ( !( c & 0x80 ) ){
+	  return result;
+	}
+      }
+      throw DocumentError( file, "corrupt binary FoLiA file" );
+    }
+    const string& str(){
+      /// read a string from the string table
+      uint64_t i = number();
+      if ( i >= strings.size() ){
+	throw DocumentError( file, "corrupt binary FoLiA file" );
+      }
+      return strings[i];
+    }
+    string bytes(){
+      /// read a length-prefixed block of bytes
+      size_t len = number();
+      need( len );
+      pos += len;
+      return data.substr( pos - len, len );
+    }
+  };
+
+  void Document::write_binary_node( binary_writer& out,
+				    const FoliaElement *el ) const {
+    /// append the binary encoding of el and its children to out
+    if ( el->isinstance( XmlText_t ) ){
+      out.body += BIN_TEXT;
+      out.str( dynamic_cast<const XmlText*>(el)->value() );
+    }
+    else if ( el->isinstance( XmlComment_t ) ){
+      out.body += BIN_COMMENT;
+      out.str( dynamic_cast<const XmlComment*>(el)->value() );
+    }
+    else if ( el->isinstance( ProcessingInstruction_t ) ){
+      out.body += BIN_PI;
+      out.str( dynamic_cast<const ProcessingInstruction*>(el)->target() );
+      out.str( el->content() );
+    }
+    else if ( el->isinstance( LinkReference_t )
+	      || el->isinstance( ForeignData_t ) ){
+      // these can't be rebuilt from their attributes
+      out.body += BIN_XML;
+      out.str( el->xmlstring() );
+    }
+    else {
+      out.body += BIN_ELEMENT;
+      out.number( el->element_id() );
+      KWargs atts = el->collectAttributes();
+      if ( el->isinstance( Description_t ) ){
+	atts["value"] = el->description();
+      }
+      else if ( el->isinstance( Comment_t ) ){
+	atts["value"] = dynamic_cast<const Comment*>(el)->comment();
+      }
+      else if ( el->isinstance( Content_t ) ){
+	atts["value"] = el->content();
+      }
+      if ( el->spaces_flag() == SPACE_FLAGS::DEFAULT ){
+	atts["xml:space"] = "default";
+      }
+      out.number( atts.size() );
+      for ( const auto& [att,val] : atts ){
+	out.str( att );
+	out.str( val );
+      }
+      out.number( el->size() );
+      for ( const auto *child : el->data() ){
+	if ( child->parent() != el ){
+	  // a reference to a node that lives elsewhere, like a \<wref>
+	  out.body += BIN_REFERENCE;
+	  out.str( child->id() );
+	}
+	else {
+	  write_binary_node( out, child );
+	}
+      }
+    }
+  }
+
+  void Document::save_binary( const string& file_name ) const {
+    /// save the Document in a compact binary format
+    /*!
+      \param file_name the file to write to
+
+      The binary format can be read back with read_binary(), which is a lot
+      faster than parsing XML. It holds the metadata, declarations and
+      provenance as a small XML header, followed by a string table and the
+      FoLiA tree in a length-prefixed encoding.
+
+      The format is versioned, but it is meant for intermediate files, e.g.
+      between the stages of a pipeline, NOT for long term storage.
+    */
+    if ( !foliadoc ){
+      throw runtime_error( "can't save, no doc" );
+    }
+    // the header is the XML frame, without the toplevel nodes
+    vector<string> markers;
+    xmlDoc *outDoc = to_xmlDoc( "", &markers );
+    outDoc->encoding = xmlStrdup( to_xmlChar(output_encoding) );
+    xmlChar *buf; int size;
+    xmlDocDumpFormatMemoryEnc( outDoc, &buf, &size, output_encoding, 0 );
+    string header = to_string( buf, size );
+    xmlFree( buf );
+    xmlFreeDoc( outDoc );
+    _foliaNsOut = 0;
+    for ( const auto& marker : markers ){
+      header.erase( header.find( marker ), marker.size() );
+    }
+    binary_writer out;
+    out.number( foliadoc->size() );
+    for ( const auto *el : foliadoc->data() ){
+      write_binary_node( out, el );
+    }
+    ofstream os( file_name, ios::binary );
+    if ( !os ){
+      throw runtime_error( "save_binary: unable to create: " + file_name );
+    }
+    binary_writer front;
+    front.body = BINARY_MAGIC;
+    front.number( BINARY_VERSION );
+    front.number( header.size() );
+    front.body += header;
+    front.number( out.table.size() );
+    for ( const auto *s : out.table ){
+      front.number( s->size() );
+      front.body += *s;
+    }
+    os << front.body << out.body;
+    if ( !os.good() ){
+      throw runtime_error( "save_binary: writing " + file_name + " failed" );
+    }
+  }
+
+  void Document::read_binary_node( binary_reader& in, FoliaElement *parent ){
+    /// read one node, and its children, from in and append it to parent
+    in.need( 1 );
+    char kind = in.data[in.pos++];
+    switch ( kind ){
+    case BIN_TEXT:
+      parent->add_child<XmlText>( in.str() );
+      break;
+    case BIN_COMMENT: {
+      XmlComment *c = new XmlComment( this );
+      c->setvalue( in.str() );
+      parent->append( c );
+    }
+      break;
+    case BIN_PI: {
+      string target = in.str();
+      xmlNode *node = xmlNewPI( to_xmlChar(target), to_xmlChar(in.str()) );
+      FoliaElement *pi = new ProcessingInstruction( this );
+      pi->parseXml( node );
+      xmlFreeNode( node );
+      parent->append( pi );
+    }
+      break;
+    case BIN_REFERENCE: {
+      const string& id = in.str();
+      FoliaElement *ref = index( id );
+      if ( !ref ){
+	throw XmlError( parent, "Unresolvable id " + id + " in binary file" );
+      }
+      ref->increfcount();
+      parent->append( ref );
+    }
+      break;
+    case BIN_XML: {
+      const string& buffer = in.str();
+      xmlDoc *xdoc = xmlReadMemory( buffer.c_str(), buffer.size(), 0, 0,
+				    XML_PARSER_OPTIONS );
+      if ( !xdoc ){
+	throw DocumentError( _source_name, "corrupt binary FoLiA file" );
+      }
+      FoliaElement *t = 0;
+      try {
+	xmlNode *node = xmlDocGetRootElement( xdoc );
+	t = AbstractElement::createElement( TiCC::Name( node ), this );
+	t = t->parseXml( node );
+      }
+      catch ( ... ){
+	xmlFreeDoc( xdoc );
+	throw;
+      }
+      xmlFreeDoc( xdoc );
+      if ( t ){
+	parent->append( t );
+      }
+    }
+      break;
+    case BIN_ELEMENT: {
+      uint64_t type = in.number();
+      if ( type >= LastElement ){
+	throw DocumentError( _source_name, "corrupt binary FoLiA file" );
+      }
+      ElementType et = static_cast<ElementType>( type );
+      FoliaElement *t = AbstractElement::createElement( et, this );
+      try {
+	KWargs atts;
+	for ( size_t n = in.number(); n > 0; --n ){
+	  const string& att = in.str();
+	  atts[att] = in.str();
+	}
+	t->setAttributes( atts );
+	for ( size_t n = in.number(); n > 0; --n ){
+	  read_binary_node( in, t );
+	}
+	if ( et == Correction_t ){
+	  dynamic_cast<Correction*>(t)->check_type_consistency();
+	}
+	parent->append( t );
+      }
+      catch ( ... ){
+	keepForDeletion( t );
+	throw;
+      }
+    }
+      break;
+    default:
+      throw DocumentError( _source_name, "corrupt binary FoLiA file" );
+    }
+  }
+
+  bool Document::read_binary( const string& file_name ){
+    /// read a FoLiA document from a file written by save_binary()
+    /*!
+      \param file_name the name of the file
+      \return true on succes. Will throw otherwise.
+
+      The elements are rebuilt with their attributes, just like when parsing
+      XML. But the tree was validated when it was saved, so while reading
+      trusted_input() is true: the text consistency, the set declarations and
+      whether a node may be appended to its parent are not checked again.
+    */
+    if ( foliadoc ){
+      throw logic_error( "Document is already initialized" );
+    }
+    ifstream is( file_name, ios::binary );
+    if ( !is.good() ){
+      throw invalid_argument( "file not found: " + file_name );
+    }
+    string data;
+    is.seekg( 0, ios::end );
+    data.resize( is.tellg() );
+    is.seekg( 0, ios::beg );
+    is.read( &data[0], data.size() );
+    if ( data.compare( 0, BINARY_MAGIC.size(), BINARY_MAGIC ) != 0 ){
+      throw DocumentError( file_name, "not a binary FoLiA file" );
+    }
+    binary_reader in{ data, BINARY_MAGIC.size(), file_name, {} };
+    if ( in.number() != BINARY_VERSION ){
+      throw DocumentError( file_name,
+			   "unsupported version of the binary FoLiA format" );
+    }
+    string header = in.bytes();
+    size_t count = in.number();
+    in.strings.reserve( count );
+    for ( size_t i=0; i < count; ++i ){
+      in.strings.push_back( in.bytes() );
+    }
+    read_from_string( header );
+    _source_name = file_name;
+    // the tree was consistent when it was saved, so there is no need to
+    // check the text of every node, or where it is appended, again
+    // the binary format is about twice as dense as XML
+    reserve_index( 2 * in.data.size() );
+    Mode old_mode = mode;
+    mode = Mode( int(mode) & ~CHECKTEXT );
+    _trusted_input = true;
+    try {
+      arena_scope scope( element_arena() );
+      for ( size_t n = in.number(); n > 0; --n ){
+	read_binary_node( in, foliadoc );
+      }
+    }
+    catch ( ... ){
+      mode = old_mode;
+      _trusted_input = false;
+      throw;
+    }
+    mode = old_mode;
+    _trusted_input = false;
+    invalidate_type_index();
+    return true;
+  }
+
+  static int ostream_write( void *context, const char *buffer, int len ){
+    /// xmlOutputWriteCallback that appends to a std::ostream
+    ostream *os = static_cast<ostream*>(context);
+    os->write( buffer, len );
+    return os->good() ? len : -1;
+  }
+
+  static xmlOutputBuffer *ostream_output( ostream& os ){
+    /// create an (unencoded) libxml2 output buffer writing to \e os
+    xmlOutputBuffer *result = xmlOutputBufferCreateIO( ostream_write,
+						       0, &os, 0 );
+    if ( !result ){
+      throw runtime_error( "unable to create an XML output buffer" );
+    }
+    return result;
+  }
+
   ostream& operator<<( ostream& os, const Document *d ){
     /// output a Document to a stream
     /*!
@@ -669,9 +1335,8 @@ namespace folia {
       \param d the document to output
      */
     if ( d ){
-      os << d->toXml( "" );
-      // the toXml() string already ends with a newline (i hope....)
-      // but flush the stream
+      d->write_xml( ostream_output( os ), "", 1 );
+      // the output already ends with a newline, but flush the stream
       os.flush();
     }
     else {
@@ -691,9 +1356,14 @@ namespace folia {
       \param canonical determines to output in canonical order. Default is no.
     */
     bool old_k = set_canonical(canonical);
-    os << toXml( ns_label );
-    // the toXml() string already ends with a newline (i hope....)
-    // but flush the stream
+    try {
+      write_xml( ostream_output( os ), ns_label, 1 );
+    }
+    catch ( ... ){
+      set_canonical(old_k);
+      throw;
+    }
+    // the output already ends with a newline, but flush the stream
     os.flush();
     set_canonical(old_k);
     return os.good();
@@ -731,34 +1401,28 @@ namespace folia {
       \return the complete document in an unformatted string
     */
     bool old_k = set_canonical(canonical);
-    xmlDoc *outDoc = to_xmlDoc( "" );
+    ostringstream os;
+    try {
+      write_xml( ostream_output( os ), "", 0 ); // no formatting
+    }
+    catch ( ... ){
+      set_canonical(old_k);
+      throw;
+    }
     set_canonical(old_k);
-    xmlChar *buf; int size;
-    xmlDocDumpFormatMemoryEnc( outDoc, &buf, &size,
-			       output_encoding, 0 ); // no formatting
-    string result = to_string( buf, size );
-    xmlFree( buf );
-    xmlFreeDoc( outDoc );
-    _foliaNsOut = 0;
-    return result;
+    return os.str();
   }
 
-  FoliaElement* Document::index( const string& id ) const {
+  FoliaElement* Document::index( string_view id ) const {
     /// search for the element with xml:id id
     /*!
       \param id the id we search
       \return the FoliaElement with this \e id or 0, when not present
      */
-    const auto& it = sindex.find( id );
-    if ( it == sindex.end() ){
-      return 0;
-    }
-    else {
-      return it->second;
-    }
+    return sindex.find( id );
   }
 
-  FoliaElement* Document::operator []( const string& id ) const {
+  FoliaElement* Document::operator []( string_view id ) const {
     /// search for the element with xml:id id
     /*!
       \param id the id we search
@@ -804,12 +1468,473 @@ namespace folia {
     return foliadoc->text( cls, flags );
   }
 
-  static const set<ElementType> quoteSet = { Quote_t };
-  static const set<ElementType> emptySet;
+  static const ElementTypeSet quoteSet = { Quote_t };
+  static const ElementTypeSet emptySet;
+
+  void Document::invalidate_type_index() const {
+    /// drop the cached Word, Sentence and Paragraph lists
+    /*!
+      they will be rebuilt on first use
+    */
+    _words_indexed = false;
+    _sentences_indexed = false;
+    _paragraphs_indexed = false;
+    _word_index.clear();
+    _sentence_index.clear();
+    _paragraph_index.clear();
+  }
+
+  const int WORD_INDEX = 1;      ///< a subtree holds Words
+  const int SENTENCE_INDEX = 2;  ///< a subtree holds Sentences
+  const int PARAGRAPH_INDEX = 4; ///< a subtree holds Paragraphs
+
+  static int indexed_types( const FoliaElement *node ){
+    /// check which of Word, Sentence and Paragraph occur in a subtree
+    /*!
+      \param node the root of the subtree
+      \return a mask of WORD_INDEX, SENTENCE_INDEX and PARAGRAPH_INDEX
+    */
+    int result = 0;
+    switch ( node->element_id() ){
+    case Word_t:
+      result = WORD_INDEX;
+      break;
+    case Sentence_t:
+      result = SENTENCE_INDEX;
+      break;
+    case Paragraph_t:
+      result = PARAGRAPH_INDEX;
+      break;
+    default:
+      break;
+    }
+    for ( const auto& el : node->data() ){
+      result |= indexed_types( el );
+      if ( result == ( WORD_INDEX | SENTENCE_INDEX | PARAGRAPH_INDEX ) ){
+	break;
+      }
+    }
+    return result;
+  }
+
+  template <typename T>
+  static vector<T*> indexed_nodes( const FoliaElement *node,
+				   const ElementTypeSet& exclude ){
+    /// collect the nodes of type T in a subtree, like select<T>() does
+    /*!
+      \param node the root of the subtree
+      \param exclude the types that select<T>() doesn't descend into
+      \return the nodes in document order, node itself included
+    */
+    vector<T*> result;
+    if ( node->element_id() == T::PROPS.ELEMENT_ID ){
+      result.push_back( dynamic_cast<T*>( const_cast<FoliaElement*>(node) ) );
+    }
+    if ( !exclude.contains( node->element_id() ) ){
+      vector<T*> below = node->select<T>( exclude );
+      result.insert( result.end(), below.begin(), below.end() );
+    }
+    return result;
+  }
+
+  template <typename T>
+  static T *last_indexed_in( FoliaElement *node,
+			     const ElementTypeSet& exclude ){
+    /// return the last node of type T in a subtree, in document order
+    if ( !exclude.contains( node->element_id() ) ){
+      const auto& kids = node->data();
+      for ( auto it = kids.rbegin(); it != kids.rend(); ++it ){
+	T *result = last_indexed_in<T>( *it, exclude );
+	if ( result ){
+	  return result;
+	}
+      }
+    }
+    if ( node->element_id() == T::PROPS.ELEMENT_ID ){
+      return dynamic_cast<T*>( node );
+    }
+    return 0;
+  }
+
+  template <typename T>
+  static bool indexed_before( const FoliaElement *node,
+			      const FoliaElement *root,
+			      const ElementTypeSet& exclude,
+			      T*& result ){
+    /// find the last node of type T in front of node, in document order
+    /*!
+      \param node a node in the tree below root
+      \param root the root of the Document
+      \param exclude the types that select<T>() doesn't descend into
+      \param result the node found, or 0 when there is none
+      \return false when node is not reachable from root, or below a node
+      of an excluded type. So its T nodes are not in the index.
+
+      Only the subtrees in front of node and its ancestors are searched, so
+      this is cheap for a node at the end of the tree.
+    */
+    result = 0;
+    const FoliaElement *child = node;
+    for ( const FoliaElement *par = node->parent(); par; par = par->parent() ){
+      if ( exclude.contains( par->element_id() ) && par != root ){
+	return false;
+      }
+      const auto& kids = par->data();
+      auto pos = find( kids.rbegin(), kids.rend(), child );
+      if ( pos == kids.rend() ){
+	return false;
+      }
+      if ( !result ){
+	for ( ++pos; pos != kids.rend() && !result; ++pos ){
+	  result = last_indexed_in<T>( *pos, exclude );
+	}
+	if ( !result
+	     && par->element_id() == T::PROPS.ELEMENT_ID ){
+	  result = dynamic_cast<T*>( const_cast<FoliaElement*>(par) );
+	}
+      }
+      if ( par == root ){
+	return true;
+      }
+      child = par;
+    }
+    return false;
+  }
+
+  static bool at_document_end( const FoliaElement *node,
+			       const FoliaElement *root,
+			       const ElementTypeSet& exclude ){
+    /// check if node is the last node of the tree below root
+    /*!
+      \param node a node in the tree below root
+      \param root the root of the Document
+      \param exclude the types that select() doesn't descend into
+      \return true when node and all its ancestors are the last child of
+      their parent, and none of the ancestors is excluded.
+    */
+    const FoliaElement *child = node;
+    for ( const FoliaElement *par = node->parent(); par; par = par->parent() ){
+      if ( par->data().empty() || par->data().back() != child ){
+	return false;
+      }
+      if ( par == root ){
+	return true;
+      }
+      if ( exclude.contains( par->element_id() ) ){
+	return false;
+      }
+      child = par;
+    }
+    return false;
+  }
+
+  /// an in place update of a cached list moves at most this many entries.
+  /// Otherwise the list is rebuilt on its next use. This keeps a series of
+  /// edits at the start of a large Document cheap.
+  const size_t MAX_INDEX_SHIFT = 1024;
+
+  template <typename T>
+  static size_t find_indexed( const vector<T*>& index, const T *el ){
+    /// search el in the part of index that may be updated in place
+    /*!
+      \return the position, or string::npos when not found
+    */
+    size_t stop = 0;
+    if ( index.size() > MAX_INDEX_SHIFT + 1 ){
+      stop = index.size() - MAX_INDEX_SHIFT - 1;
+    }
+    for ( size_t i=index.size(); i-- > stop; ){
+      if ( index[i] == el ){
+	return i;
+      }
+    }
+    return string::npos;
+  }
+
+  template <typename T, typename LOCATE>
+  static bool add_indexed( vector<T*>& index,
+			   const FoliaElement *node,
+			   const FoliaElement *root,
+			   const ElementTypeSet& exclude,
+			   const LOCATE& locate,
+			   size_t& pos ){
+    /// insert the T nodes of a new subtree into the index
+    /*!
+      \param index the (valid) index to update
+      \param node the root of the new subtree
+      \param root the root of the Document
+      \param exclude the types that select<T>() doesn't descend into
+      \param locate a function that returns the position of a T in index,
+      or string::npos
+      \param pos returns the position of the first inserted node, or
+      string::npos when nothing is inserted
+      \return false when the position can't be determined
+    */
+    pos = string::npos;
+    vector<T*> added = indexed_nodes<T>( node, exclude );
+    if ( added.empty() ){
+      return true;
+    }
+    if ( at_document_end( node, root, exclude ) ){
+      // the most common case: building a Document from front to back
+      pos = index.size();
+      index.insert( index.end(), added.begin(), added.end() );
+      return true;
+    }
+    T *prev;
+    if ( !indexed_before( node, root, exclude, prev ) ){
+      // not (yet) part of the Document, or excluded
+      return true;
+    }
+    if ( !prev ){
+      pos = 0;
+    }
+    else if ( !index.empty() && index.back() == prev ){
+      pos = index.size();
+    }
+    else {
+      pos = locate( prev );
+      if ( pos == string::npos ){
+	return false;
+      }
+      ++pos;
+    }
+    if ( index.size() - pos > MAX_INDEX_SHIFT
+	 || ( pos < index.size() && index[pos] == added[0] ) ){
+      // too expensive, or already there
+      return false;
+    }
+    index.insert( index.begin() + pos, added.begin(), added.end() );
+    return true;
+  }
+
+  template <typename T, typename LOCATE>
+  static bool remove_indexed( vector<T*>& index,
+			      const FoliaElement *node,
+			      const ElementTypeSet& exclude,
+			      const LOCATE& locate,
+			      bool exact,
+			      size_t& pos ){
+    /// remove the T nodes of a removed subtree from the index
+    /*!
+      \param index the (valid) index to update
+      \param node the root of the removed subtree
+      \param exclude the types that select<T>() doesn't descend into
+      \param locate a function that returns the position of a T in index,
+      or string::npos
+      \param exact when true, a string::npos from locate means that the
+      node isn't in the index at all
+      \param pos returns the position of the first removed node, or
+      string::npos when nothing is removed
+      \return false when the nodes are not found where expected
+    */
+    pos = string::npos;
+    vector<T*> gone = indexed_nodes<T>( node, exclude );
+    if ( gone.empty() ){
+      return true;
+    }
+    size_t first = locate( gone[0] );
+    if ( first == string::npos ){
+      // never indexed, or further away than we want to look
+      return exact;
+    }
+    if ( first + gone.size() > index.size()
+	 || index.size() - first - gone.size() > MAX_INDEX_SHIFT
+	 || !equal( gone.begin(), gone.end(), index.begin() + first ) ){
+      return false;
+    }
+    index.erase( index.begin() + first, index.begin() + first + gone.size() );
+    pos = first;
+    return true;
+  }
+
+  void Document::restamp_words( size_t from ) const {
+    /// renumber the _doc_pos of the Words in the index, starting at from
+    for ( size_t i=from; i < _word_index.size(); ++i ){
+      _word_index[i]->_doc_pos = i;
+    }
+  }
+
+  void Document::structure_changed( const FoliaElement *node ) const {
+    /// notify the Document that an unknown edit changed the tree at node
+    /*!
+      \param node the root of the added or removed subtree. May be 0 when
+      unknown.
+
+      The cached lists of the types that occur in node are invalidated. So
+      edits below the Word level, like adding annotations, keep the cache
+      intact. Use structure_added() and structure_removed() when the kind
+      of edit is known. Those update the lists in place.
+    */
+    if ( !( _words_indexed || _sentences_indexed || _paragraphs_indexed ) ){
+      // nothing cached. No need to look any further
+      return;
+    }
+    int types = node ? indexed_types( node )
+      : WORD_INDEX | SENTENCE_INDEX | PARAGRAPH_INDEX;
+    if ( types & WORD_INDEX ){
+      _words_indexed = false;
+      _word_index.clear();
+    }
+    if ( types & SENTENCE_INDEX ){
+      _sentences_indexed = false;
+      _sentence_index.clear();
+    }
+    if ( types & PARAGRAPH_INDEX ){
+      _paragraphs_indexed = false;
+      _paragraph_index.clear();
+    }
+  }
+
+  void Document::structure_added( const FoliaElement *node ) const {
+    /// notify the Document that node is connected to its parent
+    /*!
+      \param node the root of the added subtree. It must be a child of its
+      parent() already.
+
+      The new Words, Sentences and Paragraphs are inserted in the cached
+      lists, after the last one in front of node. When that one can't be
+      found, or is too far from the end of the list, only the list of its
+      type is invalidated.
+    */
+    if ( !( _words_indexed || _sentences_indexed || _paragraphs_indexed ) ){
+      return;
+    }
+    int types = indexed_types( node );
+    size_t pos;
+    if ( _words_indexed && ( types & WORD_INDEX ) ){
+      auto locate = [this]( const Word *w ){
+	if ( w->_doc_pos < _word_index.size()
+	     && _word_index[w->_doc_pos] == w ){
+	  return w->_doc_pos;
+	}
+	return find_indexed( _word_index, w );
+      };
+      if ( !add_indexed( _word_index, node, foliadoc,
+			 default_ignore_structure, locate, pos ) ){
+	_words_indexed = false;
+	_word_index.clear();
+      }
+      else if ( pos != string::npos ){
+	restamp_words( pos );
+      }
+    }
+    if ( _sentences_indexed && ( types & SENTENCE_INDEX ) ){
+      auto locate = [this]( const Sentence *s ){
+	return find_indexed( _sentence_index, s );
+      };
+      if ( !add_indexed( _sentence_index, node, foliadoc,
+			 quoteSet, locate, pos ) ){
+	_sentences_indexed = false;
+	_sentence_index.clear();
+      }
+    }
+    if ( _paragraphs_indexed && ( types & PARAGRAPH_INDEX ) ){
+      auto locate = [this]( const Paragraph *p ){
+	return find_indexed( _paragraph_index, p );
+      };
+      if ( !add_indexed( _paragraph_index, node, foliadoc,
+			 emptySet, locate, pos ) ){
+	_paragraphs_indexed = false;
+	_paragraph_index.clear();
+      }
+    }
+  }
+
+  void Document::structure_removed( const FoliaElement *node ) const {
+    /// notify the Document that node is disconnected from its parent
+    /*!
+      \param node the root of the removed subtree
+
+      Its Words, Sentences and Paragraphs are removed from the cached lists.
+      Like in structure_added(), a list is invalidated instead, when that is
+      cheaper.
+    */
+    if ( !( _words_indexed || _sentences_indexed || _paragraphs_indexed ) ){
+      return;
+    }
+    int types = indexed_types( node );
+    size_t pos;
+    if ( _words_indexed && ( types & WORD_INDEX ) ){
+      auto locate = [this]( const Word *w ){
+	if ( w->_doc_pos < _word_index.size()
+	     && _word_index[w->_doc_pos] == w ){
+	  return w->_doc_pos;
+	}
+	return string::npos;
+      };
+      if ( !remove_indexed( _word_index, node,
+			    default_ignore_structure, locate, true, pos ) ){
+	_words_indexed = false;
+	_word_index.clear();
+      }
+      else if ( pos != string::npos ){
+	restamp_words( pos );
+      }
+    }
+    if ( _sentences_indexed && ( types & SENTENCE_INDEX ) ){
+      auto locate = [this]( const Sentence *s ){
+	return find_indexed( _sentence_index, s );
+      };
+      if ( !remove_indexed( _sentence_index, node, quoteSet, locate,
+			    _sentence_index.size() <= MAX_INDEX_SHIFT + 1,
+			    pos ) ){
+	_sentences_indexed = false;
+	_sentence_index.clear();
+      }
+    }
+    if ( _paragraphs_indexed && ( types & PARAGRAPH_INDEX ) ){
+      auto locate = [this]( const Paragraph *p ){
+	return find_indexed( _paragraph_index, p );
+      };
+      if ( !remove_indexed( _paragraph_index, node, emptySet, locate,
+			    _paragraph_index.size() <= MAX_INDEX_SHIFT + 1,
+			    pos ) ){
+	_paragraphs_indexed = false;
+	_paragraph_index.clear();
+      }
+    }
+  }
+
+  const vector<Word*>& Document::word_index() const {
+    /// return the cached list of Words, (re)building it when needed
+    if ( !_words_indexed ){
+      if ( foliadoc ){
+	_word_index = foliadoc->select<Word>( default_ignore_structure );
+	for ( size_t i=0; i < _word_index.size(); ++i ){
+	  _word_index[i]->_doc_pos = i;
+	}
+      }
+      _words_indexed = true;
+    }
+    return _word_index;
+  }
+
+  const vector<Sentence*>& Document::sentence_index() const {
+    /// return the cached list of Sentences, (re)building it when needed
+    if ( !_sentences_indexed ){
+      if ( foliadoc ){
+	_sentence_index = foliadoc->select<Sentence>( quoteSet );
+      }
+      _sentences_indexed = true;
+    }
+    return _sentence_index;
+  }
+
+  const vector<Paragraph*>& Document::paragraph_index() const {
+    /// return the cached list of Paragraphs, (re)building it when needed
+    if ( !_paragraphs_indexed ){
+      if ( foliadoc ){
+	_paragraph_index = foliadoc->select<Paragraph>();
+      }
+      _paragraphs_indexed = true;
+    }
+    return _paragraph_index;
+  }
 
   vector<Sentence*> Document::sentences() const {
     /// return all Sentences in the Document, except those in Quotes
-    return foliadoc->select<Sentence>( quoteSet );
+    return sentence_index();
   }
 
   vector<Sentence*> Document::sentenceParts() const {
@@ -825,7 +1950,7 @@ namespace folia {
       \return The Sentence found.
       will throw when the index is out of range
     */
-    vector<Sentence*> v = sentences();
+    const vector<Sentence*>& v = sentence_index();
     if ( index < v.size() ){
       return v[index];
     }
@@ -839,7 +1964,7 @@ namespace folia {
       \return The Sentence found.
       will throw when the index is out of range
     */
-    vector<Sentence*> v = sentences();
+    const vector<Sentence*>& v = sentence_index();
     if ( index < v.size() ){
       return v[v.size()-1-index];
     }
@@ -852,7 +1977,7 @@ namespace folia {
     /*!
       \return The Words found.
     */
-    return foliadoc->select<Word>( default_ignore_structure );
+    return word_index();
   }
 
   Word *Document::words( size_t index ) const {
@@ -863,7 +1988,7 @@ namespace folia {
       \return The Word found.
       will throw when the index is out of range
     */
-    vector<Word*> v = words();
+    const vector<Word*>& v = word_index();
     if ( index < v.size() ){
       return v[index];
     }
@@ -878,7 +2003,7 @@ namespace folia {
       \return The Word found.
       will throw when the index is out of range
     */
-    vector<Word*> v = words();
+    const vector<Word*>& v = word_index();
     if ( index < v.size() ){
       return v[v.size()-1-index];
     }
@@ -887,7 +2012,7 @@ namespace folia {
 
   vector<Paragraph*> Document::paragraphs() const {
     /// return all Paragraphs in the Document
-    return foliadoc->select<Paragraph>();
+    return paragraph_index();
   }
 
   Paragraph *Document::paragraphs( size_t index ) const {
@@ -897,7 +2022,7 @@ namespace folia {
       \return The Paragraph found.
       will throw when the index is out of range
     */
-    vector<Paragraph*> v = paragraphs();
+    const vector<Paragraph*>& v = paragraph_index();
     if ( index < v.size() ){
       return v[index];
     }
@@ -911,7 +2036,7 @@ namespace folia {
       \return The Paragraph found.
       will throw when the index is out of range
     */
-    vector<Paragraph*> v = paragraphs();
+    const vector<Paragraph*>& v = paragraph_index();
     if ( index < v.size() ){
       return v[v.size()-1-index];
     }
@@ -1203,7 +2328,7 @@ namespace folia {
 				 + prefix );
 	    }
 	    et = et_it->second;
-	    properties *prop = element_props[et];
+	    const properties *prop = element_props.at(et);
 	    if ( prop->REQUIRED_ATTRIBS & Attrib::CLASS ) {
 	      throw DocumentError( _source_name,
 				   "setname may not be empty for " + prefix
@@ -1783,48 +2908,59 @@ namespace folia {
     /// retrieve all style-sheets from the current XmlTree
     const xmlNode *pnt = _xmldoc->children;
     while ( pnt ){
-      // search for Processing Instructions, ignore all but stylesheet ones
-      if ( pnt->type == XML_PI_NODE && TiCC::Name(pnt) == "xml-stylesheet" ){
-	string content = TextValue(pnt);
-	string type;
-	string href;
-	vector<string> v = TiCC::split( content );
-	if ( v.size() == 2 ){
-	  vector<string> w = TiCC::split_at( v[0], "=" );
-	  if ( w.size() == 2 && w[0] == "type" ){
-	    type = w[1].substr(1,w[1].length()-2);
-	  }
-	  w = TiCC::split_at( v[1], "=" );
-	  if ( w.size() == 2 && w[0] == "href" ){
-	    href = w[1].substr(1,w[1].length()-2);
-	  }
+      parse_prelude( pnt );
+      pnt = pnt->next;
+    }
+  }
+
+  void Document::parse_prelude( const xmlNode *pnt ){
+    /// handle a top-level node outside the FoLiA root
+    /*!
+      \param pnt the xmlNode to examine
+
+      style-sheets are registered, comments are stored as preludes. All
+      other nodes are ignored.
+    */
+    // search for Processing Instructions, ignore all but stylesheet ones
+    if ( pnt->type == XML_PI_NODE && TiCC::Name(pnt) == "xml-stylesheet" ){
+      string content = TextValue(pnt);
+      string type;
+      string href;
+      vector<string> v = TiCC::split( content );
+      if ( v.size() == 2 ){
+	vector<string> w = TiCC::split_at( v[0], "=" );
+	if ( w.size() == 2 && w[0] == "type" ){
+	  type = w[1].substr(1,w[1].length()-2);
 	}
-	if ( !type.empty() && !href.empty() ){
-	  addStyle( type, href );
+	w = TiCC::split_at( v[1], "=" );
+	if ( w.size() == 2 && w[0] == "href" ){
+	  href = w[1].substr(1,w[1].length()-2);
 	}
-	else {
-	  throw DocumentError( _source_name,
-			       "problem parsing line: " + content,
-			       xmlGetLineNo(pnt) );
       }
+      if ( !type.empty() && !href.empty() ){
+	addStyle( type, href );
       }
-      else if ( pnt->type == XML_COMMENT_NODE ) {
-	string xml_tag = "_XmlComment";
-	FoliaElement *t = AbstractElement::createElement( xml_tag, this );
+      else {
+	throw DocumentError( _source_name,
+			     "problem parsing line: " + content,
+			     xmlGetLineNo(pnt) );
+      }
+    }
+    else if ( pnt->type == XML_COMMENT_NODE ) {
+      string xml_tag = "_XmlComment";
+      FoliaElement *t = AbstractElement::createElement( xml_tag, this );
+      if ( t ) {
+	if ( debug > 2 ) {
+	  cerr << "created " << t << endl;
+	}
+	t = t->parseXml( pnt );
 	if ( t ) {
 	  if ( debug > 2 ) {
-	    cerr << "created " << t << endl;
-	  }
-	  t = t->parseXml( pnt );
-	  if ( t ) {
-	    if ( debug > 2 ) {
-	      cerr << "extend " << this << " met " << t << endl;
-	    }
-	    preludes.push_back(t);
+	    cerr << "extend " << this << " met " << t << endl;
 	  }
+	  preludes.push_back(t);
 	}
       }
-      pnt = pnt->next;
     }
   }
 
@@ -1842,108 +2978,140 @@ namespace folia {
     }
   }
 
-  bool Document::validate_offsets() const {
-    /// Validate all the offset values as found in all \<t\> and \<ph\> nodes
-    /*!
-      During Document parsing, \<t\> and \<ph\> nodes are stored in a buffer
-      until the whole parsing is done.
+  /// the outcome of get_reference() for one \<t\> or \<ph\>
+  struct offset_check {
+    int length = 0;         ///< what get_reference() added to the offset
+    bool failed = false;    ///< an UnresolvableTextContent was thrown
+    string message;         ///< the message of that exception
+    exception_ptr other;    ///< any other exception thrown
+  };
+
+  static offset_check check_offset( const AbstractContentAnnotation *content,
+				    int& cumulated_offset ){
+    /// run get_reference() on content, catching all exceptions
+    offset_check result;
+    int start = cumulated_offset;
+    try {
+      content->get_reference( cumulated_offset );
+    }
+    catch ( const UnresolvableTextContent& e ){
+      result.failed = true;
+      result.message = e.what();
+    }
+    catch ( ... ){
+      result.other = current_exception();
+    }
+    result.length = cumulated_offset - start;
+    return result;
+  }
 
-      Then we are able to examine those nodes in their context and check the
-      offsets used.
-     */
-    set<TextContent*> t_done;
+  template <typename T>
+  static void validate_content_offsets( const vector<T*>& buffer,
+					const Document *doc,
+					const function<string(const T*)>& label ){
+    /// validate the offsets of all TextContent or PhonContent nodes in buffer
+    /*!
+      \param buffer the nodes to check, in document order
+      \param doc the Document the nodes belong to
+      \param label returns the start of the error message for a node
+
+      The nodes are checked in parallel. get_reference() keeps a running
+      offset over all nodes, which only matters in FIXTEXT mode and for
+      empty texts. So every node is checked from offset 0 first. Then the
+      results are handled in document order, and nodes with an empty text
+      are rechecked with the real running offset. So errors and warnings
+      are the same as for a sequential run.
+
+      FIXTEXT mode repairs offsets, and TEXTCACHE mode fills caches, so
+      then we stay sequential.
+    */
+    vector<const T*> todo;
+    set<const T*> done;
+    for ( const auto *content : buffer ){
+      if ( done.insert( content ).second
+	   && content->offset() != -1 ){
+	todo.push_back( content );
+      }
+    }
+    vector<offset_check> results( todo.size() );
+    bool parallel = !doc->fixtext() && !doc->textcache();
+    if ( parallel ){
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,64) if ( todo.size() > 256 )
+#endif
+      for ( size_t i=0; i < todo.size(); ++i ){
+	int cumulated_offset = 0;
+	results[i] = check_offset( todo[i], cumulated_offset );
+      }
+    }
     int cumulated_offset = 0;
-    for ( auto txt_it=t_offset_validation_buffer.begin();
-	  txt_it != t_offset_validation_buffer.end();
-	  ++txt_it ){
-      TextContent *txt = *txt_it;
-      if ( t_done.find( txt ) != t_done.end() ){
+    for ( size_t i=0; i < todo.size(); ++i ){
+      const T *content = todo[i];
+      offset_check result;
+      if ( parallel
+	   && ( results[i].length != 0 || cumulated_offset == 0 ) ){
+	result = results[i];
+	cumulated_offset += result.length;
+      }
+      else {
+	result = check_offset( content, cumulated_offset );
+      }
+      if ( result.other ){
+	rethrow_exception( result.other );
+      }
+      if ( !result.failed ){
 	continue;
       }
-      t_done.insert(txt);
-      int offset = txt->offset();
-      if ( offset != -1 ){
-	try {
-	  txt->get_reference(cumulated_offset);
-	}
-	catch( const UnresolvableTextContent& e ){
-	  string msg = "Text for " + txt->parent()->xmltag() + "(ID="
-	    + txt->parent()->id() + ", textclass='" + txt->cls()
-	    + "'), has incorrect offset " + TiCC::toString(offset);
+      string msg = label( content )
+	+ "has incorrect offset " + TiCC::toString( content->offset() );
+      string ref = content->ref();
+      if ( !ref.empty() ){
+	msg += " or invalid reference:" + ref;
+      }
+      msg += "\n\toriginal msg=";
+      msg += result.message;
 
+      bool warn = false;
+      try {
+	content->get_reference( cumulated_offset, false ); //trim_spaces = false
+	msg += "\nHowever, according to the older rules (<v2.4.1) the offsets are accepted. So we are treating this as a warning rather than an error. We do recommend fixing this if this is a document you intend to publish.";
+	warn = true;
+      }
+      catch ( const UnresolvableTextContent& ) {
+	msg += "\n(also checked against older rules prior to FoLiA v2.4.1)";
+      }
 
-	  string ref = txt->ref();
-	  if ( !ref.empty() ){
-	    msg += " or invalid reference:" + ref;
-	  }
-	  msg += "\n\toriginal msg=";
-	  msg += e.what();
-
-          bool warn = false;
-          try {
-	    txt->get_reference( cumulated_offset, false ); //trim_spaces = false
-	    msg += "\nHowever, according to the older rules (<v2.4.1) the offsets are accepted. So we are treating this as a warning rather than an error. We do recommend fixing this if this is a document you intend to publish.";
-	    warn = true;
-          }
-	  catch ( const UnresolvableTextContent& ) {
-	    msg += "\n(also checked against older rules prior to FoLiA v2.4.1)";
-          }
-
-          if ( warn ){
-	    increment_warn_count();
-	    cerr << "WARNING: " << msg << endl;
-	  }
-          else {
-	    throw UnresolvableTextContent( msg );
-	  }
-	}
+      if ( warn ){
+	doc->increment_warn_count();
+	cerr << "WARNING: " << msg << endl;
       }
-    }
-    set<PhonContent*> p_done;
-    cumulated_offset = 0;
-    for ( const auto& phon : p_offset_validation_buffer ){
-      if ( p_done.find( phon ) != p_done.end() ){
-	continue;
+      else {
+	throw UnresolvableTextContent( msg );
       }
-      p_done.insert(phon);
-      int offset = phon->offset();
-      if ( offset != -1 ){
-	try {
-	  phon->get_reference( cumulated_offset );
-	}
-	catch( const UnresolvableTextContent& e ){
-	  string msg = "Phoneme for " + phon->parent()->xmltag() + ", ID="
-	    + phon->parent()->id() + ", textclass='" + phon->cls()
-	    + "', has incorrect offset " + TiCC::toString(offset);
+    }
+  }
 
+  bool Document::validate_offsets() const {
+    /// Validate all the offset values as found in all \<t\> and \<ph\> nodes
+    /*!
+      During Document parsing, \<t\> and \<ph\> nodes are stored in a buffer
+      until the whole parsing is done.
 
-	  string ref = phon->ref();
-	  if ( !ref.empty() ){
-	    msg += " or invalid reference:" + ref;
-	  }
-	  msg += "\n\toriginal msg=";
-	  msg += e.what();
-
-          bool warn = false;
-          try {
-	    phon->get_reference(cumulated_offset, false ); //trim_spaces = false
-	    msg += "\nHowever, according to the older rules (<v2.4.1) the offsets are accepted. So we are treating this as a warning rather than an error. We do recommend fixing this if this is a document you intend to publish.";
-	    warn = true;
-          }
-	  catch ( const UnresolvableTextContent& ) {
-	    msg += "\n(also checked against older rules prior to FoLiA v2.4.1)";
-          }
-
-          if (warn){
-	    increment_warn_count();
-	    cerr << "WARNING: " << msg << endl;
-	  }
-          else {
-	    throw UnresolvableTextContent( msg );
-	  }
-	}
-      }
-    }
+      Then we are able to examine those nodes in their context and check the
+      offsets used. This is done in parallel, when OpenMP is available.
+     */
+    validate_content_offsets<TextContent>( t_offset_validation_buffer,
+					   this,
+					   []( const TextContent *txt ){
+	return "Text for " + txt->parent()->xmltag() + "(ID="
+	  + txt->parent()->id() + ", textclass='" + txt->cls()
+	  + "'), "; } );
+    validate_content_offsets<PhonContent>( p_offset_validation_buffer,
+					   this,
+					   []( const PhonContent *phon ){
+	return "Phoneme for " + phon->parent()->xmltag() + ", ID="
+	  + phon->parent()->id() + ", textclass='" + phon->cls()
+	  + "', "; } );
     return true;
   }
 
@@ -2024,6 +3192,553 @@ namespace folia {
     return result;
   }
 
+  /// the ElementTypes which implement their own parseXml() member.
+  /*!
+    parse_reader() can't stream those. It expands the subtree into a (small)
+    xmlNode tree and delegates to the parseXml() of the element.
+  */
+  static const set<ElementType> own_parser_types = {
+    Comment_t,
+    Content_t,
+    Correction_t,
+    Description_t,
+    External_t,
+    ForeignData_t,
+    LinkReference_t,
+    ProcessingInstruction_t,
+    WordReference_t,
+    XmlComment_t,
+    XmlText_t
+  };
+
+  /// administration of one open element during parse_reader()
+  struct parse_frame {
+    FoliaElement *element; ///< the FoliaElement under construction
+    const xmlNode *node;   ///< the corresponding xmlNode (without siblings!)
+    string prev;           ///< the name of the previous child node
+  };
+
+  FoliaElement* Document::parse_reader( xmlTextReader *reader,
+					const int& err_cnt ){
+    /// build a complete FoLiA tree in one pass over an xmlTextReader
+    /*!
+      \param reader the xmlTextReader, positioned before the first node
+      \param err_cnt the number of errors reported by libxml2 until now
+      \return the FoLiA root of the Document, or 0 when the reader fails
+
+      This builds the same tree as parseXml() does, but without creating
+      a complete xmlDoc first. Every FoliaElement is created and filled on
+      the start tag, and appended to its parent on the end tag.
+      Elements in own_parser_types are expanded and handed over to their own
+      parseXml() function.
+    */
+    FoLiA *root = 0;
+    xmlNs *fix_ns = 0;
+    bool meta_found = false;
+    vector<parse_frame> stack;
+    auto finish = [&]( FoliaElement *t, FoliaElement *parent ){
+      // the last part of AbstractElement::parseXml(). The text consistency
+      // is checked afterwards, in one text_sweep() over the whole tree
+      if ( debug > 2 ) {
+	cerr << "extend " << parent << " met " << t << endl;
+      }
+      parent->append( t );
+    };
+    auto close_top = [&](){
+      // finish the innermost open element and add it to its parent
+      // the root is left alone
+      FoliaElement *t = stack.back().element;
+      if ( stack.size() > 1 ){
+	finish( t, stack[stack.size()-2].element );
+      }
+      stack.pop_back();
+    };
+    auto start = [&]( xmlNode *node, FoliaElement *t, FoliaElement *parent ){
+      // start a new element. returns true when the subtree is handled
+      if ( debug > 2 ) {
+	cerr << "created " << t << endl;
+      }
+      if ( own_parser_types.find( t->element_id() ) != own_parser_types.end() ){
+	xmlNode *full = xmlTextReaderExpand( reader );
+	if ( !full ){
+	  throw DocumentError( _source_name, "document is invalid" );
+	}
+	if ( fix_ns ){
+	  xmlSetNs( full, fix_ns );
+	  fixupNs( full->children, fix_ns );
+	}
+	t = t->parseXml( full );
+	if ( t ){
+	  if ( debug > 2 ) {
+	    cerr << "extend " << parent << " met " << t << endl;
+	  }
+	  parent->append( t );
+	}
+	return true;
+      }
+      KWargs att = getAttributes( node );
+      int sp = xmlNodeGetSpacePreserve( node );
+      if ( sp == 1 ){
+	att["xml:space"] = "preserve";
+      }
+      else if ( sp == 0 ){
+	att["xml:space"] = "default";
+      }
+      t->setAttributes( att );
+      t->set_line_number( xmlGetLineNo(node) );
+      stack.push_back( { t, node, "" } );
+      if ( xmlTextReaderIsEmptyElement( reader ) ){
+	close_top();
+      }
+      return false;
+    };
+    auto extra_text = [&]( const parse_frame& frame,
+			   const string& prev,
+			   const xmlNode *node ){
+      // This MUST be 'empty space', so only spaces and tabs formatting
+      string txt = TextValue( node );
+      txt = TiCC::trim( txt );
+      if ( !txt.empty() ){
+	if ( !prev.empty() ){
+	  throw XmlError( frame.element,
+			  "found extra text '" + txt + "' after element <"
+			  + prev + ">, NOT allowed there." );
+	}
+	else {
+	  throw XmlError( frame.element,
+			  "found extra text '" + txt + "' inside element <"
+			  + TiCC::Name( frame.node ) + ">, NOT allowed there." );
+	}
+      }
+    };
+    auto abandon = [&](){
+      // the elements under construction are not connected to a Document
+      // yet. Let the Document clean them up
+      for ( const auto& frame : stack ){
+	keepForDeletion( frame.element );
+      }
+      if ( root && stack.empty() ){
+	keepForDeletion( root );
+      }
+    };
+    int ret = xmlTextReaderRead( reader );
+    try {
+      while ( ret == 1 ){
+	if ( err_cnt > 0 ){
+	  throw DocumentError( _source_name, "document is invalid" );
+	}
+	bool skip = false;
+	xmlNode *node = xmlTextReaderCurrentNode( reader );
+	if ( xmlTextReaderNodeType( reader ) == XML_READER_TYPE_END_ELEMENT ){
+	  close_top();
+	}
+	else if ( stack.empty() ){
+	  if ( node->type != XML_ELEMENT_NODE ){
+	    parse_prelude( node );
+	  }
+	  else {
+	    // the root node
+	    if ( node->ns ){
+	      if ( node->ns->prefix ){
+		_foliaNsIn_prefix = xmlStrdup( node->ns->prefix );
+	      }
+	      _foliaNsIn_href = xmlStrdup( node->ns->href );
+	    }
+	    if ( debug > 2 ){
+	      string dum;
+	      cerr << "root = " << TiCC::Name( node ) << endl;
+	      cerr << "in namespace " << TiCC::getNS( node, dum ) << endl;
+	      cerr << "namespace list" << TiCC::getDefinedNS( node ) << endl;
+	    }
+	    if ( TiCC::Name( node ) == "FoLiA" ){
+	      string ns = TiCC::getNS( node );
+	      if ( ns.empty() ){
+		if ( permissive() ){
+		  _foliaNsIn_href = xmlCharStrdup( NSFOLIA.c_str() );
+		  _foliaNsIn_prefix = 0;
+		  fix_ns = xmlNewNs( node, _foliaNsIn_href, _foliaNsIn_prefix );
+		  xmlSetNs( node, fix_ns );
+		}
+		else {
+		  throw DocumentError( _source_name,
+				       "Folia Document should have namespace declaration "
+				       + NSFOLIA + " but none found " );
+		}
+	      }
+	      else if ( ns != NSFOLIA ){
+		throw DocumentError( _source_name,
+				     "Folia Document should have namespace declaration "
+				     + NSFOLIA + " but found: " + ns );
+	      }
+	      root = new FoLiA( this );
+	      KWargs atts = getAttributes( node );
+	      root->setAttributes( atts );
+	      root->set_line_number( xmlGetLineNo(node) );
+	      stack.push_back( { root, node, "" } );
+	      if ( xmlTextReaderIsEmptyElement( reader ) ){
+		close_top();
+	      }
+	    }
+	    else if ( TiCC::Name( node ) == "DCOI" &&
+		      checkNS( node, NSDCOI ) ){
+	      throw DocumentError( _source_name, "DCOI format not supported" );
+	    }
+	    else {
+	      throw DocumentError( _source_name, "root node must be FoLiA" );
+	    }
+	  }
+	}
+	else {
+	  parse_frame& frame = stack.back();
+	  FoliaElement *parent = frame.element;
+	  string prev = frame.prev;
+	  frame.prev = TiCC::Name( node );
+	  parent->set_line_number( xmlGetLineNo(node) );
+	  string pref;
+	  string ns = TiCC::getNS( node, pref );
+	  if ( fix_ns ){
+	    ns = NSFOLIA;
+	  }
+	  if ( parent == root && node->type == XML_ELEMENT_NODE ){
+	    // the direct children of the root. see FoLiA::parseXml()
+	    string tag = TiCC::Name( node );
+	    if ( tag == "metadata" && ns == NSFOLIA ){
+	      if ( debug > 1 ){
+		cerr << "Found metadata" << endl;
+	      }
+	      xmlNode *full = xmlTextReaderExpand( reader );
+	      if ( !full ){
+		throw DocumentError( _source_name, "document is invalid" );
+	      }
+	      if ( fix_ns ){
+		xmlSetNs( full, fix_ns );
+		fixupNs( full->children, fix_ns );
+	      }
+	      parse_metadata( full );
+	      meta_found = true;
+	      skip = true;
+	    }
+	    else if ( ns == NSFOLIA ){
+	      if ( !meta_found && !version_below(1,6) ){
+		if ( autodeclare() ){
+		  fixup_metadata();
+		  meta_found = true;
+		  // and jus go on. assuming <text> to come
+		}
+		else {
+		  throw XmlError( root,
+				  "Expecting element metadata, got '" + tag + "'" );
+		}
+	      }
+	      FoliaElement *t = 0;
+	      try {
+		t = AbstractElement::createElement( tag, this );
+	      }
+	      catch ( const exception& e ){
+		throw XmlError( root,
+				string( "parsing <" ) + tag + "> failed:\n\t"
+				+ e.what() );
+	      }
+	      skip = start( node, t, root );
+	    }
+	    else {
+	      skip = true;
+	    }
+	  }
+	  else if ( parent == root
+		    && ( node->type == XML_PI_NODE
+			 || node->type == XML_ENTITY_REF_NODE ) ){
+	    // style-sheets are already handled. just skip
+	  }
+	  else if ( !ns.empty() && ns != NSFOLIA ){
+	    // skip alien nodes
+	    if ( debug > 2 ) {
+	      cerr << "skipping non-FoLiA node: " << pref << ":"
+		   << TiCC::Name(node) << endl;
+	    }
+	    skip = true;
+	  }
+	  else if ( node->type == XML_ELEMENT_NODE ) {
+	    string tag = TiCC::Name( node );
+	    FoliaElement *t = 0;
+	    try {
+	      t = AbstractElement::createElement( tag, this );
+	    }
+	    catch ( const exception& e ){
+	      if ( !permissive() ){
+		throw XmlError( parent,
+				string( "parsing <" ) + tag + "> failed:\n\t"
+				+ e.what() );
+	      }
+	    }
+	    if ( t ){
+	      skip = start( node, t, parent );
+	    }
+	    else {
+	      skip = true;
+	    }
+	  }
+	  else if ( node->type == XML_PI_NODE
+		    || node->type == XML_COMMENT_NODE ){
+	    string tag = ( node->type == XML_PI_NODE ) ? "PI" : "_XmlComment";
+	    FoliaElement *t;
+	    try {
+	      t = AbstractElement::createElement( tag, this );
+	    }
+	    catch ( const exception& e ){
+	      throw XmlError( parent,
+			      string( "parsing " ) + tag + " failed:\n\t"
+			      + e.what() );
+	    }
+	    if ( debug > 2 ) {
+	      cerr << "created " << t << endl;
+	    }
+	    t = t->parseXml( node );
+	    if ( t ) {
+	      if ( debug > 2 ) {
+		cerr << "extend " << parent << " met " << t << endl;
+	      }
+	      parent->append( t );
+	    }
+	  }
+	  else if ( node->type == XML_ENTITY_REF_NODE ){
+	    string txt = TextValue( node );
+	    const XmlText *t = parent->add_child<XmlText>( txt );
+	    if ( debug > 2 ) {
+	      cerr << "created " << t << "(" << t->text() << ")" << endl;
+	      cerr << "extended " << parent << " met " << t << endl;
+	      cerr << "this.size()= " << parent->size() << " t.size()="
+		   << t->size() << endl;
+	    }
+	    skip = true; // don't descent into the entity
+	  }
+	  else if ( node->type == XML_TEXT_NODE ){
+	    if ( parent->is_textcontainer()
+		 || parent->is_phoncontainer() ){
+	      // non empty text is allowed (or even required) here
+	      string txt = TextValue( node );
+	      if ( !txt.empty() ) {
+		const XmlText *t = parent->add_child<XmlText>( txt );
+		if ( debug > 2 ) {
+		  cerr << "created " << t << "(" << t->text() << ")" << endl;
+		  cerr << "extended " << parent << " met " << t << endl;
+		  cerr << "this.size()= " << parent->size() << " t.size()="
+		       << t->size() << endl;
+		}
+	      }
+	    }
+	    else {
+	      extra_text( frame, prev, node );
+	    }
+	  }
+	}
+	ret = skip ? xmlTextReaderNext( reader ) : xmlTextReaderRead( reader );
+      }
+      if ( ret == 0 && err_cnt > 0 ){
+	throw DocumentError( _source_name, "document is invalid" );
+      }
+      if ( ret == 0 && root ){
+	if ( checktext() || fixtext() ){
+	  text_sweep( root, true, false, true );
+	}
+	resolveExternals();
+      }
+    }
+    catch ( const InconsistentText& e ){
+      abandon();
+      throw;
+    }
+    catch ( const DocumentError& e ){
+      abandon();
+      throw;
+    }
+    catch ( const XmlError& e ){
+      abandon();
+      throw;
+    }
+    catch ( const DeclarationError& e ){
+      abandon();
+      throw;
+    }
+    catch ( const ValueError& e ){
+      abandon();
+      throw;
+    }
+    catch ( const exception& e ){
+      abandon();
+      throw DocumentError( _source_name, e.what() );
+    }
+    if ( ret != 0 ){
+      // the XML parser failed
+      abandon();
+      return 0;
+    }
+    return root;
+  }
+
+  /// the administration of one text_sweep()
+  struct text_sweep_state {
+    bool parsing;   ///< do the checks of check_text_consistency_while_parsing()
+    bool output;    ///< do the checks of check_text_consistency()
+    bool parsed;    ///< skip the subtrees checked by their own parseXml()
+    bool pending;   ///< only check the nodes with text_check_pending()
+    bool debug;     ///< debug the parsing checks
+    exception_ptr first; ///< the first failure
+    vector<string> messages; ///< the messages of all failures
+  };
+
+  static void mark_text_checked( const FoliaElement *root ){
+    /// set the text_checked() state of the whole tree below root
+    vector<const FoliaElement*> todo = { root };
+    while ( !todo.empty() ){
+      const FoliaElement *el = todo.back();
+      todo.pop_back();
+      el->set_text_checked( true );
+      todo.insert( todo.end(), el->data().begin(), el->data().end() );
+    }
+  }
+
+  static bool sweep_node( FoliaElement *el, text_sweep_state& state ){
+    /// check the text of \e el, after checking all its children
+    /*!
+      \param el the node to check
+      \param state the administration of the sweep
+      \return true when \e el and all the nodes below it are consistent
+
+      Visits the same nodes as the parser and the serializer do: referenced
+      children of span annotations are output as \<wref\>, they are checked
+      where they really live.
+      Nodes that pass are marked as text_checked(), until they change.
+    */
+    if ( state.pending && !el->text_check_pending() ){
+      return true;
+    }
+    if ( state.parsed
+	 && own_parser_types.find( el->element_id() ) != own_parser_types.end() ){
+      mark_text_checked( el );
+      return true;
+    }
+    const AbstractSpanAnnotation *span
+      = dynamic_cast<const AbstractSpanAnnotation*>( el );
+    bool result = true;
+    if ( !state.pending || !el->text_checked() ){
+      // when el is unchanged, so are its children
+      for ( size_t i=0; i < el->size(); ++i ){
+	FoliaElement *child = el->index(i);
+	if ( span && child->referable() && child->refcount() > 0 ){
+	  continue;
+	}
+	result = sweep_node( child, state ) && result;
+      }
+    }
+    try {
+      if ( state.parsing
+	   && el->printable()
+	   && el->element_id() != XmlText_t
+	   && !el->isSubClass( Morpheme_t ) && !el->isSubClass( Phoneme_t) ){
+	el->check_text_consistency_while_parsing( true, state.debug );
+      }
+      if ( state.output && !span && el->size() > 0 ){
+	el->check_text_consistency();
+      }
+    }
+    catch ( const InconsistentText& e ){
+      if ( !state.first ){
+	state.first = current_exception();
+      }
+      state.messages.push_back( e.what() );
+      return false;
+    }
+    if ( result ){
+      // a FIXTEXT repair may have added new, unchecked, children
+      auto unchecked = []( const FoliaElement *c ){
+	return !c->text_checked(); };
+      result = std::none_of( el->data().begin(), el->data().end(),
+			     unchecked );
+    }
+    el->set_text_checked( result );
+    return result;
+  }
+
+  void Document::text_sweep( FoliaElement *root,
+			     bool parsing,
+			     bool output,
+			     bool parsed,
+			     bool pending ) const {
+    /// check the text consistency of a complete tree in one bottom-up pass
+    /*!
+      \param root the top of the tree
+      \param parsing do the checks (and FIXTEXT repairs) that are done
+      while parsing
+      \param output do the checks that are done while serializing
+      \param parsed skip the subtrees that were already checked by their
+      own parseXml(). Only sensible directly after parse_reader()
+      \param pending only check the nodes that changed since the last
+      sweep, or that have a changed parent
+
+      The TEXTCACHE mode is switched on during the sweep, so the text of
+      every node is derived only once, and reused by the checks of its
+      ancestors.
+      All failures are collected. A single failure is rethrown as is,
+      multiple failures are combined in one InconsistentText exception.
+    */
+    if ( pending && !root->text_check_pending() ){
+      return;
+    }
+    text_sweep_state state = { parsing, output, parsed, pending,
+			       debug > 2, 0, {} };
+    bool old_cache = textcache();
+    mode = Mode( (int)mode | TEXTCACHE );
+    try {
+      sweep_node( root, state );
+    }
+    catch ( ... ){
+      if ( !old_cache ){
+	mode = Mode( (int)mode & ~TEXTCACHE );
+	drop_text_caches( root );
+      }
+      throw;
+    }
+    if ( !old_cache ){
+      mode = Mode( (int)mode & ~TEXTCACHE );
+      drop_text_caches( root );
+    }
+    if ( state.messages.size() == 1 ){
+      rethrow_exception( state.first );
+    }
+    else if ( !state.messages.empty() ){
+      string msg = TiCC::toString( state.messages.size() )
+	+ " inconsistencies found:";
+      for ( const auto& mess : state.messages ){
+	msg += "\n" + mess;
+      }
+      throw InconsistentText( msg );
+    }
+  }
+
+  void Document::validate_text() const {
+    /// check the text consistency of the whole Document
+    /*!
+      Does all the checks that are done while parsing and while
+      serializing, in one pass over the Document, regardless of the
+      CHECKTEXT mode. In FIXTEXT mode, inconsistent text is repaired.
+
+      Throws an InconsistentText exception listing all failures.
+    */
+    if ( !foliadoc ){
+      return;
+    }
+    bool old_ct = set_checktext( true );
+    try {
+      text_sweep( foliadoc, true, true );
+    }
+    catch ( ... ){
+      set_checktext( old_ct );
+      throw;
+    }
+    set_checktext( old_ct );
+  }
+
   void Document::auto_declare( AnnotationType type,
 			       const string& _setname ) {
     /// create a default declaration for the given AnnotationType
@@ -2086,7 +3801,7 @@ namespace folia {
 			     + prefix );
 	}
 	auto et = et_it->second;
-	properties *prop = element_props[et];
+	const properties *prop = element_props.at(et);
 	if ( prop->REQUIRED_ATTRIBS & Attrib::CLASS ) {
 	  throw DocumentError( _source_name,
 			       "setname may not be empty for " + prefix
@@ -2122,6 +3837,20 @@ namespace folia {
     internal_declare( type, st, f, a, t, d, processors, my_alias );
   }
 
+  static const string& resolve_alias( const map<AnnotationType,map<string,string>>& aliases,
+				      AnnotationType type,
+				      const string& my_alias ){
+    /// like Document::unalias(), but without copying the (long) setname
+    const auto& ti = aliases.find(type);
+    if ( ti != aliases.end() ){
+      const auto& sti = ti->second.find( my_alias );
+      if ( sti != ti->second.end() ){
+	return sti->second;
+      }
+    }
+    return my_alias;
+  }
+
   string Document::unalias( AnnotationType type,
 			    const string& my_alias ) const {
     /// resolve an alias for a setname to the full setname
@@ -2131,14 +3860,7 @@ namespace folia {
       \return the setname belonging to alias for this type, or alias if not
       found
     */
-    const auto& ti = _alias_set.find(type);
-    if ( ti != _alias_set.end() ){
-      const auto& sti = ti->second.find( my_alias );
-      if ( sti != ti->second.end() ){
-	return sti->second;
-      }
-    }
-    return my_alias;
+    return resolve_alias( _alias_set, type, my_alias );
   }
 
   string Document::alias( AnnotationType type,
@@ -2184,7 +3906,8 @@ namespace folia {
       }
       else {
 	// setname may be an alias, so resolve
-	auto s_it = t_it->second.find( unalias(type,setname) );
+	auto s_it = t_it->second.find( resolve_alias( _alias_set,
+						      type, setname ) );
 	if ( s_it != t_it->second.end() ){
 	  current = &s_it->second;
 	}
@@ -2217,7 +3940,8 @@ namespace folia {
       }
       else {
 	// setname may be an alias, so resolve
-	auto s_it = t_it->second.find( unalias(type,setname) );
+	auto s_it = t_it->second.find( resolve_alias( _alias_set,
+						      type, setname ) );
 	if ( s_it != t_it->second.end() ){
 	  current = &s_it->second;
 	}
@@ -2593,7 +4317,7 @@ namespace folia {
 	return true;
       }
       // set_name may be an alias, so resolve
-      string s_name = unalias(type,set_name);
+      const string& s_name = resolve_alias( _alias_set, type, set_name );
       if ( debug ){
 	cerr << "lookup: " << set_name << " (" << s_name << ")" << endl;
       }
@@ -2631,7 +4355,11 @@ namespace folia {
       If set_name is empty ("") a match is found when a declarion for \em type
       exists
     */
-    AnnotationType at = element_annotation_map[et];
+    AnnotationType at = AnnotationType::NO_ANN;
+    const auto& it = element_annotation_map.find( et );
+    if ( it != element_annotation_map.end() ){
+      at = it->second;
+    }
     return declared( at, set_name );
   }
 
@@ -3170,10 +4898,125 @@ namespace folia {
     }
   }
 
-  xmlDoc *Document::to_xmlDoc( const string& ns_label ) const {
+  static xmlNode *stream_slot( const FoliaElement *el,
+			       size_t n,
+			       string& marker ){
+    /// create a placeholder node for \e el in a serialization frame
+    /*!
+      \param el the element that will be serialized at this position
+      \param n a sequence number, unique within the frame
+      \param marker returns the text that the placeholder serializes to
+      \return a node of the same kind (element, comment or PI) as el will
+      produce, so libxml2 formats the surrounding frame in exactly the same
+      way.
+    */
+    string name = "folia-stream-" + std::to_string(n);
+    if ( el->isinstance( XmlComment_t ) ){
+      marker = "<!--" + name + "-->";
+      return xmlNewComment( to_xmlChar(name) );
+    }
+    else if ( el->isinstance( ProcessingInstruction_t ) ){
+      marker = "<?" + name + "?>";
+      return xmlNewPI( to_xmlChar(name), 0 );
+    }
+    marker = "<" + name + "/>";
+    return xmlNewNode( 0, to_xmlChar(name) );
+  }
+
+  static string dump_frame( xmlDoc *doc, xmlNode *node,
+			    int level, int format ){
+    /// serialize \e node to a string, as xmlNodeDumpOutput would
+    xmlOutputBuffer *buf = xmlAllocOutputBuffer( 0 );
+    xmlNodeDumpOutput( buf, doc, node, level, format, "UTF-8" );
+    xmlOutputBufferFlush( buf );
+    string result( reinterpret_cast<const char*>(xmlOutputBufferGetContent( buf )),
+		   xmlOutputBufferGetSize( buf ) );
+    xmlOutputBufferClose( buf );
+    return result;
+  }
+
+  static void stream_element( xmlOutputBuffer *out,
+			      xmlDoc *doc,
+			      const FoliaElement *el,
+			      bool kanon,
+			      int level,
+			      int format ){
+    /// serialize \e el and its children to \e out
+    /*!
+      \param out the output buffer
+      \param doc the (skeleton) output document, needed for the encoding
+      \param el the element to serialize
+      \param kanon output in canonical order
+      \param level the indentation level of el
+      \param format the libxml2 format flag
+
+      Only the node itself is converted to an xmlNode, with placeholders for
+      its children. After serializing that frame, the children are written
+      recursively in the places of the placeholders. So at most one path
+      from the root to a leaf is kept as xmlNodes, instead of the whole tree.
+      The output is the same as serializing el->xml( true, kanon ).
+    */
+    vector<pair<const FoliaElement*,bool>> children;
+    xmlNode *e = el->xml_head( kanon, children );
+    if ( !e ){
+      // this element has its own xml() implementation
+      e = el->xml( true, kanon );
+    }
+    else if ( !children.empty() ){
+      auto is_text = []( const pair<const FoliaElement*,bool>& ch ){
+	return ch.first->isinstance( XmlText_t ); };
+      if ( std::any_of( children.begin(), children.end(), is_text ) ){
+	// mixed content switches off formatting for all the children,
+	// so serialize this (small) subtree in one go
+	for ( const auto& [child,child_kanon] : children ){
+	  xmlAddChild( e, child->xml( true, child_kanon ) );
+	}
+      }
+      else {
+	vector<string> markers( children.size() );
+	for ( size_t i=0; i < children.size(); ++i ){
+	  xmlAddChild( e, stream_slot( children[i].first, i, markers[i] ) );
+	}
+	xmlSetTreeDoc( e, doc );
+	string frame = dump_frame( doc, e, level, format );
+	xmlFreeNode( e );
+	size_t pos = 0;
+	for ( size_t i=0; i < children.size(); ++i ){
+	  size_t hit = frame.find( markers[i], pos );
+	  if ( hit == string::npos ){
+	    throw logic_error( "missing placeholder " + markers[i]
+			       + " in the serialized output" );
+	  }
+	  xmlOutputBufferWrite( out, hit-pos, frame.data() + pos );
+	  stream_element( out, doc, children[i].first, children[i].second,
+			  level+1, format );
+	  pos = hit + markers[i].size();
+	}
+	xmlOutputBufferWrite( out, frame.size()-pos, frame.data() + pos );
+	if ( !el->doc()->trusted_output() && el->text_check_pending() ){
+	  el->check_text_consistency();
+	}
+	return;
+      }
+    }
+    // attributes are escaped according to the encoding of their document
+    xmlSetTreeDoc( e, doc );
+    xmlNodeDumpOutput( out, doc, e, level, format, "UTF-8" );
+    xmlFreeNode( e );
+    if ( el->size() > 0
+	 && !el->doc()->trusted_output() && el->text_check_pending() ){
+      el->check_text_consistency();
+    }
+  }
+
+  xmlDoc *Document::to_xmlDoc( const string& ns_label,
+			       vector<string> *markers ) const {
     /// convert the Document to an xmlDoc
     /*!
       \param ns_label a namespace label to use. (default "")
+      \param markers when not 0, only a skeleton is build: the toplevel
+      FoLiA nodes are replaced by placeholders, their text is returned
+      in \e markers
     */
     xmlDoc *outDoc = xmlNewDoc( to_xmlChar("1.0") );
     add_styles( outDoc );
@@ -3232,31 +5075,227 @@ namespace folia {
     add_metadata( md );
     for ( size_t i=0; i < foliadoc->size(); ++i ){
       const FoliaElement* el = foliadoc->index(i);
-      xmlAddChild( root, el->xml( true, canonical() ) );
+      if ( markers ){
+	markers->push_back( "" );
+	xmlAddChild( root, stream_slot( el, i, markers->back() ) );
+      }
+      else {
+	xmlAddChild( root, el->xml( true, canonical() ) );
+      }
     }
     return outDoc;
   }
 
-  string Document::toXml( const string& ns_label ) const {
-    /// dump the Document to a string
+  bool Document::write_xml( xmlOutputBuffer *out,
+			    const string& ns_label,
+			    int format ) const {
+    /// serialize the Document to a libxml2 output buffer
     /*!
-      \param ns_label a namespace label to use. (default "")
+      \param out the buffer to write to. It is closed afterwards
+      \param ns_label a namespace label to use.
+      \param format the libxml2 format flag. 1 for indented output.
+      \return false on write errors
+
+      The result is the same as dumping to_xmlDoc( ns_label ), but the
+      FoLiA tree is serialized node by node, so no complete copy of the
+      Document is built in memory.
+
+      The text consistency is checked in advance, in one text_sweep(), so
+      nothing is written for an inconsistent Document. Only the parts that
+      changed since the Document was parsed or last checked are visited.
+      In TRUSTEDOUTPUT mode nothing is checked.
     */
-    string result;
-    if ( foliadoc ){
-      xmlDoc *outDoc = to_xmlDoc( ns_label );
+    if ( !foliadoc ){
+      xmlOutputBufferClose( out );
+      throw runtime_error( "can't save, no doc" );
+    }
+    if ( checktext() && !trusted_output() ){
+      try {
+	text_sweep( foliadoc, false, true, false, true );
+      }
+      catch ( ... ){
+	xmlOutputBufferClose( out );
+	throw;
+      }
+    }
+    vector<string> markers;
+    xmlDoc *outDoc = to_xmlDoc( ns_label, &markers );
+    // the encoding influences how attributes are escaped
+    outDoc->encoding = xmlStrdup( to_xmlChar(output_encoding) );
+    // already checked, so don't check every node again
+    bool old_ct = set_checktext( false );
+    try {
       xmlChar *buf; int size;
       xmlDocDumpFormatMemoryEnc( outDoc, &buf, &size,
-				 output_encoding, 1 );
-      result = to_string( buf, size );
+				 output_encoding, format );
+      string frame = to_string( buf, size );
       xmlFree( buf );
+      size_t pos = 0;
+      for ( size_t i=0; i < markers.size(); ++i ){
+	size_t hit = frame.find( markers[i], pos );
+	if ( hit == string::npos ){
+	  throw logic_error( "missing placeholder " + markers[i]
+			     + " in the serialized output" );
+	}
+	xmlOutputBufferWrite( out, hit-pos, frame.data() + pos );
+	stream_element( out, outDoc, foliadoc->index(i), canonical(),
+			1, format );
+	pos = hit + markers[i].size();
+      }
+      xmlOutputBufferWrite( out, frame.size()-pos, frame.data() + pos );
+    }
+    catch ( ... ){
       xmlFreeDoc( outDoc );
       _foliaNsOut = 0;
+      set_checktext( old_ct );
+      xmlOutputBufferClose( out );
+      throw;
     }
-    else {
+    xmlFreeDoc( outDoc );
+    _foliaNsOut = 0;
+    set_checktext( old_ct );
+    return xmlOutputBufferClose( out ) >= 0;
+  }
+
+  xmlDoc *Document::open_stream( ostream& os,
+				 const string& ns_label,
+				 const FoliaElement *root,
+				 string& tail ) const {
+    /// start an incremental serialization of the Document to os
+    /*!
+      \param os the stream to write to
+      \param ns_label the namespace label to use
+      \param root the top node (\<text> or \<speech>) that stays open
+      \param tail returns the text to output after the end tag of root
+      \return a skeleton xmlDoc, to pass to the other stream functions.
+      The caller must free it
+
+      Everything upto the place of root is written. The start tag of root
+      must be written using stream_tags()
+    */
+    if ( !foliadoc ){
       throw runtime_error( "can't save, no doc" );
     }
-    return result;
+    vector<string> markers;
+    xmlDoc *outDoc = to_xmlDoc( ns_label, &markers );
+    outDoc->encoding = xmlStrdup( to_xmlChar(output_encoding) );
+    xmlChar *buf; int size;
+    xmlDocDumpFormatMemoryEnc( outDoc, &buf, &size, output_encoding, 1 );
+    string frame = to_string( buf, size );
+    xmlFree( buf );
+    xmlOutputBuffer *out = ostream_output( os );
+    size_t pos = 0;
+    try {
+      for ( size_t i=0; i < markers.size(); ++i ){
+	size_t hit = frame.find( markers[i], pos );
+	if ( hit == string::npos ){
+	  throw logic_error( "missing placeholder " + markers[i]
+			     + " in the serialized output" );
+	}
+	xmlOutputBufferWrite( out, hit-pos, frame.data() + pos );
+	pos = hit + markers[i].size();
+	if ( foliadoc->index(i) == root ){
+	  break;
+	}
+	stream_element( out, outDoc, foliadoc->index(i), false, 1, 1 );
+      }
+    }
+    catch ( ... ){
+      xmlOutputBufferClose( out );
+      xmlFreeDoc( outDoc );
+      _foliaNsOut = 0;
+      throw;
+    }
+    xmlOutputBufferClose( out );
+    _foliaNsOut = 0;
+    tail = frame.substr( pos );
+    return outDoc;
+  }
+
+  bool Document::stream_tags( xmlDoc *outDoc,
+			      const FoliaElement *el,
+			      int level,
+			      string& start_tag,
+			      string& end_tag,
+			      set<const FoliaElement*>& folded ) const {
+    /// serialize the start and end tag of el, for incremental output
+    /*!
+      \param outDoc the skeleton returned by open_stream()
+      \param el the element to serialize
+      \param level the indentation level of el
+      \param start_tag returns the start tag
+      \param end_tag returns the end tag
+      \param folded returns the children of el that are output as an
+      attribute of the start tag, and must NOT be serialized by themselves
+      \return false when el can't be split up
+    */
+    _foliaNsOut = xmlDocGetRootElement( outDoc )->ns;
+    vector<pair<const FoliaElement*,bool>> children;
+    xmlNode *e = el->xml_head( false, children );
+    _foliaNsOut = 0;
+    if ( !e ){
+      return false;
+    }
+    folded.clear();
+    for ( size_t i=0; i < el->size(); ++i ){
+      folded.insert( el->index(i) );
+    }
+    for ( const auto& [child,kanon] : children ){
+      folded.erase( child );
+    }
+    const string marker = "<folia-stream-0/>";
+    xmlAddChild( e, xmlNewNode( 0, to_xmlChar("folia-stream-0") ) );
+    xmlSetTreeDoc( e, outDoc );
+    string frame = dump_frame( outDoc, e, level, 1 );
+    xmlFreeNode( e );
+    size_t hit = frame.find( marker );
+    if ( hit == string::npos ){
+      throw logic_error( "missing placeholder " + marker
+			 + " in the serialized output" );
+    }
+    start_tag = TiCC::trim( frame.substr( 0, hit ) );
+    end_tag = TiCC::trim( frame.substr( hit + marker.size() ) );
+    return true;
+  }
+
+  void Document::stream_node( ostream& os,
+			      xmlDoc *outDoc,
+			      const FoliaElement *el,
+			      int level ) const {
+    /// serialize a complete FoLiA subtree on a line of its own
+    /*!
+      \param os the stream to write to
+      \param outDoc the skeleton returned by open_stream()
+      \param el the element to serialize
+      \param level the indentation level of el
+    */
+    os << string( 2*level, ' ' );
+    xmlOutputBuffer *out = ostream_output( os );
+    _foliaNsOut = xmlDocGetRootElement( outDoc )->ns;
+    try {
+      stream_element( out, outDoc, el, false, level, 1 );
+    }
+    catch ( ... ){
+      _foliaNsOut = 0;
+      xmlOutputBufferClose( out );
+      throw;
+    }
+    _foliaNsOut = 0;
+    xmlOutputBufferClose( out );
+    os << "\n";
+  }
+
+  string Document::toXml( const string& ns_label ) const {
+    /// dump the Document to a string
+    /*!
+      \param ns_label a namespace label to use. (default "")
+    */
+    if ( !foliadoc ){
+      throw runtime_error( "can't save, no doc" );
+    }
+    ostringstream os;
+    write_xml( ostream_output( os ), ns_label, 1 );
+    return os.str();
   }
 
   bool Document::toXml( const string& file_name,
@@ -3281,15 +5320,16 @@ namespace folia {
 	}
       }
       else {
-	xmlDoc *outDoc = to_xmlDoc( ns_label );
+	int compression = 0;
 	if ( TiCC::match_back( file_name, ".gz" ) ){
-	  xmlSetDocCompressMode(outDoc,9);
+	  compression = 9;
+	}
+	xmlOutputBuffer *out = xmlOutputBufferCreateFilename( file_name.c_str(),
+							      0,
+							      compression );
+	if ( !out || !write_xml( out, ns_label, 1 ) ){
+	  res = -1;
 	}
-	res = xmlSaveFormatFileEnc( file_name.c_str(),
-				    outDoc,
-				    output_encoding, 1 );
-	xmlFreeDoc( outDoc );
-	_foliaNsOut = 0;
       }
       if ( res == -1 ){
 	return false;
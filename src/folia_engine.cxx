@@ -27,14 +27,18 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
 #include <cstring>
 #include <cstdio>
 #include <string>
 #include <stack>
+#include <deque>
 #include <stdexcept>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "ticcutils/PrettyPrint.h"
-#include "ticcutils/FileUtils.h"
 #include "ticcutils/XMLtools.h"
 #include "ticcutils/zipper.h"
 #include "libfolia/folia.h"
@@ -103,6 +107,8 @@ namespace folia {
     return os;
   }
 
+  int count_nodes( const FoliaElement * );
+
   Engine::Engine():
     /// default constructor
     _reader(0),
@@ -120,15 +126,23 @@ namespace folia {
     _done(false),
     _header_done(false),
     _finished(false),
-    _debug(false)
+    _debug(false),
+    _last_open(false),
+    _stream_doc(0),
+    _flush_limit(0),
+    _pending_nodes(0),
+    _kept_nodes(0),
+    _last_matcher(0)
   {
   }
 
   Engine::~Engine(){
     /// destructor
     xmlFreeTextReader( _reader );
+    xmlFreeDoc( _stream_doc );
     delete _out_doc;
     delete _os;
+    delete _last_matcher;
   }
 
   Document *Engine::doc( bool disconnect ){
@@ -316,29 +330,8 @@ namespace folia {
       return xmlReaderForMemory( buf.c_str(), buf.size(),
 				 "input_buffer", 0, XML_PARSER_OPTIONS );
     }
-    else if ( TiCC::match_back( buf, ".bz2" ) ){
-      string buffer = TiCC::bz2ReadFile( buf );
-      if ( buffer.empty() ){
-	throw runtime_error( "folia::Engine(), empty file? (" + buf
-			      + ")" );
-      }
-      //
-      // next step fails for unclear reasons
-      // so we use an intermediate file. Which works, but is clumsy
-      //
-      // return xmlReaderForMemory( buffer.c_str(), buffer.size()+1,
-      //  				 buf.c_str(), 0, XML_PARSER_OPTIONS );
-      TiCC::tmp_stream ts( "folia" );
-      string tmp_file = ts.tmp_name();
-      ofstream& os = ts.os();
-      os << buffer << endl;
-      ts.close();
-      xmlTextReader *result
-	= xmlReaderForFile( tmp_file.c_str(), 0, XML_PARSER_OPTIONS );
-      return result;
-    }
-    // libxml2 can handle .xml and .xml.gz
-    return xmlReaderForFile( buf.c_str(), 0, XML_PARSER_OPTIONS );
+    // plain, .gz and .bz2 files
+    return create_file_reader( buf );
   }
 
   void Engine::add_comment( int depth ){
@@ -565,6 +558,8 @@ namespace folia {
       DBG << "append_node() result = " << _current_node << endl;
     }
     _last_added = t;
+    _last_open = false;
+    _pending_nodes += count_nodes( t );
   }
 
   FoliaElement *Engine::handle_match( const string& local_name,
@@ -599,6 +594,80 @@ namespace folia {
     }
   }
 
+  Engine::NodeMatcher::NodeMatcher( const string& tag ):
+    _tags( tag ),
+    _match_pi( false )
+  {
+    /// create a NodeMatcher from a tag or a list of tags
+    /*!
+      \param tag a single tag like 'lemma' or a list of '|' separated
+      tags like 'lemma|pos|description'. The special tag 'PI' matches
+      Processing Instructions.
+    */
+    vector<string> tv = TiCC::split_at( tag, "|" );
+    for ( const auto& t : tv ){
+      add( t );
+    }
+  }
+
+  Engine::NodeMatcher::NodeMatcher( const ElementTypeSet& types ):
+    _match_pi( false )
+  {
+    /// create a NodeMatcher from a set of ElementTypes
+    /*!
+      \param types the ElementTypes to match. They are matched on their
+      XML tag. A std::set<ElementType> converts to an ElementTypeSet.
+    */
+    for ( const auto& et : types ){
+      string tag = toString( et );
+      if ( !_tags.empty() ){
+	_tags += "|";
+      }
+      _tags += tag;
+      add( tag );
+    }
+  }
+
+  void Engine::NodeMatcher::add( const string& tag ){
+    /// add a tag to match
+    if ( tag == "PI" ){
+      _match_pi = true;
+    }
+    else if ( find( _names.begin(), _names.end(), tag ) == _names.end() ){
+      _names.push_back( tag );
+    }
+  }
+
+  void Engine::NodeMatcher::bind( xmlTextReader *reader ) const {
+    /// look up our tags in the dictionary of a reader
+    /*!
+      \param reader the xmlTextReader we are going to match against
+
+      The reader hands out element names from its xmlDict, so after
+      binding a match is a simple pointer comparison.
+    */
+    _interned.clear();
+    for ( const auto& name : _names ){
+      _interned.push_back( xmlTextReaderConstString( reader,
+						      to_xmlChar(name) ) );
+    }
+  }
+
+  bool Engine::NodeMatcher::matches( const xmlChar *local_name ) const {
+    /// check a name from the bound reader against our tags
+    /*!
+      \param local_name an element name, as returned by
+      xmlTextReaderConstLocalName() on the reader given to bind()
+      \return true when it is one of our tags
+    */
+    for ( const auto *name : _interned ){
+      if ( name == local_name ){
+	return true;
+      }
+    }
+    return false;
+  }
+
   FoliaElement *Engine::get_node( const string& tag ){
     /// return the next node in the Engine with 'tag'
     /*!
@@ -612,6 +681,27 @@ namespace folia {
       The returned FoliaElement is a FoLiA subtree expaned from the
       xmlTextReader. Further parsing will continue at the next sibbling
       of the parent.
+
+      The NodeMatcher for tag is kept, so repeated calls with the same tag
+      don't have to parse it again.
+    */
+    if ( !_last_matcher
+	 || _last_matcher->tags() != tag ){
+      delete _last_matcher;
+      _last_matcher = new NodeMatcher( tag );
+    }
+    return get_node( *_last_matcher );
+  }
+
+  FoliaElement *Engine::get_node( const NodeMatcher& matcher ){
+    /// return the next node in the Engine matched by 'matcher'
+    /*!
+      \param matcher the NodeMatcher with the tags we are looking for
+      \return the FoliaElement found.
+
+      The returned FoliaElement is a FoLiA subtree expaned from the
+      xmlTextReader. Further parsing will continue at the next sibbling
+      of the parent.
     */
     if ( _done ){
       if ( _debug ){
@@ -620,8 +710,9 @@ namespace folia {
       return 0;
     }
     if ( _debug ){
-      DBG << "Engine::get_node(), for tag=" << tag << endl;
+      DBG << "Engine::get_node(), for tag=" << matcher.tags() << endl;
     }
+    auto_flush();
     int ret = 0;
     if ( _external_node != 0 ){
       // so our last action was to output a pointer to a subtree.
@@ -643,22 +734,19 @@ namespace folia {
       _done = true;
       return 0;
     }
-    vector<string> tv = TiCC::split_at( tag, "|" );
-    set<string> tags;
-    for ( const auto& t : tv ){
-      tags.insert(t);
-    }
+    matcher.bind( _reader );
     while ( ret ){
       int type = xmlTextReaderNodeType(_reader);
       int new_depth = xmlTextReaderDepth(_reader);
       switch ( type ){
       case XML_READER_TYPE_ELEMENT: {
-	string local_name = to_string(xmlTextReaderConstLocalName(_reader));
+	const xmlChar *name = xmlTextReaderConstLocalName(_reader);
+	string local_name = to_string(name);
 	if ( _debug ){
 	  DBG << "get node XML_ELEMENT name=" << local_name
 	      << " depth " << _last_depth << " ==> " << new_depth << endl;
 	}
-	if ( tags.find(local_name) != tags.end() ){
+	if ( matcher.matches( name ) ){
 	  if ( _debug ){
 	    DBG << "matched search tag: " << local_name << endl;
 	  }
@@ -678,7 +766,7 @@ namespace folia {
 	throw XmlError( "spurious text found." );
 	break;
       case XML_READER_TYPE_PROCESSING_INSTRUCTION:
-	if ( tags.find( "PI" ) != tags.end() ){
+	if ( matcher.match_pi() ){
 	  _external_node = handle_match( "PI", new_depth );
 	  return _external_node;
 	}
@@ -699,29 +787,31 @@ namespace folia {
     return 0;
   }
 
-  xml_tree *Engine::create_simple_tree( const string& in_file ) const {
-    /// create a lightweight tree for enumerating all XML_ELEMENTS encountered
+  struct simple_record {
+    /// the properties of one relevant node, as used in the simple tree
+    int depth;
+    string tag;
+    string textclass;
+  };
+
+  static bool read_simple_record( xmlTextReader *cur_reader,
+				  simple_record& rec,
+				  bool _debug,
+				  TiCC::LogStream *_dbg_file ){
+    /// read ahead to the next node that is relevant for the simple tree
     /*!
-      \param in_file The file to create an xmlTextReader on. May be a string
-      buffer containing a complete XML file too
-      \return the light-weight tree with the relevant nodes
+      \param cur_reader the xmlTextReader to read from
+      \param rec the record to fill with the properties of the found node
+      \param _debug is debugging on?
+      \param _dbg_file the stream to send debugging output to
+      \return true when a node was found, false at the end of the input
+
+      Elements in alien namespaces and the xml-stylesheet PI are skipped.
     */
-    xmlTextReader *cur_reader = create_text_reader( in_file );
-    if ( xmlTextReaderReadState(cur_reader) < 0 ){
-      throw runtime_error( "create_simple_tree() init failed" );
-    }
-    if ( _debug ){
-      DBG << "enumerate_nodes()" << endl;
-    }
-    xml_tree *records = 0;
-    xml_tree *rec_pnt = 0;
-    int index = 0;
-    int current_depth = 0;
     while ( xmlTextReaderRead(cur_reader) > 0 ){
       int depth = xmlTextReaderDepth(cur_reader);
       int type = xmlTextReaderNodeType(cur_reader);
       string local_name = TiCC::to_char(xmlTextReaderConstLocalName(cur_reader));
-      xml_tree *add_rec = 0;
       switch ( type ){
       case XML_READER_TYPE_ELEMENT:
 	{
@@ -742,7 +832,8 @@ namespace folia {
 	    }
 	  }
 	  if ( nsu.empty() || nsu == NSFOLIA ){
-	    add_rec = new xml_tree( depth, index, local_name, txt_class );
+	    rec = { depth, local_name, txt_class };
+	    return true;
 	  }
 	  else {
 	    if ( _debug ){
@@ -765,57 +856,83 @@ namespace folia {
 	  if ( pnt ){
 	    _value = TiCC::to_char(pnt);
 	  }
-	  add_rec = new xml_tree( depth, index, local_name, _value );
+	  rec = { depth, local_name, _value };
+	  return true;
 	}
 	break;
       case XML_READER_TYPE_COMMENT:
 	{
-	  add_rec = new xml_tree( depth, index, local_name, "" );
+	  rec = { depth, local_name, "" };
+	  return true;
 	}
 	break;
       default:
 	// ignore all other stuff
 	break;
       }
-      if ( add_rec ){
-	++index;
-	if ( _debug ){
-	  DBG << "new record " << index << " " << local_name << " ("
-	      << depth << ")" << endl;
+    }
+    if ( xmlTextReaderReadState(cur_reader) < 0 ){
+      throw runtime_error( "create_simple_tree() failed" );
+    }
+    return false;
+  }
+
+  xml_tree *Engine::create_simple_tree( const string& in_file ) const {
+    /// create a lightweight tree for enumerating all XML_ELEMENTS encountered
+    /*!
+      \param in_file The file to create an xmlTextReader on. May be a string
+      buffer containing a complete XML file too
+      \return the light-weight tree with the relevant nodes
+    */
+    xmlTextReader *cur_reader = create_text_reader( in_file );
+    if ( xmlTextReaderReadState(cur_reader) < 0 ){
+      throw runtime_error( "create_simple_tree() init failed" );
+    }
+    if ( _debug ){
+      DBG << "enumerate_nodes()" << endl;
+    }
+    xml_tree *records = 0;
+    xml_tree *rec_pnt = 0;
+    int index = 0;
+    int current_depth = 0;
+    simple_record rec;
+    while ( read_simple_record( cur_reader, rec, _debug, _dbg_file ) ){
+      int depth = rec.depth;
+      xml_tree *add_rec = new xml_tree( depth, index, rec.tag, rec.textclass );
+      ++index;
+      if ( _debug ){
+	DBG << "new record " << index << " " << rec.tag << " ("
+	    << depth << ")" << endl;
+      }
+      if ( rec_pnt == 0 ){
+	records = add_rec;
+	rec_pnt = records;
+      }
+      else if ( depth == current_depth ){
+	add_rec->parent = rec_pnt->parent;
+	rec_pnt->next = add_rec;
+	rec_pnt = rec_pnt->next;
+      }
+      else if ( depth > current_depth ){
+	add_rec->parent = rec_pnt;
+	rec_pnt->link = add_rec;
+	rec_pnt = rec_pnt->link;
+      }
+      else { // depth < current_depth
+	while ( rec_pnt && rec_pnt->depth > depth ){
+	  rec_pnt = rec_pnt->parent;
 	}
 	if ( rec_pnt == 0 ){
-	  records = add_rec;
 	  rec_pnt = records;
 	}
-	else if ( depth == current_depth ){
-	  add_rec->parent = rec_pnt->parent;
-	  rec_pnt->next = add_rec;
-	  rec_pnt = rec_pnt->next;
-	}
-	else if ( depth > current_depth ){
-	  add_rec->parent = rec_pnt;
-	  rec_pnt->link = add_rec;
-	  rec_pnt = rec_pnt->link;
-	}
-	else { // depth < current_depth
-	  while ( rec_pnt && rec_pnt->depth > depth ){
-	    rec_pnt = rec_pnt->parent;
-	  }
-	  if ( rec_pnt == 0 ){
-	    rec_pnt = records;
-	  }
-	  while ( rec_pnt->next ){
-	    rec_pnt = rec_pnt->next;
-	  }
-	  add_rec->parent = rec_pnt->parent;
-	  rec_pnt->next = add_rec;
+	while ( rec_pnt->next ){
 	  rec_pnt = rec_pnt->next;
 	}
-	current_depth = rec_pnt->depth;
+	add_rec->parent = rec_pnt->parent;
+	rec_pnt->next = add_rec;
+	rec_pnt = rec_pnt->next;
       }
-    }
-    if ( xmlTextReaderReadState(cur_reader) < 0 ){
-      throw runtime_error( "create_simple_tree() failed" );
+      current_depth = rec_pnt->depth;
     }
     xmlFreeTextReader( cur_reader );
     return records;
@@ -973,6 +1090,8 @@ namespace folia {
 	    }
 	    t->setAttributes( atts );
 	    append_node( t, new_depth );
+	    // the children of t are still to come
+	    _last_open = true;
 	  }
 	  else {
 	    if ( _debug ){
@@ -1014,63 +1133,17 @@ namespace folia {
       throw logic_error( "folia::Engine::output_header() is called twice!" );
     }
     _header_done = true;
-    stringstream ss;
-    _out_doc->save( ss, ns_prefix );
-    string data = ss.str();
-    string search_b1;
-    string search_b2;
-    string search_e;
-    if ( _doc_type == TEXT ){
-      if ( !ns_prefix.empty() ){
-	search_b1 = "<" + ns_prefix + ":" + "text>";
-	search_b2 = "<" + ns_prefix + ":" + "text ";
-	search_e = "</" + ns_prefix + ":" + "text>";
-      }
-      else {
-	search_b1 = "<text>";
-	search_b2 = "<text ";
-	search_e = "</text>";
-      }
-    }
-    else {
-      if ( !ns_prefix.empty() ){
-	search_b1 = "<" + ns_prefix + ":" + "speech>";
-	search_b2 = "<" + ns_prefix + ":" + "speech ";
-	search_e = "</" + ns_prefix + ":" + "speech>";
-      }
-      else {
-	search_b1 = "<speech>";
-	search_b2 = "<speech ";
-	search_e = "</speech>";
-      }
-    }
-    string::size_type bpos1 = data.find( search_b1 );
-    string::size_type bpos2 = data.find( search_b2 );
-    string::size_type pos1;
-    if ( bpos1 < bpos2 ){
-      pos1 = bpos1;
-    }
-    else {
-      pos1 = bpos2;
-    }
-    string::size_type pos2;
-    if ( _root_node->size() == 0 ){
-      pos2 = data.find( "/>" , pos1 );
-    }
-    else {
-      pos2 = data.find( ">" , pos1 );
-    }
-    string head = data.substr( 0, pos2 ) + ">";
-    if ( _root_node->size() == 0 ){
-      pos2 += 2;
-    }
-    else {
-      pos2 = data.find( search_e, pos1 );
-      int add = search_e.size();
-      pos2 += add;
-    }
-    _footer = "  " + search_e + data.substr( pos2 );
-    *_os << head << endl;
+    _stream_doc = _out_doc->open_stream( *_os, ns_prefix, _root_node, _footer );
+    string start_tag;
+    string end_tag;
+    set<const FoliaElement*> folded;
+    if ( !_out_doc->stream_tags( _stream_doc, _root_node, 1,
+				 start_tag, end_tag, folded ) ){
+      throw logic_error( "folia::Engine::output_header() unable to output <"
+			 + _root_node->xmltag() + ">" );
+    }
+    *_os << start_tag << endl;
+    _open_tags.push_back( make_pair( _root_node, end_tag ) );
     return true;
   }
 
@@ -1087,15 +1160,127 @@ namespace folia {
 	throw logic_error( "folia::Engine::output_footer() impossible. No output file specified!" );
       }
       else {
+	_done = true; // no more nodes will be added
 	flush();
-	*_os << _footer << endl;
+	*_os << "  " << _open_tags[0].second << _footer << endl;
+	_open_tags.clear();
 	_finished = true;
       }
     }
   }
 
+  vector<FoliaElement*> Engine::open_path() const {
+    /// return the elements which may still get new children
+    /*!
+      \return the list of nodes from _root_node down to the deepest node
+      that is still being parsed. Empty when parsing is done
+    */
+    vector<FoliaElement*> result;
+    if ( _done ){
+      return result;
+    }
+    if ( _last_open && _last_added ){
+      result.push_back( _last_added );
+    }
+    for ( FoliaElement *pnt = _current_node;
+	  pnt && pnt != _root_node;
+	  pnt = pnt->parent() ){
+      result.push_back( pnt );
+    }
+    result.push_back( _root_node );
+    reverse( result.begin(), result.end() );
+    return result;
+  }
+
+  bool Engine::flush_children( size_t level,
+			       const vector<FoliaElement*>& path,
+			       const set<FoliaElement*>& blocked ){
+    /// output and release the completed children of an opened element
+    /*!
+      \param level the position of the element in _open_tags
+      \param path the elements that are still being parsed
+      \param blocked the nodes that are (or contain) nodes which are still
+      handled by a worker thread. Output stops in front of those.
+      \return true when output stopped at a blocked node
+
+      When the element is not on the path anymore, it is completed and
+      its end tag is output too.
+    */
+    FoliaElement *parent = _open_tags[level].first;
+    bool is_open = ( level < path.size() && path[level] == parent );
+    FoliaElement *open_child = 0;
+    if ( is_open && level + 1 < path.size() ){
+      open_child = path[level+1];
+    }
+    bool stopped = false;
+    vector<FoliaElement*> done;
+    for ( size_t i=0; i < parent->size(); ++i ){
+      FoliaElement *child = parent->index(i);
+      if ( child == open_child ){
+	break;
+      }
+      if ( level + 1 < _open_tags.size()
+	   && _open_tags[level+1].first == child ){
+	// partially output before, and now completed
+	if ( flush_children( level+1, path, blocked ) ){
+	  stopped = true;
+	  break;
+	}
+      }
+      else if ( blocked.find( child ) != blocked.end() ){
+	stopped = true;
+	break;
+      }
+      else {
+	_out_doc->stream_node( *_os, _stream_doc, child, level+2 );
+      }
+      done.push_back( child );
+    }
+    for ( auto it = done.rbegin(); it != done.rend(); ++it ){
+      // removing at the back is the safest and cheapest thing to do
+      parent->remove( *it );
+      _out_doc->destroy_flushed( *it );
+    }
+    if ( open_child && !stopped ){
+      if ( level + 1 == _open_tags.size()
+	   && open_child->size() > 1
+	   && isSubClass( open_child->element_id(), AbstractStructureElement_t )
+	   && !open_child->isinstance( Sentence_t )
+	   && !open_child->isinstance( Word_t ) ){
+	// Start outputting this element. Sentences and below are kept
+	// complete, as their annotation layers refer back to the words.
+	string start_tag;
+	string end_tag;
+	set<const FoliaElement*> folded;
+	if ( _out_doc->stream_tags( _stream_doc, open_child, level+2,
+				    start_tag, end_tag, folded ) ){
+	  *_os << string( 2*(level+2), ' ' ) << start_tag << "\n";
+	  _open_tags.push_back( make_pair( open_child, end_tag ) );
+	  for ( size_t i=open_child->size(); i-- > 0; ){
+	    FoliaElement *child = open_child->index(i);
+	    if ( folded.find( child ) != folded.end() ){
+	      // already output as an attribute
+	      open_child->remove( child );
+	      _out_doc->destroy_flushed( child );
+	    }
+	  }
+	}
+      }
+      if ( level + 1 < _open_tags.size()
+	   && _open_tags[level+1].first == open_child ){
+	stopped = flush_children( level+1, path, blocked );
+      }
+    }
+    if ( !is_open && !stopped && level > 0 ){
+      *_os << string( 2*(level+1), ' ' ) << _open_tags[level].second << "\n";
+      _open_tags.pop_back();
+    }
+    return stopped;
+  }
+
   void Engine::flush() {
-    /// output all NEW information in the output Document to the output stream
+    /// output all completed information in the output Document to the output
+    /// stream, and release it
 
     /// may call output_header() first
     if ( _debug ){
@@ -1108,20 +1293,336 @@ namespace folia {
       if ( !_header_done ){
 	output_header();
       }
-      stack<FoliaElement*> rem_list;
-      size_t length = _root_node->size();
-      for ( size_t i=0; i < length; ++i ){
-	rem_list.push( _root_node->index(i) );
-	*_os << "    " << _root_node->index(i)->xmlstring(true,2,false) << endl;
+      set<FoliaElement*> blocked;
+      for ( auto *pnt : _pinned ){
+	// a node in the hands of a worker thread blocks all of its ancestors
+	while ( pnt && blocked.insert( pnt ).second ){
+	  pnt = pnt->parent();
+	}
+      }
+      flush_children( 0, open_path(), blocked );
+      _out_doc->release_kept();
+      if ( _flush_limit > 0 ){
+	// only needed for auto_flush()
+	_pending_nodes = count_nodes( _root_node );
+	_kept_nodes = _pending_nodes;
+      }
+    }
+  }
+
+  void Engine::set_flush_limit( size_t limit ){
+    /// set a limit on the number of nodes kept in memory
+    /*!
+      \param limit when more than this number of new FoLiA nodes is parsed
+      since the last flush(), flush() is called automatically. 0 (the
+      default) switches this off.
+
+      Only nodes that are completely parsed are output and released, and
+      never a part of a Sentence. Note that the nodes returned by get_node()
+      or next_text_parent() are released too, so the caller should be done
+      with a node before asking for the next one.
+    */
+    _flush_limit = limit;
+    if ( _root_node ){
+      _pending_nodes = count_nodes( _root_node );
+      _kept_nodes = _pending_nodes;
+    }
+  }
+
+  void Engine::auto_flush(){
+    /// call flush() when the limit set with set_flush_limit() is exceeded
+    if ( _flush_limit > 0
+	 && _os
+	 && !_finished
+	 && _pending_nodes > _kept_nodes + _flush_limit ){
+      flush();
+    }
+  }
+
+  static void destroy_unowned( FoliaElement *el ){
+    /// destroy a parentless subtree that nothing outside it refers to
+    /*!
+      \param el the root of the subtree. May be 0.
+
+      The subtree is taken apart completely, like ~Document() does.
+    */
+    if ( el ){
+      set<FoliaElement*> bulk;
+      el->unravel( bulk );
+      for ( const auto& it : bulk ){
+	it->destroy();
+      }
+    }
+  }
+
+  string Engine::scratch_template() const {
+    /// build a FoLiA document with the metadata of _out_doc and an empty body
+    /*!
+      \return the document as a string. It is used to set up the private
+      Documents of the worker threads in run_pipeline().
+    */
+    ostringstream os;
+    string tail;
+    xmlDoc *skeleton = _out_doc->open_stream( os, ns_prefix, _root_node, tail );
+    string start_tag;
+    string end_tag;
+    set<const FoliaElement*> folded;
+    bool ok = _out_doc->stream_tags( skeleton, _root_node, 1,
+				     start_tag, end_tag, folded );
+    xmlFreeDoc( skeleton );
+    if ( !ok ){
+      throw logic_error( "folia::Engine unable to output <"
+			 + _root_node->xmltag() + ">" );
+    }
+    os << start_tag << end_tag << tail;
+    return os.str();
+  }
+
+  /// one matched subtree, on its way through the pipeline of run_pipeline()
+  struct pipeline_job {
+    FoliaElement *node;   ///< the node in _out_doc to replace
+    xmlDoc *input;        ///< a copy of the XML input for the node
+    int space;            ///< the xml:space value of the context of the node
+    FoliaElement *output; ///< the result of the worker, without a Document
+    exception_ptr error;  ///< what went wrong in the worker, if anything
+    bool done;            ///< is the worker finished?
+  };
+
+  void Engine::run_pipeline( const function<FoliaElement*()>& next_node,
+			     const node_handler& handler,
+			     unsigned int threads,
+			     size_t max_pending ){
+    /// handle all nodes produced by next_node with handler, in parallel
+    /*!
+      \param next_node the function that returns the next node to handle,
+      or 0 when there are no more.
+      \param handler the function to call on every node
+      \param threads the number of worker threads. 0 means: one per core.
+      \param max_pending the maximum number of nodes in the pipeline.
+      0 means: 4 per thread.
+
+      The calling thread reads the input and writes the output. The nodes
+      it finds are handed to the workers. Because a Document may only be
+      used from one thread at a time, every worker parses its copy of the
+      node in a private Document, which has the same metadata as _out_doc.
+      The handled node is detached from that Document, and the calling
+      thread moves it into _out_doc, in place of the original node, in
+      document order. So every node is parsed twice, but never serialized
+      in between.
+      When there is an output stream, everything that is completed is
+      flushed. So memory use is bounded by max_pending.
+    */
+    if ( threads == 0 ){
+      threads = std::max( 1U, thread::hardware_concurrency() );
+    }
+    if ( max_pending == 0 ){
+      max_pending = 4 * threads;
+    }
+    const string skeleton = scratch_template();
+    const Document::Mode scratch_mode
+      = Document::Mode( int(_out_doc->mode) & ~Document::ARENA );
+    // the defaults of the input file may differ from the declarations now
+    const auto orig_sets = _out_doc->_orig_ann_default_sets;
+    const auto orig_procs = _out_doc->_orig_ann_default_procs;
+    deque<pipeline_job*> todo;
+    bool stop = false;
+    mutex job_lock;
+    condition_variable todo_signal;
+    condition_variable done_signal;
+    auto worker = [&](){
+      Document scratch;
+      exception_ptr setup_error;
+      try {
+	scratch.mode = scratch_mode;
+	scratch.set_incremental( true );
+	scratch.read_from_string( skeleton );
+	scratch._orig_ann_default_sets = orig_sets;
+	scratch._orig_ann_default_procs = orig_procs;
+      }
+      catch ( ... ){
+	setup_error = current_exception();
+      }
+      while ( true ){
+	pipeline_job *job;
+	{
+	  unique_lock<mutex> lock( job_lock );
+	  todo_signal.wait( lock, [&]{ return stop || !todo.empty(); } );
+	  if ( stop ){
+	    return;
+	  }
+	  job = todo.front();
+	  todo.pop_front();
+	}
+	FoliaElement *el = 0;
+	try {
+	  if ( setup_error ){
+	    rethrow_exception( setup_error );
+	  }
+	  const xmlNode *in = xmlDocGetRootElement( job->input )->children;
+	  el = AbstractElement::createElement( to_string(in->name), &scratch );
+	  el->parseXml( in );
+	  handler( el );
+	  scratch.disown( el );
+	  job->output = el;
+	}
+	catch ( ... ){
+	  job->error = current_exception();
+	  destroy_unowned( el );
+	}
+	xmlFreeDoc( job->input );
+	job->input = 0;
+	{
+	  lock_guard<mutex> lock( job_lock );
+	  job->done = true;
+	}
+	done_signal.notify_all();
+      }
+    };
+    vector<thread> pool;
+    deque<pipeline_job*> in_flight; // in document order
+    auto stop_pool = [&](){
+      {
+	lock_guard<mutex> lock( job_lock );
+	stop = true;
+      }
+      todo_signal.notify_all();
+      for ( auto& t : pool ){
+	t.join();
+      }
+      pool.clear();
+      for ( auto *job : in_flight ){
+	xmlFreeDoc( job->input );
+	destroy_unowned( job->output );
+	delete job;
       }
-      while ( !rem_list.empty() ){
-	// we've kept a stack of elements to remove, as removing at the back
-	// is the safest and cheapest thing to do
-	_root_node->remove( rem_list.top() );
-	destroy( rem_list.top() );
-	rem_list.pop();
+      in_flight.clear();
+      _pinned.clear();
+    };
+    try {
+      for ( unsigned int t=0; t < threads; ++t ){
+	pool.emplace_back( worker );
+      }
+      bool exhausted = false;
+      while ( true ){
+	while ( !exhausted && in_flight.size() < max_pending ){
+	  FoliaElement *node = next_node();
+	  if ( !node ){
+	    exhausted = true;
+	    break;
+	  }
+	  // the reader is still positioned at the matched node
+	  pipeline_job *job = new pipeline_job{ node, 0, -1, 0, 0, false };
+	  in_flight.push_back( job );
+	  // the copy gets a parent, with the xml:space value of the context
+	  xmlNode *in = xmlTextReaderExpand(_reader);
+	  job->space = xmlNodeGetSpacePreserve( in->parent );
+	  job->input = xmlNewDoc( to_xmlChar("1.0") );
+	  xmlNode *root = xmlNewDocNode( job->input, 0, to_xmlChar("FoLiA"), 0 );
+	  xmlDocSetRootElement( job->input, root );
+	  if ( job->space >= 0 ){
+	    xmlNodeSetSpacePreserve( root, job->space );
+	  }
+	  xmlAddChild( root, xmlDocCopyNode( in, job->input, 1 ) );
+	  _pinned.insert( node );
+	  {
+	    lock_guard<mutex> lock( job_lock );
+	    todo.push_back( job );
+	  }
+	  todo_signal.notify_one();
+	}
+	if ( in_flight.empty() ){
+	  break;
+	}
+	pipeline_job *job = in_flight.front();
+	{
+	  unique_lock<mutex> lock( job_lock );
+	  done_signal.wait( lock, [&]{ return job->done; } );
+	}
+	if ( job->error ){
+	  rethrow_exception( job->error );
+	}
+	in_flight.pop_front();
+	_pinned.erase( job->node );
+	// replace the node by the result. The id's of the old one must go
+	// first, as the new one will carry the same xml:id's
+	FoliaElement *old = job->node;
+	vector<FoliaElement*> stack( 1, old );
+	set<FoliaElement*> seen;
+	while ( !stack.empty() ){
+	  FoliaElement *el = stack.back();
+	  stack.pop_back();
+	  if ( seen.insert( el ).second ){
+	    _out_doc->del_doc_index( el->id(), el );
+	    stack.insert( stack.end(), el->data().begin(), el->data().end() );
+	  }
+	}
+	FoliaElement *fresh = job->output;
+	job->output = 0;
+	delete job;
+	try {
+	  // registers the xml:id's and checks the declarations
+	  fresh->assignDoc( _out_doc );
+	}
+	catch ( ... ){
+	  destroy_unowned( fresh );
+	  throw;
+	}
+	FoliaElement *parent = old->parent();
+	parent->replace( old, fresh );
+	// replace() skips what append() does on top of that
+	if ( fresh->referable() ){
+	  fresh->increfcount();
+	}
+	if ( fresh->spaces_flag() == SPACE_FLAGS::UNSET ){
+	  fresh->set_spaces_flag( parent->spaces_flag() );
+	}
+	fresh->postappend();
+	old->set_parent( 0 );
+	if ( _last_added == old ){
+	  _last_added = fresh;
+	}
+	if ( _external_node == old ){
+	  _external_node = fresh;
+	}
+	_out_doc->destroy_flushed( old );
+	_out_doc->release_kept();
+	_pending_nodes += count_nodes( fresh );
+	if ( _os ){
+	  flush();
+	}
       }
     }
+    catch ( ... ){
+      stop_pool();
+      throw;
+    }
+    stop_pool();
+  }
+
+  void Engine::process( const string& tag,
+			const node_handler& handler,
+			unsigned int threads,
+			size_t max_pending ){
+    /// call handler on every node with 'tag', using a pool of threads
+    /*!
+      \param tag the tag or a list of tags we are looking for. See get_node()
+      \param handler the function to call on every node found
+      \param threads the number of worker threads. 0 means: one per core.
+      \param max_pending the maximum number of nodes in progress.
+      0 means: 4 per thread.
+
+      This is the parallel equivalent of a loop over get_node(). The handler
+      gets a copy of the node, which lives in a private Document of the
+      worker thread. So the handler may modify the subtree below the node,
+      but it can't look at its parent or at the rest of the Document.
+      All annotations the handler adds must be declared beforehand.
+
+      When an output file is connected, the results are flushed as soon as
+      possible, in document order. Afterwards, call finish() as usual.
+    */
+    NodeMatcher matcher( tag );
+    run_pipeline( [&](){ return get_node( matcher ); },
+		  handler, threads, max_pending );
   }
 
   void Engine::finish() {
@@ -1159,6 +1660,244 @@ namespace folia {
   }
 
 
+  class text_parent_scanner {
+    /// find the text parents of an input file while reading it
+    /*!
+      This computes the same mapping as
+      TextEngine::enumerate_text_parents() does without prefer_struct, but
+      it does so lazily. Instead of the full xml_tree, only the chain of
+      currently open nodes and the text parents not yet handed out are
+      kept. A node is a text parent when it has a \<t> child and no text
+      parent below it, so the scanner never has to look further ahead than
+      the end of the next text parent.
+
+      Note that this still is a second parse of the input: the scanner uses
+      its own xmlTextReader, running just ahead of the main one.
+
+      When preferring structure, an open structure node like \<text> may
+      still become a text parent until it is closed. Nothing could be
+      handed out before the end of the document, so that case is left to
+      enumerate_text_parents().
+    */
+  public:
+    text_parent_scanner( xmlTextReader *reader,
+			 const string& textclass,
+			 bool debug,
+			 TiCC::LogStream *dbg_file ):
+      _reader( reader ),
+      _textclass( textclass ),
+      _index( 0 ),
+      _consumed( -1 ),
+      _eof( false ),
+      _debug( debug ),
+      _dbg_file( dbg_file )
+    {};
+    ~text_parent_scanner(){
+      xmlFreeTextReader( _reader );
+    };
+    bool first( int& );
+    int successor( int );
+    size_t count();
+  private:
+    struct open_node {
+      int index;
+      int depth;
+      string tag;
+      bool searched;
+      bool has_text;      // there is a <t> child in the wanted textclass
+      bool deeper;        // text is found in a deeper node
+      bool key_below;     // a text parent is found in this subtree
+      vector<int> waiting; // text parents that need our successor
+    };
+    xmlTextReader *_reader;
+    string _textclass;
+    vector<open_node> _stack;
+    map<int,int> _keys;
+    int _index;
+    int _consumed;
+    bool _eof;
+    bool _debug;
+    TiCC::LogStream *_dbg_file;
+    void advance();
+    void close_top( int );
+    void add_key( int, int );
+    bool may_become_key( const open_node& ) const;
+    bool next_key( int, int& );
+  };
+
+  bool text_parent_scanner::may_become_key( const open_node& node ) const {
+    /// can this still open node turn into a text parent when it is closed?
+    /*!
+      \param node the open node to check
+
+      Once a text parent below it is found, it can't.
+    */
+    if ( !node.searched
+	 || node.tag[0] == '#'
+	 || node.tag[0] == '?' ){
+      return false;
+    }
+    return !node.key_below;
+  }
+
+  void text_parent_scanner::add_key( int key, int next ){
+    /// register a text parent.
+    /*!
+      \param key the index of the text parent
+      \param next the index to continue with, after the last text parent.
+      -1 when still to be determined
+
+      text parents at or before the last handed out one are not relevant
+      anymore. For a text parent found twice, the first one found wins.
+    */
+    if ( key > _consumed ){
+      _keys.insert( make_pair( key, next ) );
+    }
+  }
+
+  void text_parent_scanner::close_top( int succ ){
+    /// close the innermost open node
+    /*!
+      \param succ the index of the next sibling of that node, or -1 when
+      there is none
+
+      This does for one node what TextEngine::search_text_parents() does
+      for the list of children of that node.
+    */
+    open_node node = std::move( _stack.back() );
+    _stack.pop_back();
+    for ( const auto& key : node.waiting ){
+      auto it = _keys.find( key );
+      if ( it != _keys.end() ){
+	it->second = ( succ < 0 ) ? INT_MAX : succ;
+      }
+    }
+    if ( !node.searched ){
+      return;
+    }
+    bool found = node.deeper;
+    if ( !found && node.has_text ){
+      found = true;
+      if ( succ >= 0 ){
+	add_key( node.index, succ );
+      }
+      else if ( !_stack.empty() ){
+	add_key( node.index, -1 );
+	_stack.back().waiting.push_back( node.index );
+      }
+      else {
+	add_key( node.index, INT_MAX );
+      }
+      for ( auto& it : _stack ){
+	it.key_below = true;
+      }
+    }
+    if ( found && !_stack.empty() ){
+      _stack.back().deeper = true;
+    }
+  }
+
+  void text_parent_scanner::advance(){
+    /// read the next relevant node from the input
+    simple_record rec;
+    if ( !read_simple_record( _reader, rec, _debug, _dbg_file ) ){
+      while ( !_stack.empty() ){
+	close_top( -1 );
+      }
+      _eof = true;
+      return;
+    }
+    int index = _index++;
+    if ( !_stack.empty()
+	 && rec.depth <= _stack.back().depth ){
+      // a new sibling. close the nodes that are done
+      while ( _stack.size() > 1
+	      && _stack.back().depth > rec.depth ){
+	close_top( -1 );
+      }
+      close_top( index );
+    }
+    bool searched = _stack.empty()
+      || ( _stack.back().searched
+	   && rec.tag != "wref"
+	   && rec.tag != "original" );
+    if ( rec.tag == "t"
+	 && rec.textclass == _textclass
+	 && !_stack.empty()
+	 && _stack.back().searched ){
+      _stack.back().has_text = true;
+    }
+    _stack.push_back( { index, rec.depth, rec.tag, searched,
+			false, false, false, {} } );
+  }
+
+  bool text_parent_scanner::next_key( int prev, int& result ){
+    /// find the first text parent after prev
+    /*!
+      \param prev the index to search after
+      \param result the index of the text parent found
+      \return false when there are no more text parents
+    */
+    while ( true ){
+      auto it = _keys.upper_bound( prev );
+      if ( it != _keys.end() ){
+	bool decided = true;
+	for ( auto& node : _stack ){
+	  if ( node.index > prev
+	       && node.index < it->first
+	       && may_become_key( node ) ){
+	    decided = false;
+	    break;
+	  }
+	}
+	if ( decided ){
+	  result = it->first;
+	  return true;
+	}
+      }
+      else if ( _eof ){
+	return false;
+      }
+      advance();
+    }
+  }
+
+  bool text_parent_scanner::first( int& result ){
+    /// find the first text parent
+    /*!
+      \param result the index of the first text parent
+      \return false when there are no text parents at all
+    */
+    return next_key( _consumed, result );
+  }
+
+  int text_parent_scanner::successor( int key ){
+    /// return the index to search for after handing out key
+    /*!
+      \param key the index of the text parent just handed out
+      \return the index of the next text parent. For the last one, the
+      successor of that node in the input. 0 when key is not a text parent.
+    */
+    if ( _keys.find( key ) == _keys.end() ){
+      return 0;
+    }
+    int result;
+    if ( !next_key( key, result ) ){
+      result = _keys[key];
+    }
+    _keys.erase( _keys.begin(), _keys.upper_bound( key ) );
+    _consumed = key;
+    return result;
+  }
+
+  size_t text_parent_scanner::count(){
+    /// scan to the end of the input and return the number of text parents
+    while ( !_eof ){
+      advance();
+    }
+    return _keys.size();
+  }
+
   bool TextEngine::init_doc( const string& i, const string& o ){
     /// init an associated document for this TextEngine
     /*!
@@ -1170,31 +1909,86 @@ namespace folia {
     */
     _in_file = i;
     _is_setup = false;
+    delete _scanner;
+    _scanner = 0;
     //    set_debug(true);
     return Engine::init_doc( i, o );
   }
 
-  void TextEngine::setup( const string& textclass, bool prefer_struct ){
+  TextEngine::~TextEngine(){
+    /// destroy a TextEngine
+    delete _scanner;
+  }
+
+  void TextEngine::setup( const string& textclass,
+			  bool prefer_struct,
+			  bool single_pass ){
     /// set the TextEngine ready for parsing
     /*!
       \param textclass Determines which textnodes to search for
       \param prefer_struct If TRUE, set the TextEngine up for returning
       Structure nodes like sentences or paragraphs above returning
       just Word or String nodes
+      \param single_pass If TRUE, the text parents are found while parsing,
+      by a second reader that runs only as far ahead as needed. That is
+      still a second parse of the input, but without building the xml_tree
+      in memory. If FALSE (the default), the whole input is scanned first,
+      using enumerate_text_parents(). Both give the same text parents.
+      single_pass is ignored when prefer_struct is TRUE: then the \<text>
+      node itself may become a text parent until it is closed, so the whole
+      input has to be scanned first anyway.
     */
     string txtc = textclass;
     if ( txtc == "current" ){
       txtc.clear();
     }
-    text_parent_map = enumerate_text_parents( txtc, prefer_struct );
+    delete _scanner;
+    _scanner = 0;
+    text_parent_map.clear();
+    _textclass = txtc;
     _next_text_node = _start_index;
-    if ( !text_parent_map.empty() ){
-      _next_text_node = text_parent_map.begin()->first;
+    if ( single_pass && !prefer_struct ){
+      if ( _done ){
+	throw runtime_error( "setup() called on a done engine" );
+      }
+      xmlTextReader *cur_reader = create_text_reader( _in_file );
+      if ( xmlTextReaderReadState(cur_reader) < 0 ){
+	xmlFreeTextReader( cur_reader );
+	throw runtime_error( "setup() init failed" );
+      }
+      _scanner = new text_parent_scanner( cur_reader, txtc,
+					  _debug, _dbg_file );
+      int first = 0;
+      _has_text_parents = _scanner->first( first );
+      if ( _has_text_parents ){
+	_next_text_node = first;
+      }
+    }
+    else {
+      text_parent_map = enumerate_text_parents( txtc, prefer_struct );
+      if ( !text_parent_map.empty() ){
+	_next_text_node = text_parent_map.begin()->first;
+      }
+      _has_text_parents = !text_parent_map.empty();
     }
     _node_count = _start_index;
     _is_setup = true;
   }
 
+  size_t TextEngine::text_parent_count() const {
+    /// return the number of textparents found
+    /*!
+      When setup() was done in single pass mode, this scans the whole
+      input again, so avoid it on large files.
+    */
+    if ( _scanner ){
+      xmlTextReader *cur_reader = create_text_reader( _in_file );
+      text_parent_scanner scanner( cur_reader, _textclass, false, 0 );
+      return scanner.count();
+    }
+    return text_parent_map.size();
+  }
+
   xml_tree *get_structure_parent( const xml_tree *pnt ){
     ///  return the nearest StructureElement above this node
     /*!
@@ -1349,6 +2143,26 @@ namespace folia {
     return text_parent_map;
   }
 
+  void TextEngine::process( const node_handler& handler,
+			    unsigned int threads,
+			    size_t max_pending ){
+    /// call handler on every text parent, using a pool of threads
+    /*!
+      \param handler the function to call on every text parent
+      \param threads the number of worker threads. 0 means: one per core.
+      \param max_pending the maximum number of nodes in progress.
+      0 means: 4 per thread.
+
+      This is the parallel equivalent of a loop over next_text_parent().
+      See Engine::process() for the details.
+    */
+    if ( !_is_setup ){
+      throw runtime_error( "TextEngine: not setup yet!" );
+    }
+    run_pipeline( [&](){ return next_text_parent(); },
+		  handler, threads, max_pending );
+  }
+
   FoliaElement *TextEngine::next_text_parent(){
     /// return the next node to handle
     /*!
@@ -1371,12 +2185,13 @@ namespace folia {
     if ( !_is_setup ){
       throw runtime_error( "TextEngine: not setup yet!" );
     }
-    if ( text_parent_map.empty() ){
+    if ( !_has_text_parents ){
       if ( _debug ){
 	DBG << "next_text_parent(). the parent map is empty." << endl;
       }
       return 0;
     }
+    auto_flush();
 
     int ret = 0;
     if ( _external_node != 0 ){
@@ -1418,14 +2233,18 @@ namespace folia {
 	  _external_node = handle_match( local_name, new_depth );
 	  int skips = count_nodes( _external_node );
 	  // we are to output a tree of skips nodes
+	  _node_count += skips; // so next time we resume with this count
+	  if ( _scanner ){
+	    _next_text_node = _scanner->successor( _next_text_node );
+	  }
+	  else {
+	    _next_text_node = text_parent_map[_next_text_node];
+	  }
 	  if ( _debug ){
-	    DBG << " increment _node_count=" << _node_count << " with: "
-		<< skips << " to " << _node_count + skips << " searching for: "
-		<< _next_text_node << " which gives node: "
-		<< text_parent_map[_next_text_node] << endl;
+	    DBG << " incremented _node_count with: " << skips << " to "
+		<< _node_count << " now searching for: "
+		<< _next_text_node << endl;
 	  }
-	  _node_count += skips; // so next time we resume with this count
-	  _next_text_node = text_parent_map[_next_text_node];
 	  // and we have to search for _next_text_node
 	  return _external_node;
 	}
@@ -35,6 +35,7 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <charconv>
 #include <type_traits>
 #include <stdexcept>
 #include "ticcutils/PrettyPrint.h"
@@ -213,6 +214,7 @@ namespace folia {
     }
     string r = _tags;
     _tags = t;
+    text_changed();
     return r;
   }
 
@@ -279,7 +281,8 @@ namespace folia {
     _line_no(-1),
     _confidence(-1),
     _preserve_spaces(SPACE_FLAGS::UNSET),
-    _props(p)
+    _props(p),
+    _text_checked(false)
   {
 #ifdef DE_AND_CONSTRUCT_DEBUG
     dbg( "created" );
@@ -303,6 +306,25 @@ namespace folia {
 #endif
   }
 
+  void *AbstractElement::operator new( size_t size ){
+    /// allocate a new FoliaElement
+    /*!
+     * \param size the size of the object
+     * When an ElementArena is active (as set by a Document in 'arena' mode)
+     * the object is allocated there. Otherwise it is allocated on the heap.
+     */
+    return ElementArena::allocate_element( size );
+  }
+
+  void AbstractElement::operator delete( void *p ){
+    /// release the memory of a FoliaElement
+    /*!
+     * \param p the object to release
+     * Memory owned by an ElementArena is only freed together with the arena.
+     */
+    ElementArena::release_element( p );
+  }
+
   //#define DE_AND_CONSTRUCT_DEBUG
   void AbstractElement::destroy( ) {
     /// Pseudo destructor for AbstractElements.
@@ -328,7 +350,7 @@ namespace folia {
 #endif
 	return;
       }
-      doc()->del_doc_index( _id );
+      doc()->del_doc_index( _id, this );
     }
     if ( _parent ){
 #ifdef DE_AND_CONSTRUCT_DEBUG
@@ -392,7 +414,8 @@ namespace folia {
     if ( _mydoc ){
       string def;
       if ( !_set.empty() ){
-	if ( !doc()->declared( annotation_type(), _set ) ) {
+	if ( !doc()->trusted_input()
+	     && !doc()->declared( annotation_type(), _set ) ) {
 	  throw DeclarationError( this,
 				  "Set '" + _set
 				  + "' is used but has no declaration " +
@@ -1094,6 +1117,8 @@ namespace folia {
     }
     kwargs.erase("typegroup"); //this is used in explicit form only, we can safely discard it
     addFeatureNodes( kwargs );
+    // class, offset or space may have changed
+    text_changed();
 #ifdef LOG_SET_ATT
     if ( doc() ){
       doc()->setdebug(db_level);
@@ -1960,6 +1985,35 @@ namespace folia {
      * \param kanon Output in a canonical form to make comparions easy
      * \return am xmlNode object(-tree)
      */
+    vector<pair<const FoliaElement*,bool>> children;
+    xmlNode *e = AbstractElement::xml_head( kanon, children );
+    if ( _data.empty() ){
+      return e; // we are done
+    }
+    if ( recursive ) {
+      for ( const auto& child : children ){
+	xmlAddChild( e, child.first->xml( recursive, child.second ) );
+      }
+      if ( !doc()->trusted_output() && text_check_pending() ){
+	check_text_consistency();
+      }
+    }
+    return e;
+  }
+
+  xmlNode *AbstractElement::xml_head( bool kanon,
+				      vector<pair<const FoliaElement*,bool>>& children ) const {
+    /// convert an Element to a childless xmlNode, and list what goes inside
+    /*!
+     * \param kanon Output in a canonical form to make comparions easy
+     * \param children returns the children to serialize, in output order,
+     * each with the \e kanon value to use for it
+     * \return an xmlNode with all the attributes, but without children
+     *
+     * This is the part of xml() that is shared with the streaming output
+     * of Document::save(). Attribute folding and the ordering of the
+     * children are decided here.
+     */
     xmlNode *e = XmlNewNode( foliaNs(), xmltag() );
     KWargs attribs = collectAttributes();
     if ( _preserve_spaces == SPACE_FLAGS::PRESERVE ){
@@ -2003,76 +2057,73 @@ namespace folia {
       }
     }
     addAttributes( e, attribs );
+    children.clear();
     if ( _data.empty() ){
-      return e; // we are done
-    }
-    if ( recursive ) {
-      // append children:
-      // we want make sure that text elements are in the right order,
-      // in front and the 'current' class first
-      list<FoliaElement *> currenttextelements;
-      list<FoliaElement *> textelements;
-      list<FoliaElement *> otherelements;
-      list<FoliaElement *> commentelements;
-      list<FoliaElement *> PIelements;
-      multimap<ElementType, FoliaElement *, std::greater<ElementType>> otherelementsMap;
-      for ( const auto& el : _data ) {
-	if ( attribute_elements.find(el) == attribute_elements.end() ) {
-	  if ( el->isinstance(TextContent_t) ) {
-	    if ( el->cls() == "current" ) {
-	      currenttextelements.push_back( el );
-	    }
-	    else {
-	      textelements.push_back( el );
-	    }
+      return e;
+    }
+    // we want make sure that text elements are in the right order,
+    // in front and the 'current' class first
+    list<FoliaElement *> currenttextelements;
+    list<FoliaElement *> textelements;
+    list<FoliaElement *> otherelements;
+    list<FoliaElement *> commentelements;
+    list<FoliaElement *> PIelements;
+    multimap<ElementType, FoliaElement *, std::greater<ElementType>> otherelementsMap;
+    for ( const auto& el : _data ) {
+      if ( attribute_elements.find(el) == attribute_elements.end() ) {
+	if ( el->isinstance(TextContent_t) ) {
+	  if ( el->cls() == "current" ) {
+	    currenttextelements.push_back( el );
+	  }
+	  else {
+	    textelements.push_back( el );
+	  }
+	}
+	else {
+	  if ( kanon ) {
+	    otherelementsMap.insert( make_pair( el->element_id(), el ) );
 	  }
 	  else {
-	    if ( kanon ) {
-	      otherelementsMap.insert( make_pair( el->element_id(), el ) );
+	    if ( el->isinstance(XmlComment_t)
+		 && currenttextelements.empty()
+		 && textelements.empty() ) {
+	      commentelements.push_back( el );
+	    }
+	    else if ( el->isinstance(ProcessingInstruction_t)
+		      && currenttextelements.empty()
+		      && textelements.empty() ) {
+	      PIelements.push_back( el );
 	    }
 	    else {
-	      if ( el->isinstance(XmlComment_t)
-		   && currenttextelements.empty()
-		   && textelements.empty() ) {
-		commentelements.push_back( el );
-	      }
-	      else if ( el->isinstance(ProcessingInstruction_t)
-		   && currenttextelements.empty()
-		   && textelements.empty() ) {
-		PIelements.push_back( el );
-	      }
-	      else {
-		otherelements.push_back( el );
-	      }
+	      otherelements.push_back( el );
 	    }
 	  }
 	}
       }
-      for ( const auto* cel : commentelements ) {
-	xmlAddChild( e, cel->xml( recursive, kanon ) );
-      }
-      for ( const auto* pel : PIelements ) {
-	xmlAddChild( e, pel->xml( recursive, kanon ) );
-      }
-      for ( const auto* tel : currenttextelements ) {
-	xmlAddChild( e, tel->xml( recursive, false ) );
-	// don't change the internal sequences of TextContent elements
-      }
-      for ( const auto* tel : textelements ) {
-	xmlAddChild( e, tel->xml( recursive, false ) );
-	// don't change the internal sequences of TextContent elements
-      }
-      if ( !kanon ) {
-	for ( const auto* oem : otherelements ) {
-	  xmlAddChild( e, oem->xml( recursive, kanon ) );
-	}
+    }
+    for ( const auto* cel : commentelements ) {
+      children.push_back( make_pair( cel, kanon ) );
+    }
+    for ( const auto* pel : PIelements ) {
+      children.push_back( make_pair( pel, kanon ) );
+    }
+    for ( const auto* tel : currenttextelements ) {
+      children.push_back( make_pair( tel, false ) );
+      // don't change the internal sequences of TextContent elements
+    }
+    for ( const auto* tel : textelements ) {
+      children.push_back( make_pair( tel, false ) );
+      // don't change the internal sequences of TextContent elements
+    }
+    if ( !kanon ) {
+      for ( const auto* oem : otherelements ) {
+	children.push_back( make_pair( oem, kanon ) );
       }
-      else {
-	for ( const auto& oem : otherelementsMap ) {
-	  xmlAddChild( e, oem.second->xml( recursive, kanon ) );
-	}
+    }
+    else {
+      for ( const auto& oem : otherelementsMap ) {
+	children.push_back( make_pair( oem.second, kanon ) );
       }
-      check_text_consistency();
     }
     return e;
   }
@@ -2175,7 +2226,7 @@ namespace folia {
      * the document level, where it will return the Documents language
      * Might return "" when no match is found
      */
-    set<ElementType> exclude;
+    ElementTypeSet exclude;
     vector<LangAnnotation*> v = select<LangAnnotation>( st, exclude, false );
     if ( v.size() > 0 ){
       return v[0]->cls();
@@ -2451,11 +2502,70 @@ namespace folia {
     /// get the UnicodeString text value of an element
     /*!
      * \param tp a TextPolicy
+     *
+     * In TEXTCACHE mode the result is remembered per textclass, TEXT_FLAGS
+     * and correction handling, until this node or one of its descendants
+     * is modified. Policies with tag handlers or debugging are never cached.
      */
     if ( tp.debug() ){
       cerr << "DEBUG <" << xmltag() << ">.text() Policy=" << tp << endl;
     }
-    return private_text( tp );
+    if ( !doc()
+	 || !doc()->textcache()
+	 || tp.debug()
+	 || tp.has_handlers()
+	 || element_id() == XmlText_t ){
+      return private_text( tp );
+    }
+    if ( _text_cache ){
+      for ( const auto& entry : *_text_cache ){
+	if ( entry.flags == tp.get_flags()
+	     && entry.handling == tp.get_correction_handling()
+	     && entry.cls == tp.get_class() ){
+	  return entry.value;
+	}
+      }
+    }
+    else {
+      _text_cache.reset( new vector<cached_text> );
+    }
+    UnicodeString result = private_text( tp );
+    _text_cache->push_back( { tp.get_class(),
+			      tp.get_flags(),
+			      tp.get_correction_handling(),
+			      result } );
+    return result;
+  }
+
+  void AbstractElement::text_changed() const {
+    /// register a change of the text of this node and all its ancestors
+    /*!
+     * Called on every modification of the children of a node, and of the
+     * attributes that influence text(). The nodes lose their text_checked()
+     * state, and in TEXTCACHE mode their cached text() results.
+     *
+     * An unchecked node never has checked ancestors, so without a cache
+     * we can stop at the first unchecked node.
+     */
+    bool cached = doc() && doc()->textcache();
+    for ( const FoliaElement *el = this; el; el = el->parent() ){
+      if ( !cached && !el->text_checked() ){
+	break;
+      }
+      el->set_text_checked( false );
+      if ( cached ){
+	el->drop_text_cache();
+      }
+    }
+  }
+
+  bool FoliaElement::text_check_pending() const {
+    /// does the text consistency of this node need a (re)check?
+    /*!
+     * The check of a node involves its parent. So it is needed when the
+     * node or its parent changed since the last check of the whole tree.
+     */
+    return !text_checked() || ( parent() && !parent()->text_checked() );
   }
 
   const UnicodeString AbstractElement::text( const string& cls,
@@ -2469,10 +2579,7 @@ namespace folia {
      */
     TextPolicy tp( cls, flags );
     tp.set_debug( debug );
-    if ( debug ){
-      cerr << "DEBUG <" << xmltag() << ">.text() Policy=" << tp << endl;
-    }
-    return private_text( tp );
+    return text( tp );
   }
 
   void FoLiA::setAttributes( KWargs& kwargs ){
@@ -3169,6 +3276,11 @@ namespace folia {
       *it = _new;
       result = old;
       _new->set_parent(this);
+      if ( doc() ){
+	doc()->structure_removed( old );
+	doc()->structure_added( _new );
+      }
+      text_changed();
     }
     return result;
   }
@@ -3185,6 +3297,15 @@ namespace folia {
     while ( it != _data.end() ) {
       if ( *it == pos ) {
 	it = _data.insert( ++it, add );
+	if ( doc() ){
+	  if ( add->parent() == this ){
+	    doc()->structure_added( add );
+	  }
+	  else {
+	    doc()->structure_changed( add );
+	  }
+	}
+	text_changed();
 	break;
       }
       ++it;
@@ -3355,7 +3476,9 @@ namespace folia {
      * the doc has autodeclare mode set, it is attempted to do so.
      * For TextContent and PhonContent, a default is added too
      *
-     * Also the ID is registered in the_doc.
+     * Also the ID is registered in the_doc. For a subtree that is moved
+     * from another Document, see Document::disown(), the use of the
+     * annotation set is counted too.
      *
      * Finaly, all children are also assigned to the_doc
      */
@@ -3410,6 +3533,13 @@ namespace folia {
       if ( !_id.empty() ) {
 	_mydoc->add_doc_index( this );
       }
+      if ( !_class.empty()
+	   && element_id() != TextContent_t
+	   && element_id() != PhonContent_t ){
+	// only possible for a subtree moved from another Document.
+	// count the reference, like setAttributes() does
+	_mydoc->incrRef( annotation_type(), _set );
+      }
       // assume that children also might be doc-less
       for ( const auto& el : _data ) {
 	el->assignDoc( _mydoc );
@@ -3520,7 +3650,8 @@ namespace folia {
     }
     bool ok = false;
     try {
-      ok = child->addable( this );
+      // a trusted tree was checked when it was saved
+      ok = ( doc() && doc()->trusted_input() ) || child->addable( this );
     }
     catch ( const XmlError& ) {
       // don't delete the offending child in case of illegal reconnection
@@ -3540,12 +3671,23 @@ namespace folia {
       if ( !child->parent() ) {
 	child->set_parent(this);
       }
+      if ( doc() ){
+	if ( child->parent() == this ){
+	  doc()->structure_added( child );
+	}
+	else {
+	  doc()->structure_changed( child );
+	}
+      }
       if ( child->referable() ){
 	child->increfcount();
       }
       if ( child->spaces_flag() == SPACE_FLAGS::UNSET ){
 	child->set_spaces_flag( _preserve_spaces );
       }
+      // the child may have cached text from before it was connected
+      child->drop_text_cache();
+      text_changed();
       return child->postappend();
     }
     return 0;
@@ -3570,7 +3712,12 @@ namespace folia {
     cerr << " id=" << _id << " class= " << endl;
 #endif
     auto it = std::remove( _data.begin(), _data.end(), child );
+    bool found = ( it != _data.end() );
     _data.erase( it, _data.end() );
+    if ( doc() && found ){
+      doc()->structure_removed( child );
+    }
+    text_changed();
   }
 
   FoliaElement* AbstractElement::index( size_t i ) const {
@@ -3617,9 +3764,39 @@ namespace folia {
     throw range_error( "[] rindex out of range" );
   }
 
+  template <typename MATCH>
+  static void select_matches( const FoliaElement *node,
+			      const MATCH& match,
+			      const ElementTypeSet& exclude,
+			      SELECT_FLAGS flag,
+			      vector<FoliaElement*>& res ){
+    /// the recursive worker for select() and select_set()
+    /*!
+     * \param node the node to search in
+     * \param match a predicate on FoliaElement nodes
+     * \param exclude a set of ElementType to exclude from searching.
+     * \param flag the SELECT_FLAGS strategy
+     * \param res the vector to add the matching nodes to
+     */
+    for ( const auto& el : node->data() ) {
+      if ( match( el ) ) {
+	res.push_back( el );
+	if ( flag == SELECT_FLAGS::TOP_HIT ){
+	  flag = SELECT_FLAGS::LOCAL;
+	}
+      }
+      if ( flag != SELECT_FLAGS::LOCAL ){
+	// not at this level, search deeper when recurse is true
+	if ( !exclude.contains( el->element_id() ) ) {
+	  select_matches( el, match, exclude, flag, res );
+	}
+      }
+    }
+  }
+
   vector<FoliaElement*> AbstractElement::select( ElementType et,
 						 const string& st,
-						 const set<ElementType>& exclude,
+						 const ElementTypeSet& exclude,
 						 SELECT_FLAGS flag ) const {
     /// The generic 'select()' function on which all other variants are based
     ///   it searches a FoLiA node for matchins sibblings.
@@ -3637,28 +3814,25 @@ namespace folia {
      *               of matching node
      */
     vector<FoliaElement*> res;
-    for ( const auto& el : _data ) {
-      if ( el->element_id() == et &&
-	   ( st.empty() || el->sett() == st ) ) {
-	res.push_back( el );
-	if ( flag == SELECT_FLAGS::TOP_HIT ){
-	  flag = SELECT_FLAGS::LOCAL;
-	}
-      }
-      if ( flag != SELECT_FLAGS::LOCAL ){
-	// not at this level, search deeper when recurse is true
-	if ( exclude.find( el->element_id() ) == exclude.end() ) {
-	  vector<FoliaElement*> tmp = el->select( et, st, exclude, flag );
-	  res.insert( res.end(), tmp.begin(), tmp.end() );
-	}
-      }
-    }
+    const string *set_handle = 0;
+    if ( !st.empty() ){
+      set_handle = interned_string::lookup( st );
+      if ( !set_handle ){
+	// no element can have this set
+	return res;
+      }
+    }
+    auto match = [et,set_handle]( const FoliaElement *el ){
+      return el->element_id() == et
+	&& ( !set_handle || &el->sett() == set_handle );
+    };
+    select_matches( this, match, exclude, flag, res );
     return res;
   }
 
-  vector<FoliaElement*> AbstractElement::select_set( const set<ElementType>& elts,
+  vector<FoliaElement*> AbstractElement::select_set( const ElementTypeSet& elts,
 						     const string& st,
-						     const set<ElementType>& exclude,
+						     const ElementTypeSet& exclude,
 						     SELECT_FLAGS flag ) const {
     /// A generic 'select()' function which returns all matching elements
     ///   it searches a FoLiA node for matching sibblings.
@@ -3679,22 +3853,19 @@ namespace folia {
      *
      */
     vector<FoliaElement*> res;
-    for ( const auto& el : _data ) {
-      if ( elts.find(el->element_id()) != elts.end() &&
-	   ( st.empty() || el->sett() == st ) ) {
-	res.push_back( el );
-	if ( flag == SELECT_FLAGS::TOP_HIT ){
-	  flag = SELECT_FLAGS::LOCAL;
-	}
-      }
-      if ( flag != SELECT_FLAGS::LOCAL ){
-	// not at this level, search deeper when recurse is true
-	if ( exclude.find( el->element_id() ) == exclude.end() ) {
-	  vector<FoliaElement*> tmp = el->select_set( elts, st, exclude, flag );
-	  res.insert( res.end(), tmp.begin(), tmp.end() );
-	}
-      }
-    }
+    const string *set_handle = 0;
+    if ( !st.empty() ){
+      set_handle = interned_string::lookup( st );
+      if ( !set_handle ){
+	// no element can have this set
+	return res;
+      }
+    }
+    auto match = [&elts,set_handle]( const FoliaElement *el ){
+      return elts.contains( el->element_id() )
+	&& ( !set_handle || &el->sett() == set_handle );
+    };
+    select_matches( this, match, exclude, flag, res );
     return res;
   }
 
@@ -3709,7 +3880,7 @@ namespace folia {
   }
 
   vector<FoliaElement*> AbstractElement::select( ElementType et,
-						 const set<ElementType>& exclude,
+						 const ElementTypeSet& exclude,
 						 SELECT_FLAGS flag ) const {
     /// wrapper around the the generic select()
     /*!
@@ -4156,26 +4327,24 @@ namespace folia {
       * if the child has an id, try to extract the last part as a number
       * if so, check the registration of that numer for the childs tag
       */
-    if ( !child->id().empty() && !child->xmltag().empty() ) {
-      vector<string> parts = TiCC::split_at( child->id(), "." );
-      if ( !parts.empty() ) {
-	string val = parts.back();
-	int i;
-	try {
-	  i = stringTo<int>( val );
-	}
-	catch ( const exception& ) {
-	  // no number, so assume some user defined id
-	  return;
-	}
-	const auto& it = id_map.find( child->xmltag() );
-	if ( it == id_map.end() ) {
-	  id_map[child->xmltag()] = i;
-	}
-	else {
-	  if ( it->second < i ) {
-	    it->second = i;
-	  }
+    const string& id = child->id();
+    if ( !id.empty() && !child->xmltag().empty() ) {
+      // the part after the last '.', parsed like stringTo<int> would,
+      // but without the cost of a stringstream for every node
+      const char *start = id.c_str() + id.rfind( '.' ) + 1;
+      int i;
+      auto res = from_chars( start, id.c_str() + id.size(), i );
+      if ( res.ec != errc() ){
+	// no number, so assume some user defined id
+	return;
+      }
+      const auto& it = id_map.find( child->xmltag() );
+      if ( it == id_map.end() ) {
+	id_map[child->xmltag()] = i;
+      }
+      else {
+	if ( it->second < i ) {
+	  it->second = i;
 	}
       }
     }
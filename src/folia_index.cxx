@@ -0,0 +1,786 @@
+/*
+  Copyright (c) 2006 - 2024
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of libfolia
+
+  libfolia is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  libfolia is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcutils/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "ticcutils/StringOps.h"
+#include "libfolia/folia_index.h"
+
+using namespace std;
+
+namespace folia {
+
+  /// the size of the buffers used for reading and (de)compressing
+  const size_t INDEX_BUFFER_SIZE = 64*1024;
+
+  /// the first line of a saved FragmentIndex
+  const string INDEX_MAGIC = "FoLiA-index 1";
+
+  class index_input {
+    /// sequential reading of a plain or a gzipped file.
+    /// Keeps track of the byte offset in the uncompressed data
+  public:
+    index_input( const string&, bool );
+    ~index_input();
+    int get(){
+      /// return the next byte, or EOF
+      if ( _cur == _end && !fill() ){
+	return EOF;
+      }
+      ++_pos;
+      return *_cur++;
+    }
+    size_t read( string&, size_t );
+    void seek( size_t, size_t );
+    /// return the offset of the next byte in the uncompressed data
+    size_t pos() const { return _pos; };
+    /// when set, the start of every gzip member is registered here
+    vector<pair<size_t,size_t>> *blocks;
+  private:
+    index_input( const index_input& ) = delete; // inhibit copies
+    index_input& operator=( const index_input& ) = delete; // inhibit copies
+    bool fill();
+    FILE *_file;
+    bool _gz;               // is the input gzipped?
+    bool _in_member;        // are we inside a gzip member?
+    z_stream _zs;
+    size_t _pos;            // uncompressed offset of the next byte
+    size_t _produced;       // uncompressed offset behind _end
+    size_t _read;           // compressed offset behind the input buffer
+    vector<unsigned char> _in;
+    vector<unsigned char> _out;
+    const unsigned char *_cur;
+    const unsigned char *_end;
+  };
+
+  index_input::index_input( const string& file_name, bool gz ):
+    blocks(0),
+    _gz( gz ),
+    _in_member( false ),
+    _pos(0),
+    _produced(0),
+    _read(0),
+    _in( gz ? INDEX_BUFFER_SIZE : 0 ),
+    _out( INDEX_BUFFER_SIZE ),
+    _cur(0),
+    _end(0)
+  {
+    /// open a file for reading
+    /*!
+      \param file_name the file to read
+      \param gz is the file gzip compressed?
+    */
+    _file = fopen( file_name.c_str(), "rb" );
+    if ( !_file ){
+      throw runtime_error( "FragmentIndex: unable to open: " + file_name );
+    }
+    if ( _gz ){
+      memset( &_zs, 0, sizeof(_zs) );
+      if ( inflateInit2( &_zs, 16+MAX_WBITS ) != Z_OK ){
+	fclose( _file );
+	throw runtime_error( "FragmentIndex: zlib initialization failed" );
+      }
+    }
+  }
+
+  index_input::~index_input(){
+    /// destructor
+    if ( _gz ){
+      inflateEnd( &_zs );
+    }
+    fclose( _file );
+  }
+
+  void index_input::seek( size_t offset, size_t compressed ){
+    /// continue reading at another position
+    /*!
+      \param offset the offset in the uncompressed data
+      \param compressed for gzip files: the offset of the gzip member that
+      starts at 'offset'. Ignored for plain files.
+    */
+    if ( _gz ){
+      fseek( _file, compressed, SEEK_SET );
+      inflateReset( &_zs );
+      _zs.avail_in = 0;
+      _in_member = false;
+      _read = compressed;
+    }
+    else {
+      fseek( _file, offset, SEEK_SET );
+    }
+    _pos = offset;
+    _produced = offset;
+    _cur = _end = 0;
+  }
+
+  bool index_input::fill(){
+    /// read (and decompress) the next chunk of the file into the buffer
+    /*!
+      \return false at the end of the file
+    */
+    if ( !_gz ){
+      size_t n = fread( _out.data(), 1, _out.size(), _file );
+      if ( n == 0 ){
+	return false;
+      }
+      _cur = _out.data();
+      _end = _cur + n;
+      _produced += n;
+      return true;
+    }
+    while ( true ){
+      if ( _zs.avail_in == 0 ){
+	size_t n = fread( _in.data(), 1, _in.size(), _file );
+	if ( n == 0 ){
+	  if ( _in_member ){
+	    throw runtime_error( "FragmentIndex: truncated gzip file" );
+	  }
+	  return false;
+	}
+	_read += n;
+	_zs.next_in = _in.data();
+	_zs.avail_in = n;
+      }
+      if ( !_in_member ){
+	// a new gzip member starts here
+	if ( blocks ){
+	  blocks->push_back( make_pair( _produced, _read - _zs.avail_in ) );
+	}
+	_in_member = true;
+      }
+      _zs.next_out = _out.data();
+      _zs.avail_out = _out.size();
+      int ret = inflate( &_zs, Z_NO_FLUSH );
+      if ( ret == Z_STREAM_END ){
+	inflateReset( &_zs );
+	_in_member = false;
+      }
+      else if ( ret != Z_OK && ret != Z_BUF_ERROR ){
+	throw runtime_error( "FragmentIndex: corrupt gzip data" );
+      }
+      size_t got = _out.size() - _zs.avail_out;
+      if ( got > 0 ){
+	_cur = _out.data();
+	_end = _cur + got;
+	_produced += got;
+	return true;
+      }
+    }
+  }
+
+  size_t index_input::read( string& result, size_t len ){
+    /// append the next 'len' bytes to result
+    /*!
+      \param result the string to append to
+      \param len the number of bytes wanted
+      \return the number of bytes appended. Only less than len at the end
+      of the file
+    */
+    size_t done = 0;
+    while ( done < len ){
+      if ( _cur == _end && !fill() ){
+	break;
+      }
+      size_t n = min( len - done, static_cast<size_t>(_end - _cur) );
+      result.append( reinterpret_cast<const char*>(_cur), n );
+      _cur += n;
+      _pos += n;
+      done += n;
+    }
+    return done;
+  }
+
+  static bool is_gzipped( const string& file_name ){
+    /// check the magic number of a gzip file
+    FILE *f = fopen( file_name.c_str(), "rb" );
+    if ( !f ){
+      throw runtime_error( "FragmentIndex: unable to open: " + file_name );
+    }
+    int c1 = fgetc( f );
+    int c2 = fgetc( f );
+    fclose( f );
+    return c1 == 0x1f && c2 == 0x8b;
+  }
+
+  static int next_char( index_input& in, size_t& line ){
+    /// get the next byte, while counting lines. EOF is an error here
+    int c = in.get();
+    if ( c == EOF ){
+      throw runtime_error( "FragmentIndex: unexpected end of file" );
+    }
+    if ( c == '\n' ){
+      ++line;
+    }
+    return c;
+  }
+
+  static void skip_until( index_input& in, const string& end, size_t& line ){
+    /// skip everything up to and including 'end'
+    string window;
+    while ( window != end ){
+      window += static_cast<char>(next_char( in, line ));
+      if ( window.size() > end.size() ){
+	window.erase( 0, 1 );
+      }
+    }
+  }
+
+  static void skip_declaration( index_input& in, size_t& line ){
+    /// skip a \<!...> construct after the '<!'
+    /*!
+      handles comments, CDATA sections and a DOCTYPE with an internal
+      subset
+    */
+    int c = next_char( in, line );
+    if ( c == '-' ){
+      next_char( in, line ); // the second '-'
+      skip_until( in, "-->", line );
+      return;
+    }
+    if ( c == '[' ){
+      skip_until( in, "]]>", line );
+      return;
+    }
+    int depth = 0;
+    while ( c != '>' || depth > 0 ){
+      if ( c == '[' ){
+	++depth;
+      }
+      else if ( c == ']' ){
+	--depth;
+      }
+      else if ( c == '"' || c == '\'' ){
+	int quote = c;
+	while ( next_char( in, line ) != quote ){
+	}
+      }
+      c = next_char( in, line );
+    }
+  }
+
+  static void split_tag( const string& name, string& prefix, string& local ){
+    /// split a tag into a namespace prefix and a local name
+    string::size_type pos = name.find( ':' );
+    if ( pos == string::npos ){
+      prefix.clear();
+      local = name;
+    }
+    else {
+      prefix = name.substr( 0, pos );
+      local = name.substr( pos+1 );
+    }
+  }
+
+  FragmentIndex::FragmentIndex(){
+    /// create an empty index. Use build() or load() to fill it
+    clear();
+  }
+
+  void FragmentIndex::clear(){
+    /// reset the index to the empty state
+    _file.clear();
+    _file_size = 0;
+    _tags.clear();
+    _root_tag.clear();
+    _top_tag.clear();
+    _header_end = 0;
+    _gzipped = false;
+    _blocks.clear();
+    _entries.clear();
+    _ids.clear();
+  }
+
+  string FragmentIndex::default_name( const string& file_name ){
+    /// return the default name of the index file for a FoLiA file
+    return file_name + ".fidx";
+  }
+
+  struct open_element {
+    /// an element in the index scan that is not closed yet
+    size_t offset;
+    size_t head;
+    size_t line;
+    string tag;
+    string id;
+    int entry;   // the index entry, -1 when not indexed (yet)
+    bool body;   // inside the \<text> or \<speech> node?
+    bool top;    // the \<text> or \<speech> node itself?
+    bool text;   // a \<t> or \<ph> node?
+    vector<pair<size_t,size_t>> texts; // the \<t> and \<ph> children
+  };
+
+  void FragmentIndex::build( const string& file_name, const string& tags ){
+    /// create the index of a FoLiA file in one pass
+    /*!
+      \param file_name the FoLiA file. May be plain or gzip compressed
+      \param tags a '|' separated list of the tags to index.
+
+      Only the elements in the FoLiA namespace inside the \<text> or
+      \<speech> node are indexed. The file is scanned for tags, without a
+      full XML parse, so it should be well-formed FoLiA.
+    */
+    clear();
+    struct stat st;
+    if ( stat( file_name.c_str(), &st ) != 0 ){
+      throw runtime_error( "FragmentIndex: unable to open: " + file_name );
+    }
+    _file = file_name;
+    _file_size = st.st_size;
+    _tags = tags;
+    _gzipped = is_gzipped( file_name );
+    vector<string> tv = TiCC::split_at( tags, "|" );
+    set<string> wanted( tv.begin(), tv.end() );
+    index_input in( file_name, _gzipped );
+    if ( _gzipped ){
+      in.blocks = &_blocks;
+    }
+    vector<open_element> stack;
+    string ns_prefix;
+    string prefix;
+    string local;
+    size_t line = 1;
+    int c;
+    while ( ( c = in.get() ) != EOF ){
+      if ( c == '\n' ){
+	++line;
+	continue;
+      }
+      if ( c != '<' ){
+	continue;
+      }
+      size_t start = in.pos() - 1;
+      size_t start_line = line;
+      c = next_char( in, line );
+      if ( c == '?' ){
+	skip_until( in, "?>", line );
+	continue;
+      }
+      if ( c == '!' ){
+	skip_declaration( in, line );
+	continue;
+      }
+      if ( c == '/' ){
+	while ( next_char( in, line ) != '>' ){
+	}
+	if ( stack.empty() ){
+	  throw runtime_error( "FragmentIndex: unbalanced end tag at line "
+			       + TiCC::toString( line ) );
+	}
+	open_element& closed = stack.back();
+	size_t closed_offset = closed.offset;
+	size_t length = in.pos() - closed.offset;
+	if ( closed.entry >= 0 ){
+	  entry& e = _entries[closed.entry];
+	  e.length = length;
+	  if ( _entries.size() > static_cast<size_t>(closed.entry) + 1 ){
+	    // it has indexed descendants, which may refer to its text
+	    e.texts.swap( closed.texts );
+	  }
+	}
+	bool text = closed.text;
+	stack.pop_back();
+	if ( text && !stack.empty() && stack.back().body ){
+	  stack.back().texts.push_back( make_pair( closed_offset, length ) );
+	}
+	continue;
+      }
+      // a start tag
+      string name( 1, static_cast<char>(c) );
+      while ( true ){
+	c = next_char( in, line );
+	if ( isspace( c ) || c == '/' || c == '>' ){
+	  break;
+	}
+	name += static_cast<char>(c);
+      }
+      string id;
+      bool empty = false;
+      while ( c != '>' ){
+	if ( c == '/' ){
+	  empty = true;
+	}
+	else if ( !isspace( c ) ){
+	  string att( 1, static_cast<char>(c) );
+	  while ( ( c = next_char( in, line ) ) != '='
+		  && !isspace( c ) ){
+	    att += static_cast<char>(c);
+	  }
+	  while ( c != '"' && c != '\'' ){
+	    c = next_char( in, line );
+	  }
+	  int quote = c;
+	  string value;
+	  while ( ( c = next_char( in, line ) ) != quote ){
+	    value += static_cast<char>(c);
+	  }
+	  if ( att == "xml:id" ){
+	    id = value;
+	  }
+	}
+	c = next_char( in, line );
+      }
+      open_element el { start, in.pos() - start, start_line, name, id,
+			-1, false, false, false, {} };
+      split_tag( name, prefix, local );
+      el.text = prefix == ns_prefix && ( local == "t" || local == "ph" );
+      if ( stack.empty() ){
+	// the root node
+	_root_tag = name;
+	ns_prefix = prefix;
+      }
+      else if ( stack.back().body || stack.back().top ){
+	el.body = true;
+	if ( prefix == ns_prefix && wanted.find( local ) != wanted.end() ){
+	  // make sure all ancestors are in the index, then add this one
+	  int parent = -1;
+	  for ( auto& anc : stack ){
+	    if ( !anc.body ){
+	      continue;
+	    }
+	    if ( anc.entry < 0 ){
+	      anc.entry = _entries.size();
+	      _entries.push_back( { anc.offset, anc.head, 0, anc.line,
+				    parent, anc.tag, anc.id, {} } );
+	      if ( !anc.id.empty() ){
+		_ids.emplace( anc.id, anc.entry );
+	      }
+	    }
+	    parent = anc.entry;
+	  }
+	  el.entry = _entries.size();
+	  _entries.push_back( { el.offset, el.head, el.head, el.line,
+				parent, el.tag, el.id, {} } );
+	  if ( !id.empty() ){
+	    _ids.emplace( id, el.entry );
+	  }
+	}
+      }
+      else if ( stack.size() == 1
+		&& _header_end == 0
+		&& prefix == ns_prefix
+		&& ( local == "text" || local == "speech" ) ){
+	_top_tag = name;
+	_header_end = in.pos();
+	el.top = true;
+      }
+      if ( !empty ){
+	stack.push_back( el );
+      }
+      else if ( el.text && stack.back().body ){
+	stack.back().texts.push_back( make_pair( el.offset, el.head ) );
+      }
+    }
+    if ( !stack.empty() ){
+      throw runtime_error( "FragmentIndex: unexpected end of file: "
+			   + file_name );
+    }
+    if ( _header_end == 0 ){
+      throw runtime_error( "FragmentIndex: no <text> or <speech> found in "
+			   + file_name );
+    }
+  }
+
+  void FragmentIndex::save( const string& index_name ) const {
+    /// write the index to a file
+    /*!
+      \param index_name the name of the index file. Use default_name() for
+      the conventional name
+    */
+    ofstream os( index_name );
+    if ( !os ){
+      throw runtime_error( "FragmentIndex: unable to create: " + index_name );
+    }
+    os << INDEX_MAGIC << "\n"
+       << "file " << _file << "\n"
+       << "size " << _file_size << "\n"
+       << "tags " << _tags << "\n"
+       << "root " << _root_tag << "\n"
+       << "top " << _top_tag << "\n"
+       << "header " << _header_end << "\n"
+       << "gzip " << _gzipped << "\n"
+       << "blocks " << _blocks.size() << "\n";
+    for ( const auto& b : _blocks ){
+      os << b.first << " " << b.second << "\n";
+    }
+    os << "entries " << _entries.size() << "\n";
+    for ( const auto& e : _entries ){
+      os << e.offset << " " << e.head << " " << e.length << " " << e.line
+	 << " " << e.parent << " " << e.texts.size();
+      for ( const auto& t : e.texts ){
+	os << " " << t.first << " " << t.second;
+      }
+      os << " " << e.tag;
+      if ( !e.id.empty() ){
+	os << " " << e.id;
+      }
+      os << "\n";
+    }
+    if ( !os ){
+      throw runtime_error( "FragmentIndex: writing failed: " + index_name );
+    }
+  }
+
+  static string read_field( istream& is, const string& key,
+			    const string& index_name ){
+    /// read a 'key value' line from a saved index
+    string line;
+    if ( !getline( is, line )
+	 || line.compare( 0, key.size()+1, key + " " ) != 0 ){
+      throw runtime_error( "FragmentIndex: expected '" + key
+			   + "' in: " + index_name );
+    }
+    return line.substr( key.size()+1 );
+  }
+
+  void FragmentIndex::load( const string& index_name,
+			    const string& file_name ){
+    /// read an index created with save()
+    /*!
+      \param index_name the index file
+      \param file_name the FoLiA file. When empty, the name stored in the
+      index is used.
+
+      Throws when the FoLiA file doesn't have the size it had when the index
+      was built.
+    */
+    clear();
+    ifstream is( index_name );
+    if ( !is ){
+      throw runtime_error( "FragmentIndex: unable to open: " + index_name );
+    }
+    string line;
+    if ( !getline( is, line ) || line != INDEX_MAGIC ){
+      throw runtime_error( "FragmentIndex: not an index file: "
+			   + index_name );
+    }
+    try {
+      _file = read_field( is, "file", index_name );
+      _file_size = stoull( read_field( is, "size", index_name ) );
+      _tags = read_field( is, "tags", index_name );
+      _root_tag = read_field( is, "root", index_name );
+      _top_tag = read_field( is, "top", index_name );
+      _header_end = stoull( read_field( is, "header", index_name ) );
+      _gzipped = read_field( is, "gzip", index_name ) == "1";
+      size_t count = stoull( read_field( is, "blocks", index_name ) );
+      _blocks.resize( count );
+      for ( auto& b : _blocks ){
+	if ( !getline( is, line ) ){
+	  throw runtime_error( "FragmentIndex: truncated index: "
+			       + index_name );
+	}
+	istringstream ls( line );
+	ls >> b.first >> b.second;
+      }
+      count = stoull( read_field( is, "entries", index_name ) );
+      _entries.resize( count );
+      for ( size_t i=0; i < count; ++i ){
+	entry& e = _entries[i];
+	if ( !getline( is, line ) ){
+	  throw runtime_error( "FragmentIndex: truncated index: "
+			       + index_name );
+	}
+	istringstream ls( line );
+	size_t texts = 0;
+	ls >> e.offset >> e.head >> e.length >> e.line >> e.parent >> texts;
+	e.texts.resize( texts );
+	for ( auto& t : e.texts ){
+	  ls >> t.first >> t.second;
+	}
+	ls >> e.tag >> e.id;
+	if ( !ls && e.tag.empty() ){
+	  throw runtime_error( "FragmentIndex: invalid entry in: "
+			       + index_name );
+	}
+	if ( !e.id.empty() ){
+	  _ids.emplace( e.id, i );
+	}
+      }
+    }
+    catch ( const logic_error& ){
+      // from stoull()
+      throw runtime_error( "FragmentIndex: invalid index file: "
+			   + index_name );
+    }
+    if ( !file_name.empty() ){
+      _file = file_name;
+    }
+    struct stat st;
+    if ( stat( _file.c_str(), &st ) != 0 ){
+      throw runtime_error( "FragmentIndex: unable to open: " + _file );
+    }
+    if ( static_cast<size_t>(st.st_size) != _file_size ){
+      throw runtime_error( "FragmentIndex: " + index_name
+			   + " is out of date for " + _file );
+    }
+  }
+
+  const FragmentIndex::entry *FragmentIndex::find( const string& id ) const {
+    /// return the entry for an xml:id, or 0 when not indexed
+    auto it = _ids.find( id );
+    if ( it == _ids.end() ){
+      return 0;
+    }
+    return &_entries[it->second];
+  }
+
+  string FragmentIndex::read_bytes( size_t offset, size_t len ) const {
+    /// return a part of the (uncompressed) FoLiA file
+    /*!
+      \param offset the (uncompressed) offset to start
+      \param len the number of bytes to read
+      \return a string with the bytes
+
+      For a gzip file, decompression starts at the gzip member that holds
+      offset.
+    */
+    index_input in( _file, _gzipped );
+    string skipped;
+    if ( _gzipped ){
+      auto it = upper_bound( _blocks.begin(), _blocks.end(),
+			     make_pair( offset, static_cast<size_t>(-1) ) );
+      if ( it != _blocks.begin() ){
+	--it;
+	in.seek( it->first, it->second );
+      }
+      while ( in.pos() < offset ){
+	skipped.clear();
+	if ( in.read( skipped, min( offset - in.pos(), INDEX_BUFFER_SIZE ) )
+	     == 0 ){
+	  break;
+	}
+      }
+    }
+    else {
+      in.seek( offset, 0 );
+    }
+    string result;
+    if ( in.pos() != offset
+	 || in.read( result, len ) != len ){
+      throw runtime_error( "FragmentIndex: " + _file
+			   + " is shorter than expected" );
+    }
+    return result;
+  }
+
+  string FragmentIndex::fragment( const string& id ) const {
+    /// build a small FoLiA document with just one indexed element
+    /*!
+      \param id the xml:id of the element
+      \return a string with a complete FoLiA document, holding all the
+      metadata of the original file, the ancestors of the element with just
+      their text content, and the element itself with all its children.
+    */
+    const entry *e = find( id );
+    if ( !e ){
+      throw range_error( "FragmentIndex: id not indexed: " + id );
+    }
+    vector<const entry*> path;
+    for ( int p = e->parent; p >= 0; p = _entries[p].parent ){
+      path.push_back( &_entries[p] );
+    }
+    string result = read_bytes( 0, _header_end );
+    for ( auto it = path.rbegin(); it != path.rend(); ++it ){
+      result += read_bytes( (*it)->offset, (*it)->head );
+      for ( const auto& t : (*it)->texts ){
+	result += read_bytes( t.first, t.second );
+      }
+    }
+    result += read_bytes( e->offset, e->length );
+    for ( const auto *anc : path ){
+      result += "</" + anc->tag + ">";
+    }
+    result += "</" + _top_tag + "></" + _root_tag + ">\n";
+    return result;
+  }
+
+  void write_seekable_gz( const string& in_name,
+			  const string& out_name,
+			  size_t block_size ){
+    /// compress a file as a series of small gzip members
+    /*!
+      \param in_name the file to compress. It may be gzipped already
+      \param out_name the output file
+      \param block_size the amount of uncompressed data per gzip member
+
+      The result is a valid gzip file, that every gzip tool (and libxml2)
+      can read. But a FragmentIndex can start decompressing at every
+      member, so it doesn't need to decompress the whole file for a lookup.
+    */
+    gzFile in = gzopen( in_name.c_str(), "rb" );
+    if ( !in ){
+      throw runtime_error( "write_seekable_gz: unable to open: " + in_name );
+    }
+    FILE *out = fopen( out_name.c_str(), "wb" );
+    if ( !out ){
+      gzclose( in );
+      throw runtime_error( "write_seekable_gz: unable to create: "
+			   + out_name );
+    }
+    vector<unsigned char> plain( block_size );
+    vector<unsigned char> packed;
+    bool ok = true;
+    int got = 0;
+    while ( ok
+	    && ( got = gzread( in, plain.data(), block_size ) ) > 0 ){
+      z_stream zs;
+      memset( &zs, 0, sizeof(zs) );
+      if ( deflateInit2( &zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			 16+MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK ){
+	ok = false;
+	break;
+      }
+      // the gzip header and trailer are not included in deflateBound()
+      packed.resize( deflateBound( &zs, got ) + 32 );
+      zs.next_in = plain.data();
+      zs.avail_in = got;
+      zs.next_out = packed.data();
+      zs.avail_out = packed.size();
+      ok = deflate( &zs, Z_FINISH ) == Z_STREAM_END;
+      size_t len = packed.size() - zs.avail_out;
+      deflateEnd( &zs );
+      ok = ok && fwrite( packed.data(), 1, len, out ) == len;
+    }
+    ok = ok && got == 0;
+    gzclose( in );
+    ok = ( fclose( out ) == 0 ) && ok;
+    if ( !ok ){
+      throw runtime_error( "write_seekable_gz: compressing " + in_name
+			   + " failed" );
+    }
+  }
+
+} // namespace folia
@@ -25,9 +25,12 @@
 */
 
 #include <set>
+#include <bitset>
+#include <unordered_map>
 #include <string>
 #include <iostream>
 
+#include "libxml/parser.h"
 #include "libfolia/folia.h"
 #include "libfolia/folia_properties.h"
 
@@ -474,28 +477,28 @@ namespace folia {
 
   //foliaspec:default_ignore
   //Default ignore list for the select() method, do not descend into these
-  const set<ElementType> default_ignore = { Alternative_t, AlternativeLayers_t, ForeignData_t, Original_t, Suggestion_t };
+  const ElementTypeSet default_ignore = { Alternative_t, AlternativeLayers_t, ForeignData_t, Original_t, Suggestion_t };
 
   //foliaspec:default_ignore_annotations
   //Default ignore list for token annotation
-  const set<ElementType> default_ignore_annotations = { Alternative_t, AlternativeLayers_t, MorphologyLayer_t, Original_t, PhonologyLayer_t, Suggestion_t };
+  const ElementTypeSet default_ignore_annotations = { Alternative_t, AlternativeLayers_t, MorphologyLayer_t, Original_t, PhonologyLayer_t, Suggestion_t };
 
   //foliaspec:default_ignore_structure
   //Default ignore list for structure annotation
-  const set<ElementType> default_ignore_structure = { Alternative_t, AlternativeLayers_t, ChunkingLayer_t, CoreferenceLayer_t, DependenciesLayer_t, EntitiesLayer_t, ModalitiesLayer_t, MorphologyLayer_t, ObservationLayer_t, Original_t, PhonologyLayer_t, SemanticRolesLayer_t, SentimentLayer_t, SpanRelationLayer_t, StatementLayer_t, Suggestion_t, SyntaxLayer_t, TimingLayer_t };
+  const ElementTypeSet default_ignore_structure = { Alternative_t, AlternativeLayers_t, ChunkingLayer_t, CoreferenceLayer_t, DependenciesLayer_t, EntitiesLayer_t, ModalitiesLayer_t, MorphologyLayer_t, ObservationLayer_t, Original_t, PhonologyLayer_t, SemanticRolesLayer_t, SentimentLayer_t, SpanRelationLayer_t, StatementLayer_t, Suggestion_t, SyntaxLayer_t, TimingLayer_t };
 
-  const set<ElementType> AnnoExcludeSet = { Original_t, Suggestion_t };
+  const ElementTypeSet AnnoExcludeSet = { Original_t, Suggestion_t };
 
-  const set<ElementType> SpanSet = { SyntacticUnit_t,
-				     Chunk_t,
-				     Entity_t,
-				     Headspan_t,
-				     DependencyDependent_t,
-				     CoreferenceLink_t,
-				     CoreferenceChain_t,
-				     SemanticRole_t,
-				     SemanticRolesLayer_t,
-				     TimeSegment_t };
+  const ElementTypeSet SpanSet = { SyntacticUnit_t,
+				   Chunk_t,
+				   Entity_t,
+				   Headspan_t,
+				   DependencyDependent_t,
+				   CoreferenceLink_t,
+				   CoreferenceChain_t,
+				   SemanticRole_t,
+				   SemanticRolesLayer_t,
+				   TimeSegment_t };
 
   // Abstract properties are not in the external specification
   properties ABSTRACT_STRUCTURE_ELEMENT_PROPERTIES;
@@ -646,8 +649,26 @@ namespace folia {
     return a;
   }
 
-  map<ElementType,properties*> element_props;
-  map<ElementType,ElementType> abstract_parents;
+  namespace {
+    // the writable versions of the lookup tables. They are ONLY filled in
+    // static_init(). The rest of the world gets const references, so the
+    // tables may be read from several threads at the same time.
+    array<properties*,LastElement> element_props_table;
+    map<ElementType,ElementType> abstract_parents_table;
+    map<ElementType,AnnotationType> element_annotation_table;
+    map<string,string> reverse_old_table;
+    // dense versions of et_s_map, s_et_map and typeHierarchy. These are
+    // consulted for every node we parse or serialize
+    array<string,LastElement> element_tags_table;
+    unordered_map<string,ElementType> tag_elementtypes_table;
+    array<bitset<LastElement>,LastElement> subclass_table;
+  }
+
+  const array<properties*,LastElement>& element_props = element_props_table;
+  const array<string,LastElement>& element_tags = element_tags_table;
+  const unordered_map<string,ElementType>& tag_elementtypes
+  = tag_elementtypes_table;
+  const map<ElementType,ElementType>& abstract_parents = abstract_parents_table;
 
   ElementType get_abstract_parent( const ElementType et ) {
     const auto& it = abstract_parents.find( et );
@@ -661,9 +682,15 @@ namespace folia {
     return get_abstract_parent( el->element_id() );
   }
 
+  static void init_type_tables();
+
   void static_init(){
     /// initialize a lot of statics ('constants')
     /// This function should be called once.
+    auto& element_props = element_props_table;
+    auto& abstract_parents = abstract_parents_table;
+    auto& element_annotation_map = element_annotation_table;
+    auto& reverse_old = reverse_old_table;
     FoLiA::PROPS.XMLTAG = "FoLiA";
     FoLiA::PROPS.ACCEPTED_DATA += { Text_t, Speech_t };
     FoLiA::PROPS.OPTIONAL_ATTRIBS = ID;
@@ -1854,6 +1881,7 @@ namespace folia {
     for ( const auto& [ann,et] : annotationtype_elementtype_map ){
       element_annotation_map[et] = ann;
     }
+    init_type_tables();
   }
 
 
@@ -1997,12 +2025,12 @@ namespace folia {
     { "listitem", "item" },
   };
 
-  map<string,string> reverse_old;
-  map<ElementType,AnnotationType> element_annotation_map;
+  const map<string,string>& reverse_old = reverse_old_table;
+  const map<ElementType,AnnotationType>& element_annotation_map = element_annotation_table;
 
   //foliaspec:wrefables
   //Elements that act as words and can be referable from span annotations
-  const set<ElementType> wrefables = { Hiddenword_t, Morpheme_t, Phoneme_t, Word_t };
+  const ElementTypeSet wrefables = { Hiddenword_t, Morpheme_t, Phoneme_t, Word_t };
 
   //foliaspec:annotationtype_elementtype_map
   //A mapping from annotation types to element types, based on the assumption that there is always only one primary element for an annotation type (and possible multiple secondary ones which are not included in this map,w)
@@ -2311,6 +2339,32 @@ namespace folia {
     return 0;
   }
 
+  static void init_type_tables(){
+    /// fill the lookup tables indexed on ElementType. Part of static_init()
+    for ( const auto& [et,tag] : et_s_map ){
+      element_tags_table[et] = tag;
+    }
+    tag_elementtypes_table.reserve( s_et_map.size() + oldtags.size() );
+    for ( const auto& [tag,et] : s_et_map ){
+      tag_elementtypes_table[tag] = et;
+    }
+    // the pre v1.5 names map directly on their new ElementType
+    for ( const auto& [old_tag,tag] : oldtags ){
+      const auto& it = s_et_map.find( tag );
+      if ( it != s_et_map.end() ){
+	tag_elementtypes_table[old_tag] = it->second;
+      }
+    }
+    for ( size_t et=0; et < LastElement; ++et ){
+      subclass_table[et].set( et );
+    }
+    for ( const auto& [et,supers] : typeHierarchy ){
+      for ( const auto& super : supers ){
+	subclass_table[et].set( super );
+      }
+    }
+  }
+
   bool isSubClass( const ElementType e1, const ElementType e2 ){
     /// check if an ElementType is a subclass of another one
     /*!
@@ -2318,13 +2372,10 @@ namespace folia {
       \param e2 an ElementType
       \return true if e1 is in the typeHierarchy of e2
     */
-    if ( e1 == e2 )
-      return true;
-    const auto& it = typeHierarchy.find( e1 );
-    if ( it != typeHierarchy.end() ){
-      return it->second.find( e2 ) != it->second.end();
+    if ( e1 >= LastElement || e2 >= LastElement ){
+      return e1 == e2;
     }
-    return false;
+    return subclass_table[e1][e2];
   }
 
   bool isSubClass( const FoliaElement *e1, const FoliaElement *e2 ){
@@ -2393,6 +2444,8 @@ namespace folia {
     //
     struct initializer {
      initializer() {
+       // libxml2 wants to be initialized once, before any threads start
+       xmlInitParser();
        static_init();
        host_name = get_fqdn();
        //	print_type_hierarchy( cout );
@@ -1162,12 +1162,61 @@ namespace folia {
     return 0;
   }
 
+  void Word::init() {
+    /// set default values on creation
+    _doc_pos = 0;
+  }
+
+  bool Word::doc_position( size_t& pos ) const {
+    /// find the position of this Word in Document::words()
+    /*!
+     * \param pos the position found
+     * \return true when this word is part of the Document's words()
+     *
+     * The Document stamps every Word with its position when (re)building
+     * its Word index. So we only have to verify that the stamp is still
+     * valid
+     */
+    if ( !doc() ){
+      return false;
+    }
+    const vector<Word*>& words = doc()->word_index();
+    if ( _doc_pos < words.size()
+	 && words[_doc_pos] == this ){
+      pos = _doc_pos;
+      return true;
+    }
+    return false;
+  }
+
+  static bool is_below( const FoliaElement *node, const FoliaElement *top ){
+    /// check if top is an ancestor of node
+    for ( const FoliaElement *p = node->parent(); p; p = p->parent() ){
+      if ( p == top ){
+	return true;
+      }
+    }
+    return false;
+  }
+
   Word *Word::previous() const {
     /// return the previous Word in the Sentence
     /*!
      * \return the previous Word or 0, when not found.
      */
     Sentence *s = sentence();
+    size_t pos;
+    if ( doc_position( pos ) ){
+      // the words of the Sentence are a consecutive part of the
+      // Document's words. So it is the Document neighbour, or none
+      if ( pos > 0 ){
+	Word *prev = doc()->word_index()[pos-1];
+	if ( s && is_below( prev, s ) ){
+	  return prev;
+	}
+      }
+      return 0;
+    }
     vector<Word*> words = s->words();
     for ( size_t i=0; i < words.size(); ++i ) {
       if ( words[i] == this ) {
@@ -1189,6 +1238,19 @@ namespace folia {
      * \return the next Word or 0, when not found.
      */
     Sentence *s = sentence();
+    size_t pos;
+    if ( doc_position( pos ) ){
+      // the words of the Sentence are a consecutive part of the
+      // Document's words. So it is the Document neighbour, or none
+      const vector<Word*>& words = doc()->word_index();
+      if ( pos+1 < words.size() ){
+	Word *nxt = words[pos+1];
+	if ( s && is_below( nxt, s ) ){
+	  return nxt;
+	}
+      }
+      return 0;
+    }
     vector<Word*> words = s->words();
     for ( size_t i=0; i < words.size(); ++i ) {
       if ( words[i] == this ) {
@@ -1217,46 +1279,42 @@ namespace folia {
      * in the middle of the list.
      */
     vector<Word*> result;
-    if ( size > 0 ) {
-      vector<Word*> words = doc()->words();
-      for ( size_t i=0; i < words.size(); ++i ) {
-	if ( words[i] == this ) {
-	  size_t miss = 0;
-	  if ( i < size ) {
-	    miss = size - i;
-	  }
-	  for ( size_t index=0; index < miss; ++index ) {
-	    if ( val.empty() ) {
-	      result.push_back( 0 );
-	    }
-	    else {
-	      KWargs args;
-	      args["text"] = val;
-	      args["placeholder"] = "yes";
-	      Word *p = new Word( args );
-	      doc()->keepForDeletion( p );
-	      result.push_back( p );
-	    }
+    size_t i;
+    if ( size > 0 && doc_position( i ) ) {
+      const vector<Word*>& words = doc()->word_index();
+      size_t miss = 0;
+      if ( i < size ) {
+	miss = size - i;
+      }
+      for ( size_t index=0; index < miss; ++index ) {
+	if ( val.empty() ) {
+	  result.push_back( 0 );
+	}
+	else {
+	  KWargs args;
+	  args["text"] = val;
+	  args["placeholder"] = "yes";
+	  Word *p = new Word( args );
+	  doc()->keepForDeletion( p );
+	  result.push_back( p );
+	}
+      }
+      for ( size_t index=i-size+miss; index < i + size + 1; ++index ) {
+	if ( index < words.size() ) {
+	  result.push_back( words[index] );
+	}
+	else {
+	  if ( val.empty() ) {
+	    result.push_back( 0 );
 	  }
-	  for ( size_t index=i-size+miss; index < i + size + 1; ++index ) {
-	    if ( index < words.size() ) {
-	      result.push_back( words[index] );
-	    }
-	    else {
-	      if ( val.empty() ) {
-		result.push_back( 0 );
-	      }
-	      else {
-		KWargs args;
-		args["text"] = val;
-		args["placeholder"] = "yes";
-		Word *p = new Word( args );
-		doc()->keepForDeletion( p );
-		result.push_back( p );
-	      }
-	    }
+	  else {
+	    KWargs args;
+	    args["text"] = val;
+	    args["placeholder"] = "yes";
+	    Word *p = new Word( args );
+	    doc()->keepForDeletion( p );
+	    result.push_back( p );
 	  }
-	  break;
 	}
       }
     }
@@ -1278,33 +1336,29 @@ namespace folia {
      */
     //  cerr << "leftcontext : " << size << endl;
     vector<Word*> result;
-    if ( size > 0 ) {
-      vector<Word*> words = doc()->words();
-      for ( size_t i=0; i < words.size(); ++i ) {
-	if ( words[i] == this ) {
-	  size_t miss = 0;
-	  if ( i < size ) {
-	    miss = size - i;
-	  }
-	  for ( size_t index=0; index < miss; ++index ) {
-	    if ( val.empty() ) {
-	      result.push_back( 0 );
-	    }
-	    else {
-	      KWargs args;
-	      args["text"] = val;
-	      args["placeholder"] = "yes";
-	      Word *p = new Word( args );
-	      doc()->keepForDeletion( p );
-	      result.push_back( p );
-	    }
-	  }
-	  for ( size_t index=i-size+miss; index < i; ++index ) {
-	    result.push_back( words[index] );
-	  }
-	  break;
+    size_t i;
+    if ( size > 0 && doc_position( i ) ) {
+      const vector<Word*>& words = doc()->word_index();
+      size_t miss = 0;
+      if ( i < size ) {
+	miss = size - i;
+      }
+      for ( size_t index=0; index < miss; ++index ) {
+	if ( val.empty() ) {
+	  result.push_back( 0 );
+	}
+	else {
+	  KWargs args;
+	  args["text"] = val;
+	  args["placeholder"] = "yes";
+	  Word *p = new Word( args );
+	  doc()->keepForDeletion( p );
+	  result.push_back( p );
 	}
       }
+      for ( size_t index=i-size+miss; index < i; ++index ) {
+	result.push_back( words[index] );
+      }
     }
     return result;
   }
@@ -1323,33 +1377,27 @@ namespace folia {
      */
     vector<Word*> result;
     //  cerr << "rightcontext : " << size << endl;
-    if ( size > 0 ) {
-      vector<Word*> words = doc()->words();
-      size_t begin;
-      size_t end;
-      for ( size_t i=0; i < words.size(); ++i ) {
-	if ( words[i] == this ) {
-	  begin = i + 1;
-	  end = begin + size;
-	  for ( ; begin < end; ++begin ) {
-	    if ( begin >= words.size() ) {
-	      if ( val.empty() ) {
-		result.push_back( 0 );
-	      }
-	      else {
-		KWargs args;
-		args["text"] = val;
-		args["placeholder"] = "yes";
-		Word *p = new Word( args );
-		doc()->keepForDeletion( p );
-		result.push_back( p );
-	      }
-	    }
-	    else
-	      result.push_back( words[begin] );
+    size_t i;
+    if ( size > 0 && doc_position( i ) ) {
+      const vector<Word*>& words = doc()->word_index();
+      size_t begin = i + 1;
+      size_t end = begin + size;
+      for ( ; begin < end; ++begin ) {
+	if ( begin >= words.size() ) {
+	  if ( val.empty() ) {
+	    result.push_back( 0 );
+	  }
+	  else {
+	    KWargs args;
+	    args["text"] = val;
+	    args["placeholder"] = "yes";
+	    Word *p = new Word( args );
+	    doc()->keepForDeletion( p );
+	    result.push_back( p );
 	  }
-	  break;
 	}
+	else
+	  result.push_back( words[begin] );
       }
     }
     return result;
@@ -2652,6 +2700,7 @@ namespace folia {
      * \param us a Unicode string
      */
     _value = TiCC::UnicodeToUTF8( us );
+    text_changed();
   }
 
   void XmlText::setvalue( const string& s ){
@@ -2663,6 +2712,7 @@ namespace folia {
       UnicodeString us = TiCC::UnicodeFromUTF8(s);
       us = dumb_spaces( us );
       _value = TiCC::UnicodeToUTF8( us );
+      text_changed();
     }
   }
 
@@ -2733,6 +2783,8 @@ namespace folia {
       int cnt = 0;
       xmlSetStructuredErrorFunc( &cnt, (xmlStructuredErrorFunc)error_sink );
       xmlDoc *extdoc = xmlReadFile( src.c_str(), 0, XML_PARSER_OPTIONS );
+      // don't leave libxml2 with a handler on our local counter
+      xmlSetStructuredErrorFunc( 0, 0 );
       if ( extdoc ) {
 	const xmlNode *root = xmlDocGetRootElement( extdoc );
 	xmlNode *p = root->children;
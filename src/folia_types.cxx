@@ -119,12 +119,12 @@ namespace folia {
      * \param et an ElementType
      * \return a string representation.
      */
-    auto result = et_s_map.find(et);
-    if ( result == et_s_map.end() ){
+    if ( et >= LastElement
+	 || element_tags[et].empty() ){
       throw logic_error( "toString: Unknown Elementtype "
 			 + TiCC::toString( int(et) ) );
     }
-    return result->second;
+    return element_tags[et];
   }
 
   ElementType stringToElementType( const string& intag ){
@@ -135,13 +135,13 @@ namespace folia {
      *
      * Also handles 'old' pre v1.5 names.
      */
-    string tag = intag;
-    auto const tr = oldtags.find(intag);
-    if ( tr != oldtags.end() ){
-      tag = tr->second;
-    }
-    auto result = s_et_map.find(tag);
-    if ( result == s_et_map.end() ){
+    auto const result = tag_elementtypes.find(intag);
+    if ( result == tag_elementtypes.end() ){
+      string tag = intag;
+      auto const tr = oldtags.find(intag);
+      if ( tr != oldtags.end() ){
+	tag = tr->second;
+      }
       throw ValueError( "unknown tag <" + tag + ">" );
     }
     return result->second;
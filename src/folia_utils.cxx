@@ -33,10 +33,23 @@
 #include <map>
 #include <set>
 #include <list>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <netdb.h>
+#include "config.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include <bzlib.h>
+#include <zlib.h>
 #include <stdexcept>
 #include <algorithm>
 #include "ticcutils/StringOps.h"
@@ -241,7 +254,106 @@ namespace folia {
       throw ArgsError( s + ", unbalanced '?" );
   }
 
-  bool KWargs::is_present( const string& att ) const {
+  KWargs::iterator KWargs::position( string_view att ){
+    /// find the place where an attribute is, or should be inserted
+    /*!
+      \param att The attribute to look for
+      \return an iterator to the first entry not lesser than att
+    */
+    return lower_bound( _entries.begin(), _entries.end(), att,
+			[]( const value_type& e, string_view a ){
+			  return string_view(e.first) < a; } );
+  }
+
+  KWargs::iterator KWargs::find( string_view att ){
+    /// lookup an attribute
+    /*!
+      \param att The attribute to look for
+      \return an iterator to the entry, or end() when not found
+    */
+    auto it = position( att );
+    if ( it != _entries.end() && it->first == att ){
+      return it;
+    }
+    return _entries.end();
+  }
+
+  KWargs::const_iterator KWargs::find( string_view att ) const {
+    /// lookup an attribute
+    /*!
+      \param att The attribute to look for
+      \return an iterator to the entry, or end() when not found
+    */
+    return const_cast<KWargs*>(this)->find( att );
+  }
+
+  string& KWargs::at( string_view att ){
+    /// get the value of an attribute
+    /*!
+      \param att The attribute to look for
+      \return the value. Throws out_of_range when not present
+    */
+    auto it = find( att );
+    if ( it == _entries.end() ){
+      throw out_of_range( "KWargs::at(" + string(att) + ")" );
+    }
+    return it->second;
+  }
+
+  const string& KWargs::at( string_view att ) const {
+    /// get the value of an attribute
+    /*!
+      \param att The attribute to look for
+      \return the value. Throws out_of_range when not present
+    */
+    return const_cast<KWargs*>(this)->at( att );
+  }
+
+  string& KWargs::operator[]( string_view att ){
+    /// get the value of an attribute, add it when not present
+    /*!
+      \param att The attribute to look for
+      \return a reference to the (possibly new and empty) value
+    */
+    if ( _entries.capacity() == 0 ){
+      _entries.reserve( 8 );
+    }
+    auto it = position( att );
+    if ( it == _entries.end() || it->first != att ){
+      it = _entries.emplace( it, string(att), "" );
+    }
+    return it->second;
+  }
+
+  pair<KWargs::iterator,bool> KWargs::insert( const value_type& entry ){
+    /// add an attribute/value pair, unless the attribute is already there
+    /*!
+      \param entry The attribute/value pair
+      \return the iterator to the entry with that attribute and a bool
+      which is true when the entry was added
+    */
+    auto it = position( entry.first );
+    if ( it != _entries.end() && it->first == entry.first ){
+      return make_pair( it, false );
+    }
+    return make_pair( _entries.insert( it, entry ), true );
+  }
+
+  KWargs::size_type KWargs::erase( string_view att ){
+    /// remove an attribute
+    /*!
+      \param att The attribute to remove
+      \return the number of removed entries (0 or 1)
+    */
+    auto it = find( att );
+    if ( it == _entries.end() ){
+      return 0;
+    }
+    _entries.erase( it );
+    return 1;
+  }
+
+  bool KWargs::is_present( string_view att ) const {
     /// check if an attribute is present in the KWargs
     /*!
       \param att The attribute to check
@@ -250,7 +362,7 @@ namespace folia {
     return find(att) != end();
   }
 
-  string KWargs::lookup( const string& att ){
+  string KWargs::lookup( string_view att ){
     /// lookup an attribute
     /*!
       \param att The attribute to check
@@ -264,7 +376,7 @@ namespace folia {
     return result;
   }
 
-  string KWargs::extract( const string& att ){
+  string KWargs::extract( string_view att ){
     /// lookup and remove an attribute
     /*!
       \param att The attribute to check
@@ -274,8 +386,8 @@ namespace folia {
     string result;
     auto it = find(att);
     if ( it != end() ){
-      result = it->second;
-      erase(it);
+      result = std::move( it->second );
+      _entries.erase(it);
     }
     return result;
   }
@@ -330,7 +442,11 @@ namespace folia {
     if ( node ){
       const xmlAttr *a = node->properties;
       while ( a ){
-	if ( a->atype == XML_ATTRIBUTE_ID && att_name(a) == "id" ){
+	if ( att_name(a) == "id"
+	     && ( a->atype == XML_ATTRIBUTE_ID
+		  // in a tree that is built in memory, and not parsed, xml:id
+		  // is not typed as an ID
+		  || ( a->ns && xmlStrEqual( a->ns->href, XML_XML_NAMESPACE ) ) ) ){
 	  atts["xml:id"] = att_content(a);
 	}
 	else if ( a->ns == 0 || a->ns->prefix == 0 ){
@@ -352,6 +468,282 @@ namespace folia {
     return atts;
   }
 
+  /// the size of the chunks that hold the keys of an IdIndex
+  const size_t ID_POOL_CHUNK = 64*1024;
+
+  size_t IdIndex::locate( string_view key, size_t hash ) const {
+    /// find the slot holding a live entry for key
+    /*!
+      \param key the id to search
+      \param hash the hash value of key
+      \return the position of the slot, or _slots.size() when absent
+    */
+    if ( _slots.empty() ){
+      return _slots.size();
+    }
+    size_t mask = _slots.size() - 1;
+    size_t pos = hash & mask;
+    while ( _slots[pos].key.data() ){
+      const slot& s = _slots[pos];
+      if ( s.el
+	   && s.hash == hash
+	   && s.key == key ){
+	return pos;
+      }
+      pos = ( pos + 1 ) & mask;
+    }
+    return _slots.size();
+  }
+
+  FoliaElement *IdIndex::find( string_view key ) const {
+    /// search the element with this id
+    /*!
+      \param key the id to search
+      \return the FoliaElement, or 0 when key isn't in the index
+    */
+    size_t pos = locate( key, hash<string_view>()( key ) );
+    if ( pos == _slots.size() ){
+      return 0;
+    }
+    return _slots[pos].el;
+  }
+
+  string_view IdIndex::store( string_view key ){
+    /// copy a key into the character pool
+    /*!
+      \param key the value to copy
+      \return a view on the pooled copy, which is never a 0 pointer
+    */
+    if ( key.size() >= _pool_left ){
+      size_t len = max( ID_POOL_CHUNK, key.size() + 1 );
+      _pool.emplace_back( new char[len] );
+      _pool_pos = _pool.back().get();
+      _pool_left = len;
+    }
+    memcpy( _pool_pos, key.data(), key.size() );
+    string_view result( _pool_pos, key.size() );
+    _pool_pos += key.size();
+    _pool_left -= key.size();
+    return result;
+  }
+
+  bool IdIndex::insert( string_view key, FoliaElement *el ){
+    /// add an entry
+    /*!
+      \param key the id to add
+      \param el the FoliaElement with this id. Must not be 0.
+      \return false when key was already present. The index is not changed
+      then.
+    */
+    assert( el );
+    if ( ( _used + 1 ) * 4 > _slots.size() * 3 ){
+      rehash( _size + 1 );
+    }
+    size_t hash_val = hash<string_view>()( key );
+    size_t mask = _slots.size() - 1;
+    size_t pos = hash_val & mask;
+    size_t free_pos = _slots.size();
+    while ( _slots[pos].key.data() ){
+      const slot& s = _slots[pos];
+      if ( !s.el ){
+	if ( free_pos == _slots.size() ){
+	  free_pos = pos;
+	}
+      }
+      else if ( s.hash == hash_val
+		&& s.key == key ){
+	return false;
+      }
+      pos = ( pos + 1 ) & mask;
+    }
+    if ( free_pos == _slots.size() ){
+      free_pos = pos;
+      ++_used;
+    }
+    _slots[free_pos] = { hash_val, store( key ), el };
+    ++_size;
+    return true;
+  }
+
+  bool IdIndex::erase( string_view key, const FoliaElement *el ){
+    /// remove an entry
+    /*!
+      \param key the id to remove
+      \param el when not 0, only remove the entry when it refers to el
+      \return true when an entry was removed
+    */
+    size_t pos = locate( key, hash<string_view>()( key ) );
+    if ( pos == _slots.size()
+	 || ( el && _slots[pos].el != el ) ){
+      return false;
+    }
+    _slots[pos].el = 0;
+    --_size;
+    return true;
+  }
+
+  void IdIndex::reserve( size_t n ){
+    /// make room for at least n entries without rebuilding the table
+    /*!
+      \param n the expected number of entries
+    */
+    if ( n * 4 > _slots.size() * 3 ){
+      rehash( max( n, _size ) );
+    }
+  }
+
+  void IdIndex::clear(){
+    /// remove all entries and release the memory
+    _slots.clear();
+    _pool.clear();
+    _pool_pos = 0;
+    _pool_left = 0;
+    _size = 0;
+    _used = 0;
+  }
+
+  void IdIndex::rehash( size_t n ){
+    /// rebuild the table with room for n entries
+    /*!
+      \param n the number of entries to make room for. At least size().
+
+      Tombstones are dropped, and the live keys are copied into a fresh pool.
+    */
+    size_t cap = 16;
+    while ( cap * 3 < n * 4 + 4 ){
+      cap *= 2;
+    }
+    vector<slot> old_slots( cap, slot{ 0, string_view(), 0 } );
+    old_slots.swap( _slots );
+    vector<unique_ptr<char[]>> old_pool;
+    old_pool.swap( _pool );
+    _pool_pos = 0;
+    _pool_left = 0;
+    _used = _size;
+    size_t mask = cap - 1;
+    for ( const auto& s : old_slots ){
+      if ( s.el ){
+	size_t pos = s.hash & mask;
+	while ( _slots[pos].key.data() ){
+	  pos = ( pos + 1 ) & mask;
+	}
+	_slots[pos] = { s.hash, store( s.key ), s.el };
+      }
+    }
+  }
+
+  /// the number of independently locked parts of the string pool
+  const size_t POOL_SHARDS = 16;
+
+  /// one part of the pool with all interned values
+  struct pool_shard {
+    shared_mutex lock; ///< guards values, and the removal of entries
+    unordered_map<string_view,interned_string::entry*> values; ///< keyed on
+    ///< the value of the entry itself
+  };
+
+  static pool_shard *pool_shards(){
+    /// return the POOL_SHARDS parts of the pool
+    /*!
+      The pool is never deleted, because nodes that are destroyed after the
+      static objects still release their values.
+    */
+    static pool_shard *shards = new pool_shard[POOL_SHARDS];
+    return shards;
+  }
+
+  static pool_shard& string_pool( string_view s ){
+    /// return the shard of the pool where s belongs
+    return pool_shards()[ hash<string_view>()( s ) % POOL_SHARDS ];
+  }
+
+  const string *interned_string::lookup( const string& s ){
+    /// search a value in the pool of interned strings
+    /*!
+      \param s the value to look up
+      \return a pointer to the pooled value, or 0 when s isn't in the pool.
+      The pointer is valid as long as some interned_string holds the value.
+    */
+    if ( s.empty() ){
+      return &empty_string;
+    }
+    pool_shard& shard = string_pool( s );
+    shared_lock<shared_mutex> lock( shard.lock );
+    auto it = shard.values.find( s );
+    if ( it == shard.values.end() ){
+      return 0;
+    }
+    return &it->second->value;
+  }
+
+  interned_string::entry *interned_string::intern( const string& s ){
+    /// return the pooled copy of a value, adding it when needed
+    /*!
+      \param s the value to intern
+      \return the pooled entry, with its count raised for the caller. 0 for
+      an empty value
+    */
+    if ( s.empty() ){
+      return 0;
+    }
+    pool_shard& shard = string_pool( s );
+    {
+      // the count may only go up from 0 while the entry is in the pool,
+      // which release() guards with the unique lock
+      shared_lock<shared_mutex> lock( shard.lock );
+      auto it = shard.values.find( s );
+      if ( it != shard.values.end() ){
+	++it->second->refs;
+	return it->second;
+      }
+    }
+    unique_lock<shared_mutex> lock( shard.lock );
+    auto it = shard.values.find( s );
+    if ( it != shard.values.end() ){
+      ++it->second->refs;
+      return it->second;
+    }
+    entry *result = new entry( s );
+    shard.values[result->value] = result;
+    return result;
+  }
+
+  void interned_string::release( entry *e ){
+    /// drop one use of a pooled entry, and remove it when it was the last
+    /*!
+      \param e the entry. May be 0
+    */
+    if ( !e ){
+      return;
+    }
+    size_t refs = e->refs;
+    while ( refs > 1 ){
+      // some other interned_string still holds it. No lock needed
+      if ( e->refs.compare_exchange_weak( refs, refs - 1 ) ){
+	return;
+      }
+    }
+    // probably the last one. Others may copy us meanwhile, but nobody can
+    // find the entry in the pool while we hold the unique lock
+    pool_shard& shard = string_pool( e->value );
+    unique_lock<shared_mutex> lock( shard.lock );
+    if ( --e->refs == 0 ){
+      shard.values.erase( e->value );
+      delete e;
+    }
+  }
+
+  size_t interned_string::pool_size(){
+    /// return the number of distinct values in the pool
+    size_t result = 0;
+    pool_shard *shards = pool_shards();
+    for ( size_t i=0; i < POOL_SHARDS; ++i ){
+      shared_lock<shared_mutex> lock( shards[i].lock );
+      result += shards[i].values.size();
+    }
+    return result;
+  }
+
   void addAttributes( const xmlNode *_node, const KWargs& atts ){
     /// add all attributes from 'atts' as attribute nodes to 'node`
     /*!
@@ -360,34 +752,30 @@ namespace folia {
       some special care is taken for attributes 'xml:id', 'id' and 'lang'
     */
     xmlNode *node = const_cast<xmlNode*>(_node); // strange libxml2 interface
-    KWargs attribs = atts;
-    auto it = attribs.find("xml:id");
-    if ( it != attribs.end() ){ // xml:id is special
+    auto it = atts.find("xml:id");
+    if ( it != atts.end() ){ // xml:id is special
       xmlSetProp( node,
 		  XML_XML_ID,
 		  to_xmlChar(it->second) );
-      attribs.erase(it);
     }
-    it = attribs.find("lang");
-    if ( it != attribs.end() ){ // lang is special too
+    it = atts.find("lang");
+    if ( it != atts.end() ){ // lang is special too
       xmlNodeSetLang( node,
 		      to_xmlChar(it->second) );
-      attribs.erase(it);
     }
-    it = attribs.find("id");
-    if ( it != attribs.end() ){
+    it = atts.find("id");
+    if ( it != atts.end() ){
       xmlSetProp( node,
 		  to_xmlChar("id"),
 		  to_xmlChar(it->second) );
-      attribs.erase(it);
     }
     // and now the rest
-    it = attribs.begin();
-    while ( it != attribs.end() ){
-      xmlSetProp( node,
-		  to_xmlChar(it->first),
-		  to_xmlChar(it->second) );
-      ++it;
+    for ( const auto& [att,val] : atts ){
+      if ( att != "xml:id" && att != "lang" && att != "id" ){
+	xmlSetProp( node,
+		    to_xmlChar(att),
+		    to_xmlChar(val) );
+      }
     }
   }
 
@@ -780,4 +1168,206 @@ namespace folia {
     return result;
   }
 
+  struct bz2_input {
+    /// the state of a streaming bzip2 decompression of a file
+    FILE *file;
+    BZFILE *bz;
+  };
+
+  static int bz2_read( void *context, char *buffer, int len ){
+    /// xmlInputReadCallback that decompresses the next part of a .bz2 file
+    /*!
+      \param context the bz2_input
+      \param buffer the buffer to fill
+      \param len the size of the buffer
+      \return the number of bytes stored, 0 at the end, -1 on errors
+    */
+    bz2_input *in = static_cast<bz2_input*>(context);
+    int got = 0;
+    while ( got == 0 && in->bz ){
+      int bzerr = BZ_OK;
+      got = BZ2_bzRead( &bzerr, in->bz, buffer, len );
+      if ( bzerr == BZ_STREAM_END ){
+	// a .bz2 file may hold several concatenated streams.
+	// continue with the next one, starting with the bytes already read
+	void *unused = 0;
+	int n_unused = 0;
+	BZ2_bzReadGetUnused( &bzerr, in->bz, &unused, &n_unused );
+	string rest( static_cast<const char*>(unused), n_unused );
+	BZ2_bzReadClose( &bzerr, in->bz );
+	in->bz = 0;
+	int c = EOF;
+	if ( rest.empty() && ( c = fgetc( in->file ) ) != EOF ){
+	  ungetc( c, in->file );
+	}
+	if ( !rest.empty() || c != EOF ){
+	  in->bz = BZ2_bzReadOpen( &bzerr, in->file, 0, 0,
+				   rest.empty() ? 0 : &rest[0],
+				   rest.size() );
+	  if ( bzerr != BZ_OK ){
+	    in->bz = 0;
+	    return -1;
+	  }
+	}
+      }
+      else if ( bzerr != BZ_OK ){
+	return -1;
+      }
+    }
+    return got;
+  }
+
+  static int bz2_close( void *context ){
+    /// xmlInputCloseCallback for a bz2_input
+    bz2_input *in = static_cast<bz2_input*>(context);
+    if ( in->bz ){
+      int bzerr;
+      BZ2_bzReadClose( &bzerr, in->bz );
+    }
+    fclose( in->file );
+    delete in;
+    return 0;
+  }
+
+  static int gz_read( void *context, char *buffer, int len ){
+    /// xmlInputReadCallback that decompresses the next part of a .gz file
+    /*!
+      \param context the gzFile
+      \param buffer the buffer to fill
+      \param len the size of the buffer
+      \return the number of bytes stored, 0 at the end, -1 on errors
+
+      Unlike the gzip support in some libxml2 versions, gzread() handles
+      files with several gzip members, as written by write_seekable_gz()
+    */
+    return gzread( static_cast<gzFile>(context), buffer, len );
+  }
+
+  static int gz_close( void *context ){
+    /// xmlInputCloseCallback for a gzFile
+    gzclose( static_cast<gzFile>(context) );
+    return 0;
+  }
+
+  static xmlTextReader *create_gz_reader( const string& file_name ){
+    /// create an xmlTextReader that decompresses a .gz file while parsing
+    gzFile file = gzopen( file_name.c_str(), "rb" );
+    if ( !file ){
+      return 0;
+    }
+    gzbuffer( file, 64*1024 );
+    // the close callback is called on all paths, also on failure
+    return xmlReaderForIO( gz_read, gz_close, file,
+			   file_name.c_str(), 0, XML_PARSER_OPTIONS );
+  }
+
+#ifdef HAVE_SYS_MMAN_H
+  struct mapped_input {
+    /// a read-only memory mapping of a complete file
+    const char *data;
+    size_t size;
+    size_t pos; ///< the part already handed to libxml2
+  };
+
+  static int mapped_read( void *context, char *buffer, int len ){
+    /// xmlInputReadCallback that copies the next part of a mapping
+    /*!
+      \param context the mapped_input
+      \param buffer the buffer to fill
+      \param len the size of the buffer
+      \return the number of bytes stored, 0 at the end
+    */
+    mapped_input *in = static_cast<mapped_input*>(context);
+    size_t n = min( static_cast<size_t>(len), in->size - in->pos );
+    memcpy( buffer, in->data + in->pos, n );
+    in->pos += n;
+    return n;
+  }
+
+  static int mapped_close( void *context ){
+    /// xmlInputCloseCallback for a mapped_input
+    mapped_input *in = static_cast<mapped_input*>(context);
+    munmap( const_cast<char*>(in->data), in->size );
+    delete in;
+    return 0;
+  }
+
+  static xmlTextReader *create_mapped_reader( const string& file_name ){
+    /// create an xmlTextReader that parses a file from a memory mapping
+    /*!
+      \param file_name the file to map
+      \return a new xmlTextReader, or 0 when the file cannot be mapped
+
+      libxml2 pulls the text through mapped_read(), in small blocks. So the
+      file is never read or copied as a whole, and the mapping lives exactly
+      as long as the reader.
+    */
+    int fd = open( file_name.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      return 0;
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    if ( fstat( fd, &st ) == 0
+	 && S_ISREG( st.st_mode )
+	 && st.st_size > 2 ){
+      data = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    }
+    close( fd );
+    if ( data == MAP_FAILED ){
+      return 0;
+    }
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    if ( bytes[0] == 0x1f && bytes[1] == 0x8b ){
+      // gzipped, without a .gz extension.
+      munmap( data, st.st_size );
+      return create_gz_reader( file_name );
+    }
+    madvise( data, st.st_size, MADV_SEQUENTIAL );
+    mapped_input *in = new mapped_input{ static_cast<const char*>(data),
+					 static_cast<size_t>(st.st_size),
+					 0 };
+    // the close callback is called on all paths, also on failure
+    return xmlReaderForIO( mapped_read, mapped_close, in,
+			   file_name.c_str(), 0, XML_PARSER_OPTIONS );
+  }
+#endif
+
+  xmlTextReader *create_file_reader( const string& file_name ){
+    /// create an xmlTextReader on a (possibly compressed) file
+    /*!
+      \param file_name the file to read. May be .gz or .bz2 compressed
+      \return a new xmlTextReader, or 0 on failure
+
+      Plain files are memory mapped and read from the mapping. .bz2 and .gz
+      files are decompressed while parsing. So the complete text is never copied
+      into a buffer or a temporary file.
+    */
+    if ( TiCC::match_back( file_name, ".bz2" ) ){
+      FILE *file = fopen( file_name.c_str(), "rb" );
+      if ( !file ){
+	return 0;
+      }
+      int bzerr = BZ_OK;
+      BZFILE *bz = BZ2_bzReadOpen( &bzerr, file, 0, 0, 0, 0 );
+      if ( bzerr != BZ_OK ){
+	fclose( file );
+	return 0;
+      }
+      // the close callback is called on all paths, also on failure
+      return xmlReaderForIO( bz2_read, bz2_close, new bz2_input{ file, bz },
+			     file_name.c_str(), 0, XML_PARSER_OPTIONS );
+    }
+    if ( TiCC::match_back( file_name, ".gz" ) ){
+      return create_gz_reader( file_name );
+    }
+#ifdef HAVE_SYS_MMAN_H
+    xmlTextReader *reader = create_mapped_reader( file_name );
+    if ( reader ){
+      return reader;
+    }
+#endif
+    return xmlReaderForFile( file_name.c_str(), 0, XML_PARSER_OPTIONS );
+  }
+
 } //namespace folia
@@ -0,0 +1,600 @@
+/*
+  Copyright (c) 2006 - 2024
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of libfolia
+
+  libfolia is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  libfolia is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcutils/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "config.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include "libfolia/folia.h"
+#include "libfolia/folia_properties.h"
+
+using namespace std;
+
+namespace folia {
+
+  /// the first bytes of a file written by DocumentView::write()
+  const char VIEW_MAGIC[8] = { 'F', 'o', 'L', 'i', 'A', 'm', 'a', 'p' };
+  /// the version of the file format. Increment on every change
+  const uint32_t VIEW_VERSION = 1;
+  /// the parent of the root node
+  const uint32_t NO_NODE = UINT32_MAX;
+  /// the text of a node without text
+  const uint32_t NO_TEXT = UINT32_MAX;
+
+  struct view_header {
+    /// the start of a DocumentView file.
+    /// All offsets are in bytes from the start of the file
+    char magic[8];           ///< VIEW_MAGIC
+    uint32_t version;        ///< VIEW_VERSION
+    uint32_t node_count;     ///< the size of the node array
+    uint32_t child_count;    ///< the size of the children array
+    uint32_t string_count;   ///< the number of strings
+    uint32_t id_count;       ///< the number of nodes with an xml:id
+    uint32_t word_count;     ///< the number of words()
+    uint32_t sentence_count; ///< the number of sentences()
+    uint32_t reserved;       ///< padding, always 0
+    uint64_t children;       ///< the offset of the children array
+    uint64_t ids;            ///< the offset of the nodes sorted on xml:id
+    uint64_t words;          ///< the offset of the words() array
+    uint64_t sentences;      ///< the offset of the sentences() array
+    uint64_t strings;        ///< the offset of the string offsets
+    uint64_t file_size;      ///< the size of the complete file
+  };
+
+  struct view_node {
+    /// one node of the tree. The node array directly follows the header
+    uint32_t type;   ///< the ElementType
+    uint32_t parent; ///< the index of the parent node, or NO_NODE
+    uint32_t first;  ///< the position of the first child in the children
+    uint32_t count;  ///< the number of children
+    uint32_t id;     ///< the string index of the xml:id
+    uint32_t cls;    ///< the string index of the class
+    uint32_t set;    ///< the string index of the set
+    uint32_t text;   ///< the string index of the text, or NO_TEXT
+  };
+
+  static uint64_t aligned( uint64_t offset ){
+    /// round offset up to a multiple of 8
+    return ( offset + 7 ) & ~uint64_t(7);
+  }
+
+  DocumentView::DocumentView():
+    _data(0),
+    _size(0),
+    _mapped(false),
+    _header(0),
+    _nodes(0),
+    _children(0),
+    _strings(0)
+  {
+  }
+
+  DocumentView::DocumentView( const string& file_name ):
+    DocumentView()
+  {
+    /// create a view on file_name
+    /*!
+      \param file_name a file created by DocumentView::write()
+    */
+    open( file_name );
+  }
+
+  DocumentView::~DocumentView(){
+    close();
+  }
+
+  void DocumentView::close(){
+    /// release the file. All Node handles become invalid.
+#ifdef HAVE_SYS_MMAN_H
+    if ( _mapped ){
+      munmap( const_cast<char*>(_data), _size );
+    }
+#endif
+    _buffer.clear();
+    _buffer.shrink_to_fit();
+    _file.clear();
+    _data = 0;
+    _size = 0;
+    _mapped = false;
+    _header = 0;
+    _nodes = 0;
+    _children = 0;
+    _strings = 0;
+  }
+
+  void DocumentView::open( const string& file_name ){
+    /// map a file created by DocumentView::write()
+    /*!
+      \param file_name the file to open
+
+      The file is memory mapped read-only, when the platform supports it.
+      Otherwise it is read into memory.
+      Will throw when the file can't be opened, or is corrupt.
+    */
+    const string name = file_name; // file_name may be our own _file
+    close();
+    int fd = ::open( name.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      throw invalid_argument( "DocumentView: unable to open: " + name );
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0
+	 || !S_ISREG( st.st_mode )
+	 || size_t(st.st_size) < sizeof(view_header) ){
+      ::close( fd );
+      throw DocumentError( name, "not a DocumentView file" );
+    }
+    _size = st.st_size;
+#ifdef HAVE_SYS_MMAN_H
+    void *data = mmap( 0, _size, PROT_READ, MAP_SHARED, fd, 0 );
+    if ( data != MAP_FAILED ){
+      _data = static_cast<const char*>(data);
+      _mapped = true;
+    }
+#endif
+    if ( !_mapped ){
+      // use uint64_t's to get the alignment of the mapped case
+      _buffer.resize( aligned( _size ) / 8 );
+      char *buf = reinterpret_cast<char*>( _buffer.data() );
+      size_t done = 0;
+      while ( done < _size ){
+	ssize_t len = read( fd, buf + done, _size - done );
+	if ( len <= 0 ){
+	  break;
+	}
+	done += len;
+      }
+      if ( done != _size ){
+	::close( fd );
+	close();
+	throw DocumentError( name, "reading failed" );
+      }
+      _data = buf;
+    }
+    ::close( fd );
+    _file = name;
+    _header = reinterpret_cast<const view_header*>( _data );
+    // check all sizes and indices once, so the accessors don't have to
+    const view_header& h = *_header;
+    auto corrupt = [&]( const string& what ){
+      string mess = "corrupt DocumentView file (" + what + ")";
+      close();
+      throw DocumentError( name, mess );
+    };
+    if ( memcmp( h.magic, VIEW_MAGIC, sizeof(VIEW_MAGIC) ) != 0 ){
+      close();
+      throw DocumentError( name, "not a DocumentView file" );
+    }
+    if ( h.version != VIEW_VERSION ){
+      close();
+      throw DocumentError( name,
+			   "unsupported version of the DocumentView format" );
+    }
+    auto section_ok = [&]( uint64_t offset, uint64_t count, size_t width ){
+      return offset % 8 == 0
+	&& offset <= _size
+	&& count <= ( _size - offset ) / width;
+    };
+    if ( h.file_size != _size
+	 || !section_ok( sizeof(view_header), h.node_count, sizeof(view_node) )
+	 || !section_ok( h.children, h.child_count, 4 )
+	 || !section_ok( h.ids, h.id_count, 4 )
+	 || !section_ok( h.words, h.word_count, 4 )
+	 || !section_ok( h.sentences, h.sentence_count, 4 )
+	 || h.string_count == 0
+	 || !section_ok( h.strings, uint64_t(h.string_count) + 1, 8 ) ){
+      corrupt( "sections" );
+    }
+    _nodes = reinterpret_cast<const view_node*>( _data + sizeof(view_header) );
+    _children = reinterpret_cast<const uint32_t*>( _data + h.children );
+    _strings = reinterpret_cast<const uint64_t*>( _data + h.strings );
+    uint64_t blob = h.strings + ( uint64_t(h.string_count) + 1 ) * 8;
+    if ( _strings[0] != 0 ){
+      corrupt( "strings" );
+    }
+    for ( uint32_t i=0; i < h.string_count; ++i ){
+      if ( _strings[i+1] <= _strings[i]
+	   || _strings[i+1] > _size - blob
+	   || _data[blob + _strings[i+1] - 1] != '\0' ){
+	corrupt( "strings" );
+      }
+    }
+    if ( h.node_count == 0 ){
+      corrupt( "nodes" );
+    }
+    for ( uint32_t i=0; i < h.node_count; ++i ){
+      const view_node& n = _nodes[i];
+      if ( n.type >= LastElement
+	   || ( n.parent >= h.node_count && n.parent != NO_NODE )
+	   || n.first > h.child_count
+	   || n.count > h.child_count - n.first
+	   || n.id >= h.string_count
+	   || n.cls >= h.string_count
+	   || n.set >= h.string_count
+	   || ( n.text >= h.string_count && n.text != NO_TEXT ) ){
+	corrupt( "nodes" );
+      }
+    }
+    auto nodes_ok = [&]( uint64_t offset, uint32_t count ){
+      const uint32_t *v = reinterpret_cast<const uint32_t*>( _data + offset );
+      return all_of( v, v + count,
+		     [&]( uint32_t n ){ return n < h.node_count; } );
+    };
+    if ( !nodes_ok( h.children, h.child_count )
+	 || !nodes_ok( h.ids, h.id_count )
+	 || !nodes_ok( h.words, h.word_count )
+	 || !nodes_ok( h.sentences, h.sentence_count ) ){
+      corrupt( "indices" );
+    }
+  }
+
+  string_view DocumentView::string_at( uint32_t i ) const {
+    /// return string i from the string table
+    const char *blob = _data + _header->strings
+      + ( uint64_t(_header->string_count) + 1 ) * 8;
+    return string_view( blob + _strings[i], _strings[i+1] - _strings[i] - 1 );
+  }
+
+  vector<DocumentView::Node> DocumentView::node_list( uint64_t offset,
+						      uint32_t count ) const {
+    /// return the nodes of an index array in the file
+    vector<Node> result;
+    result.reserve( count );
+    const uint32_t *v = reinterpret_cast<const uint32_t*>( _data + offset );
+    for ( uint32_t i=0; i < count; ++i ){
+      result.push_back( Node( this, v[i] ) );
+    }
+    return result;
+  }
+
+  size_t DocumentView::size() const {
+    return _header ? _header->node_count : 0;
+  }
+
+  DocumentView::Node DocumentView::doc() const {
+    /// return the root node, or an invalid Node when nothing is opened
+    if ( !_header ){
+      return Node();
+    }
+    return Node( this, 0 );
+  }
+
+  DocumentView::Node DocumentView::index( string_view id ) const {
+    /// lookup a node by its xml:id
+    /*!
+      \param id the xml:id to search for
+      \return the Node. Or an invalid Node when not found
+    */
+    if ( !_header ){
+      return Node();
+    }
+    const uint32_t *ids = reinterpret_cast<const uint32_t*>( _data
+							     + _header->ids );
+    const uint32_t *end = ids + _header->id_count;
+    auto it = lower_bound( ids, end, id,
+			   [this]( uint32_t n, string_view key ){
+			     return string_at( _nodes[n].id ) < key; } );
+    if ( it != end && string_at( _nodes[*it].id ) == id ){
+      return Node( this, *it );
+    }
+    return Node();
+  }
+
+  vector<DocumentView::Node> DocumentView::select( ElementType et,
+						   SELECT_FLAGS flag ) const {
+    /// select nodes of type et in the whole document, like
+    /// FoliaElement::select()
+    if ( !_header ){
+      return {};
+    }
+    return doc().select( et, flag );
+  }
+
+  vector<DocumentView::Node> DocumentView::words() const {
+    /// return the same Words as Document::words() in the original Document
+    if ( !_header ){
+      return {};
+    }
+    return node_list( _header->words, _header->word_count );
+  }
+
+  vector<DocumentView::Node> DocumentView::sentences() const {
+    /// return the same Sentences as Document::sentences() in the original
+    /// Document
+    if ( !_header ){
+      return {};
+    }
+    return node_list( _header->sentences, _header->sentence_count );
+  }
+
+  const view_node& DocumentView::Node::node() const {
+    if ( !_view ){
+      throw logic_error( "DocumentView::Node: invalid node" );
+    }
+    return _view->_nodes[_index];
+  }
+
+  ElementType DocumentView::Node::element_id() const {
+    return static_cast<ElementType>( node().type );
+  }
+
+  string DocumentView::Node::xmltag() const {
+    return toString( element_id() );
+  }
+
+  string_view DocumentView::Node::id() const {
+    return _view ? _view->string_at( node().id ) : string_view();
+  }
+
+  string_view DocumentView::Node::cls() const {
+    return _view ? _view->string_at( node().cls ) : string_view();
+  }
+
+  string_view DocumentView::Node::sett() const {
+    return _view ? _view->string_at( node().set ) : string_view();
+  }
+
+  bool DocumentView::Node::hastext() const {
+    return _view && node().text != NO_TEXT;
+  }
+
+  string_view DocumentView::Node::text() const {
+    /// return the text of the node, as str() returned in the original
+    /// Document. Will throw NoSuchText when there is none.
+    if ( !hastext() ){
+      throw NoSuchText( "DocumentView node " + string( id() ) );
+    }
+    return _view->string_at( node().text );
+  }
+
+  size_t DocumentView::Node::size() const {
+    return _view ? node().count : 0;
+  }
+
+  DocumentView::Node DocumentView::Node::index( size_t i ) const {
+    /// return child i. Will throw when out of range
+    if ( i >= size() ){
+      throw range_error( "DocumentView::Node::index() out of range" );
+    }
+    return Node( _view, _view->_children[node().first + i] );
+  }
+
+  DocumentView::Node DocumentView::Node::parent() const {
+    /// return the parent, or an invalid Node for the root
+    if ( !_view || node().parent == NO_NODE ){
+      return Node();
+    }
+    return Node( _view, node().parent );
+  }
+
+  template <typename MATCH>
+  static void select_view( const DocumentView::Node& node,
+			   const MATCH& match,
+			   SELECT_FLAGS flag,
+			   vector<DocumentView::Node>& res ){
+    /// the recursive worker for DocumentView::Node::select(). Walks the
+    /// tree in the same order as FoliaElement::select() does
+    for ( size_t i=0; i < node.size(); ++i ){
+      DocumentView::Node child = node.index( i );
+      if ( match( child ) ){
+	res.push_back( child );
+	if ( flag == SELECT_FLAGS::TOP_HIT ){
+	  flag = SELECT_FLAGS::LOCAL;
+	}
+      }
+      if ( flag != SELECT_FLAGS::LOCAL
+	   && !default_ignore.contains( child.element_id() ) ){
+	select_view( child, match, flag, res );
+      }
+    }
+  }
+
+  vector<DocumentView::Node> DocumentView::Node::select( ElementType et,
+							 SELECT_FLAGS flag ) const {
+    /// select all nodes of type et below this node
+    /*!
+      \param et the ElementType to search
+      \param flag the SELECT_FLAGS strategy, as in FoliaElement::select()
+      \return the matching nodes
+
+      like FoliaElement::select(), the default_ignore elements (Original,
+      Suggestion, Alternative etc.) are not searched.
+    */
+    vector<Node> res;
+    select_view( *this,
+		 [et]( const Node& n ){ return n.element_id() == et; },
+		 flag,
+		 res );
+    return res;
+  }
+
+  vector<DocumentView::Node> DocumentView::Node::select( ElementType et,
+							 const string& st,
+							 SELECT_FLAGS flag ) const {
+    /// select all nodes of type et in set st below this node
+    /*!
+      \param et the ElementType to search
+      \param st the set the nodes must be in. When empty, any set matches
+      \param flag the SELECT_FLAGS strategy, as in FoliaElement::select()
+      \return the matching nodes
+    */
+    vector<Node> res;
+    select_view( *this,
+		 [et,&st]( const Node& n ){
+		   return n.element_id() == et
+		     && ( st.empty() || n.sett() == st ); },
+		 flag,
+		 res );
+    return res;
+  }
+
+  static void number_nodes( const FoliaElement *el,
+			    unordered_map<const FoliaElement*,uint32_t>& nrs,
+			    vector<const FoliaElement*>& order ){
+    /// give el and all the nodes it owns a number, in document order
+    nrs[el] = order.size();
+    order.push_back( el );
+    for ( const auto *child : el->data() ){
+      if ( child->parent() == el ){
+	number_nodes( child, nrs, order );
+      }
+    }
+  }
+
+  void DocumentView::write( const Document& doc, const string& file_name ){
+    /// save doc in the DocumentView file format
+    /*!
+      \param doc the Document to save
+      \param file_name the file to create
+    */
+    const FoliaElement *root = doc.doc();
+    if ( !root ){
+      throw runtime_error( "DocumentView::write: empty document" );
+    }
+    unordered_map<const FoliaElement*,uint32_t> nrs;
+    vector<const FoliaElement*> order;
+    number_nodes( root, nrs, order );
+    unordered_map<string,uint32_t> string_ids;
+    vector<const string*> strings;
+    auto str_index = [&]( const string& s ){
+      auto it = string_ids.find( s );
+      if ( it == string_ids.end() ){
+	it = string_ids.emplace( s, strings.size() ).first;
+	strings.push_back( &it->first );
+      }
+      return it->second;
+    };
+    str_index( "" );
+    vector<view_node> nodes;
+    nodes.reserve( order.size() );
+    vector<uint32_t> children;
+    vector<uint32_t> ids;
+    for ( const auto *el : order ){
+      view_node n;
+      n.type = el->element_id();
+      n.parent = ( el == root ) ? NO_NODE : nrs[el->parent()];
+      n.first = children.size();
+      n.count = el->size();
+      n.id = str_index( el->id() );
+      n.cls = str_index( el->cls() );
+      n.set = str_index( el->sett() );
+      n.text = NO_TEXT;
+      try {
+	n.text = str_index( el->str() );
+      }
+      catch ( const NoSuchText& ){
+      }
+      nodes.push_back( n );
+      for ( const auto *child : el->data() ){
+	auto it = nrs.find( child );
+	if ( it == nrs.end() ){
+	  throw runtime_error( "DocumentView::write: node " + child->id()
+			       + " is not part of the document" );
+	}
+	children.push_back( it->second );
+      }
+      if ( !el->id().empty() ){
+	ids.push_back( nrs[el] );
+      }
+    }
+    sort( ids.begin(), ids.end(),
+	  [&]( uint32_t a, uint32_t b ){ return order[a]->id() < order[b]->id(); } );
+    vector<uint32_t> words;
+    for ( const auto *w : doc.words() ){
+      words.push_back( nrs[w] );
+    }
+    vector<uint32_t> sentences;
+    for ( const auto *s : doc.sentences() ){
+      sentences.push_back( nrs[s] );
+    }
+    vector<uint64_t> offsets = { 0 };
+    for ( const auto *s : strings ){
+      offsets.push_back( offsets.back() + s->size() + 1 );
+    }
+    view_header h;
+    memset( &h, 0, sizeof(h) );
+    memcpy( h.magic, VIEW_MAGIC, sizeof(VIEW_MAGIC) );
+    h.version = VIEW_VERSION;
+    h.node_count = nodes.size();
+    h.child_count = children.size();
+    h.string_count = strings.size();
+    h.id_count = ids.size();
+    h.word_count = words.size();
+    h.sentence_count = sentences.size();
+    h.children = aligned( sizeof(h) + nodes.size() * sizeof(view_node) );
+    h.ids = aligned( h.children + children.size() * 4 );
+    h.words = aligned( h.ids + ids.size() * 4 );
+    h.sentences = aligned( h.words + words.size() * 4 );
+    h.strings = aligned( h.sentences + sentences.size() * 4 );
+    h.file_size = h.strings + offsets.size() * 8 + offsets.back();
+    ofstream os( file_name, ios::binary );
+    if ( !os ){
+      throw runtime_error( "DocumentView::write: unable to create: "
+			   + file_name );
+    }
+    auto put = [&]( const void *data, size_t len ){
+      os.write( static_cast<const char*>(data), len );
+    };
+    auto pad = [&]( uint64_t offset ){
+      static const char zeros[8] = {0};
+      put( zeros, offset - os.tellp() );
+    };
+    put( &h, sizeof(h) );
+    put( nodes.data(), nodes.size() * sizeof(view_node) );
+    pad( h.children );
+    put( children.data(), children.size() * 4 );
+    pad( h.ids );
+    put( ids.data(), ids.size() * 4 );
+    pad( h.words );
+    put( words.data(), words.size() * 4 );
+    pad( h.sentences );
+    put( sentences.data(), sentences.size() * 4 );
+    pad( h.strings );
+    put( offsets.data(), offsets.size() * 8 );
+    for ( const auto *s : strings ){
+      put( s->c_str(), s->size() + 1 );
+    }
+    if ( !os.good() ){
+      throw runtime_error( "DocumentView::write: writing " + file_name
+			   + " failed" );
+    }
+  }
+
+} // namespace folia
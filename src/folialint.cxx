@@ -27,9 +27,16 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "ticcutils/CommandLine.h"
+#include "ticcutils/StringOps.h"
 #include "libfolia/folia.h"
 
 using namespace std;
@@ -57,6 +64,150 @@ void usage(){
   cerr << "\t--KANON\t\t\t same as --canonical" << endl;
   cerr << "\t-d value, --debug=value\t Run more verbose." << endl;
   cerr << "\t--permissive\t\t Accept some unwise constructions." << endl;
+  cerr << "\t-j value, --threads=value\t validate 'value' files in parallel." << endl;
+  cerr << "\t\t\t\t Output is still given in the order of the inputfiles." << endl;
+  cerr << "\t\t\t\t (default: 1)" << endl;
+}
+
+struct lint_settings {
+  /// the per-run options that steer the handling of one file
+  string mode;
+  string command;
+  string outputName;
+  bool warn;
+  bool strip;
+  bool kanon;
+  bool nooutput;
+};
+
+struct lint_result {
+  /// the outcome of handling one file
+  string out;       ///< what should go to stdout (in parallel runs)
+  string err;       ///< what should go to stderr (in parallel runs)
+  bool ok = false;
+  int warn_count = 0;
+};
+
+bool lint_file( const string& inputName,
+		const lint_settings& settings,
+		ostream& out,
+		ostream& err,
+		int& warn_count ){
+  /// parse, validate and output one FoLiA file
+  /*!
+    \param inputName the file to handle
+    \param settings the options to use
+    \param out the stream to output the FoLiA to
+    \param err the stream to send messages to
+    \param warn_count the number of warnings the library gave on this file
+    \return true on success, false when an exception occured
+  */
+  try {
+    string cmd = "file='" + inputName + "'";
+    cmd += settings.mode;
+    //      cerr << "running " << cmd << endl;
+    folia::Document d( cmd );
+    if ( !d.version_below(2,0)
+	 && !(settings.kanon||settings.strip)
+	 && d.get_processors_by_name( "folialint" ).empty() ){
+      folia::KWargs args;
+      args["name"] = "folialint";
+      args["id"] = "folialint";
+      args["generator"] = "yes";
+      args["begindatetime"] = "now()";
+      args["command"] = settings.command;
+      folia::processor *proc = d.add_processor( args );
+      proc->get_system_defaults();
+      proc->set_metadata( "valid", "yes" );
+    }
+    if ( !settings.outputName.empty() ){
+      d.save( settings.outputName, settings.kanon );
+    }
+    else if ( !settings.nooutput ){
+      d.set_canonical(settings.kanon);
+      out << d;
+    }
+    else {
+      err << "Validated successfully: " << inputName << endl;
+    }
+    if ( settings.warn ){
+      if ( d.compare_to_build_version() ){
+	err << "WARNING: the document had version: " << d.version()
+	    << " and the library is at version: "
+	    <<  folia::folia_version() << endl;
+      }
+      multimap<folia::AnnotationType, string> und = d.unused_declarations();
+      if ( !und.empty() ){
+	err << "the following annotationsets are declared but unused: " << endl;
+	for ( const auto& [ann,sett] : und ){
+	  err << folia::toString( ann )<< "-annotation, set=" << sett << endl;
+	}
+      }
+    }
+    warn_count = d.get_warn_count();
+  }
+  catch( const exception& e ){
+    err << e.what() << endl;
+    return false;
+  }
+  return true;
+}
+
+void lint_parallel( const vector<string>& fileNames,
+		    const lint_settings& settings,
+		    unsigned int threads,
+		    vector<lint_result>& results ){
+  /// handle all files using a pool of threads
+  /*!
+    \param fileNames the files to handle
+    \param settings the options to use
+    \param threads the number of worker threads
+    \param results the outcome per file, in the order of fileNames
+
+    The workers pick the next file from a shared counter. The output of
+    each file is buffered, and written by the main thread as soon as all
+    preceding files are done. So the output is the same as for a serial run.
+  */
+  results.resize( fileNames.size() );
+  vector<bool> done( fileNames.size(), false );
+  atomic<size_t> next_file( 0 );
+  mutex done_lock;
+  condition_variable done_signal;
+  auto worker = [&](){
+    size_t i;
+    while ( ( i = next_file++ ) < fileNames.size() ){
+      ostringstream out;
+      ostringstream err;
+      lint_result& res = results[i];
+      res.ok = lint_file( fileNames[i], settings, out, err, res.warn_count );
+      res.out = out.str();
+      res.err = err.str();
+      {
+	lock_guard<mutex> lock( done_lock );
+	done[i] = true;
+      }
+      done_signal.notify_one();
+    }
+  };
+  vector<thread> pool;
+  for ( unsigned int t=0; t < threads; ++t ){
+    pool.emplace_back( worker );
+  }
+  for ( size_t i=0; i < fileNames.size(); ++i ){
+    {
+      unique_lock<mutex> lock( done_lock );
+      done_signal.wait( lock, [&]{ return done[i]; } );
+    }
+    cout << results[i].out;
+    cout.flush();
+    cerr << results[i].err;
+    // no need to keep the buffers any longer
+    string().swap( results[i].out );
+    string().swap( results[i].err );
+  }
+  for ( auto& t : pool ){
+    t.join();
+  }
 }
 
 int main( int argc, const char* argv[] ){
@@ -70,14 +221,15 @@ int main( int argc, const char* argv[] ){
   bool kanon = false;
   bool autodeclare = false;
   bool do_explicit = false;
+  unsigned int threads = 1;
   string debug;
   vector<string> fileNames;
   string command;
   try {
-    TiCC::CL_Options Opts( "hVd:axo:",
+    TiCC::CL_Options Opts( "hVd:axo:j:",
 			   "nochecktext,debug:,permissive,strip,output:,"
 			   "nooutput,help,fixtext,warn,version,canonical,"
-			   "KANON,explicit,autodeclare");
+			   "KANON,explicit,autodeclare,threads:");
     Opts.init(argc, argv );
     if ( Opts.extract( 'h' )
 	 || Opts.extract( "help" ) ){
@@ -114,6 +266,13 @@ int main( int argc, const char* argv[] ){
     Opts.extract( "debug", debug ) || Opts.extract( 'd', debug );
     Opts.extract( "output", outputName ) || Opts.extract( 'o', outputName );
     autodeclare = Opts.extract( "autodeclare" ) || Opts.extract( 'a' );
+    string value;
+    if ( Opts.extract( "threads", value ) || Opts.extract( 'j', value ) ){
+      if ( !TiCC::stringTo( value, threads ) || threads == 0 ){
+	cerr << "illegal value for -j or --threads (" << value << ")" << endl;
+	return EXIT_FAILURE;
+      }
+    }
 
     if ( !Opts.empty() ){
       cerr << "unsupported option(s): " << Opts.toString() << endl;
@@ -172,54 +331,49 @@ int main( int argc, const char* argv[] ){
   if ( !debug.empty() ){
     mode += ", debug='" + debug + "'";
   }
-  for ( const auto& inputName : fileNames ){
-    try {
-      string cmd = "file='" + inputName + "'";
-      cmd += mode;
-      //      cerr << "running " << cmd << endl;
-      folia::Document d( cmd );
-      if ( !d.version_below(2,0)
-	   && !(kanon||strip)
-	   && d.get_processors_by_name( "folialint" ).empty() ){
-	folia::KWargs args;
-	args["name"] = "folialint";
-	args["id"] = "folialint";
-	args["generator"] = "yes";
-	args["begindatetime"] = "now()";
-	args["command"] = command;
-	folia::processor *proc = d.add_processor( args );
-	proc->get_system_defaults();
-	proc->set_metadata( "valid", "yes" );
-      }
-      if ( !outputName.empty() ){
-	d.save( outputName, kanon );
-      }
-      else if ( !nooutput ){
-	d.set_canonical(kanon);
-	cout << d;
-      }
-      else {
-	cerr << "Validated successfully: " << inputName << endl;
-      }
-      if ( warn ){
-	if ( d.compare_to_build_version() ){
-	  cerr << "WARNING: the document had version: " << d.version()
-	       << " and the library is at version: "
-	       <<  folia::folia_version() << endl;
-	}
-	multimap<folia::AnnotationType, string> und = d.unused_declarations();
-	if ( !und.empty() ){
-	  cerr << "the following annotationsets are declared but unused: " << endl;
-	  for ( const auto& [ann,sett] : und ){
-	    cerr << folia::toString( ann )<< "-annotation, set=" << sett << endl;
-	  }
-	}
-      }
+  lint_settings settings;
+  settings.mode = mode;
+  settings.command = command;
+  settings.outputName = outputName;
+  settings.warn = warn;
+  settings.strip = strip;
+  settings.kanon = kanon;
+  settings.nooutput = nooutput;
+  if ( threads > fileNames.size() ){
+    threads = fileNames.size();
+  }
+  vector<lint_result> results;
+  if ( threads > 1 ){
+    // make sure libxml2 is initialized before any worker starts
+    xmlInitParser();
+    lint_parallel( fileNames, settings, threads, results );
+  }
+  else {
+    results.resize( fileNames.size() );
+    for ( size_t i=0; i < fileNames.size(); ++i ){
+      results[i].ok = lint_file( fileNames[i], settings, cout, cerr,
+				 results[i].warn_count );
     }
-    catch( const exception& e ){
-      cerr << e.what() << endl;
+  }
+  int warn_total = 0;
+  for ( const auto& res : results ){
+    if ( !res.ok ){
       ++fail_count;
     }
+    warn_total += res.warn_count;
+  }
+  if ( fileNames.size() > 1 ){
+    cerr << "folialint: handled " << fileNames.size() << " files, "
+	 << fail_count << " failed, " << warn_total << " warnings." << endl;
+    for ( size_t i=0; i < fileNames.size(); ++i ){
+      if ( !results[i].ok ){
+	cerr << "\tFAILED: " << fileNames[i] << endl;
+      }
+      else if ( results[i].warn_count > 0 ){
+	cerr << "\t" << results[i].warn_count << " warnings: "
+	     << fileNames[i] << endl;
+      }
+    }
   }
   if ( fail_count > 0 ){
     exit( EXIT_FAILURE );
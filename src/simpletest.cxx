@@ -28,16 +28,681 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <sstream>
 #include <cassert>
 #include "ticcutils/StringOps.h"
 #include "ticcutils/Unicode.h"
+#include "ticcutils/zipper.h"
 #include "libfolia/folia.h"
+#include "libfolia/folia_properties.h"
 
 using namespace std;
 using namespace icu;
 using namespace folia;
 using namespace icu;
 
+/// a FoLiA document with two sentences that don't match their words.
+/// w.3 has a class, so the output checks catch it too
+const string buffer_bad_text = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<FoLiA xmlns=\"http://ilk.uvt.nl/folia\" xml:id=\"bad\" version=\"2.5\">"
+  "<metadata type=\"native\"><annotations><token-annotation/>"
+  "<text-annotation/><sentence-annotation/></annotations></metadata>"
+  "<text xml:id=\"bad.text\">"
+  "<s xml:id=\"s.1\"><t>a b</t><w xml:id=\"w.1\"><t>a</t></w>"
+  "<w xml:id=\"w.2\"><t>b</t></w></s>"
+  "<s xml:id=\"s.2\"><t>x y</t><w xml:id=\"w.3\" class=\"current\"><t>c</t></w></s>"
+  "<s xml:id=\"s.3\"><t>z</t><w xml:id=\"w.4\"><t>d</t></w></s>"
+  "</text></FoLiA>";
+
+string build_test_doc( const string& id, size_t sentences ){
+  /// create a FoLiA document with some annotations, as an XML string
+  Document doc( "xml:id='" + id + "'" );
+  doc.declare( AnnotationType::POS, "adhocpos", "annotator='simpletest'" );
+  FoliaElement *text = doc.addText( getArgs( "xml:id='" + id + ".text'" ) );
+  FoliaElement *par = new Paragraph( getArgs( "generate_id='" + text->id() + "'" ),
+				     &doc );
+  text->append( par );
+  for ( size_t i=0; i < sentences; ++i ){
+    FoliaElement *sent = new Sentence( getArgs( "generate_id='" + par->id() + "'" ),
+				       &doc );
+    par->append( sent );
+    vector<string> words = { "Dit", "is", "zin", to_string(i), "." };
+    for ( const auto& w : words ){
+      KWargs args;
+      args["text"] = w;
+      Word *word = dynamic_cast<Sentence*>(sent)->addWord( args );
+      args.clear();
+      args["class"] = ( w == "." ) ? "LET" : "WORD";
+      word->addPosAnnotation( args );
+    }
+  }
+  return doc.xmlstring();
+}
+
+bool concurrent_parse_test( const vector<string>& corpus ){
+  /// parse, query and serialize the corpus from 16 threads at once
+  /*!
+    every thread must get exactly the same results as a serial run.
+  */
+  vector<string> ref_xml;
+  vector<size_t> ref_words;
+  for ( const auto& buf : corpus ){
+    Document doc;
+    doc.read_from_string( buf );
+    ref_xml.push_back( doc.xmlstring() );
+    ref_words.push_back( doc.words().size() );
+  }
+  atomic<int> failures( 0 );
+  auto worker = [&]( int nr ){
+    for ( int round=0; round < 10; ++round ){
+      for ( size_t i=0; i < corpus.size(); ++i ){
+	try {
+	  Document doc;
+	  if ( (nr + round) % 2 ){
+	    doc.setmode( "arena" );
+	  }
+	  doc.read_from_string( corpus[i] );
+	  if ( doc.words().size() != ref_words[i]
+	       || doc.xmlstring() != ref_xml[i] ){
+	    ++failures;
+	  }
+	}
+	catch ( const exception& e ){
+	  cerr << "thread " << nr << ": " << e.what() << endl;
+	  ++failures;
+	}
+      }
+    }
+  };
+  vector<thread> threads;
+  for ( int t=0; t < 16; ++t ){
+    threads.emplace_back( worker, t );
+  }
+  for ( auto& t : threads ){
+    t.join();
+  }
+  return failures == 0;
+}
+
+bool string_pool_test(){
+  /// check that interned values leave the pool with the last node using them
+  const string value = "only-in-the-pool-test";
+  size_t before = interned_string::pool_size();
+  Document *first = new Document();
+  first->read_from_string( build_test_doc( "pool", 2 ) );
+  KWargs args;
+  args["class"] = value;
+  args["set"] = "adhocpos";
+  first->words(0)->addPosAnnotation( args );
+  Document *second = new Document();
+  second->read_from_string( first->xmlstring() );
+  if ( !interned_string::lookup( value ) ){
+    cout << "value not pooled" << endl;
+    return false;
+  }
+  delete first;
+  if ( !interned_string::lookup( value ) ){
+    cout << "value removed while still in use" << endl;
+    return false;
+  }
+  delete second;
+  if ( interned_string::lookup( value )
+       || interned_string::pool_size() != before ){
+    cout << "values not removed from the pool" << endl;
+    return false;
+  }
+  return true;
+}
+
+bool fragment_index_test( const string& buffer ){
+  /// load single sentences through a FragmentIndex, from a plain file and
+  /// from a seekable gzip file
+  const string plain = "simpletest.idx.xml";
+  const string packed = "simpletest.idx.xml.gz";
+  ofstream os( plain );
+  os << buffer;
+  os.close();
+  write_seekable_gz( plain, packed, 1024 );
+  Document full;
+  full.read_from_string( buffer );
+  for ( const auto& file : { plain, packed } ){
+    FragmentIndex index;
+    index.build( file, "s" );
+    index.save( FragmentIndex::default_name( file ) );
+    FragmentIndex loaded;
+    loaded.load( FragmentIndex::default_name( file ) );
+    if ( loaded.size() != index.size() ){
+      return false;
+    }
+    for ( const auto *s : full.sentences() ){
+      Document frag;
+      FoliaElement *e = frag.load_fragment( loaded, s->id() );
+      if ( !e
+	   || e->xmlstring() != s->xmlstring()
+	   || frag.sentences().size() != 1 ){
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+vector<string> text_parent_ids( const string& file,
+				bool prefer_struct,
+				bool single_pass ){
+  /// return the ids of all text parents a TextEngine hands out
+  TextEngine engine( file );
+  engine.setup( "current", prefer_struct, single_pass );
+  vector<string> result;
+  FoliaElement *e;
+  while ( ( e = engine.next_text_parent() ) ){
+    result.push_back( e->id() );
+  }
+  return result;
+}
+
+bool text_engine_test(){
+  /// the single pass TextEngine must hand out the same text parents as the
+  /// full scan
+  /*!
+    the second \<p> has text in a \<w> after 1500 sentences, so with
+    prefer_struct that \<p> itself is the next text parent after the first
+    sentence. single_pass is ignored then.
+  */
+  const string file = "simpletest.engine.xml";
+  string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<FoLiA xmlns=\"http://ilk.uvt.nl/folia\" xml:id=\"eng\" version=\"2.5\">"
+    "<metadata type=\"native\"><annotations><token-annotation/>"
+    "<text-annotation/><sentence-annotation/><paragraph-annotation/>"
+    "</annotations></metadata>"
+    "<text xml:id=\"eng.text\">"
+    "<p xml:id=\"eng.p.0\"><s xml:id=\"eng.s.first\"><t>begin</t></s></p>"
+    "<p xml:id=\"eng.p.1\">";
+  for ( int i=0; i < 1500; ++i ){
+    xml += "<s xml:id=\"eng.s." + to_string(i) + "\"><t>zin</t></s>";
+  }
+  xml += "<w xml:id=\"eng.w.1\"><t>woord</t></w></p>"
+    "<p xml:id=\"eng.p.2\"><s xml:id=\"eng.s.last\"><t>einde</t></s></p>"
+    "</text></FoLiA>";
+  Document doc;
+  doc.read_from_string( xml );
+  doc.save( file );
+  for ( bool prefer_struct : { true, false } ){
+    vector<string> full = text_parent_ids( file, prefer_struct, false );
+    vector<string> single = text_parent_ids( file, prefer_struct, true );
+    if ( full.empty() || single != full ){
+      return false;
+    }
+    if ( prefer_struct
+	 && ( full.size() < 2 || full[1] != "eng.p.1" ) ){
+      return false;
+    }
+  }
+  return true;
+}
+
+string read_file( const string& name ){
+  /// return the contents of a file
+  ifstream is( name );
+  stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+bool file_input_test( const string& buffer ){
+  /// read the same document from a plain (memory mapped) file, a .gz file,
+  /// a gzipped file without extension and a .bz2 file with 2 streams
+  Document doc;
+  doc.read_from_string( buffer );
+  if ( !doc.save( "simpletest.input.xml" )
+       || !doc.save( "simpletest.input.xml.gz" ) ){
+    return false;
+  }
+  ofstream( "simpletest.input.gzipped", ios::binary )
+    << read_file( "simpletest.input.xml.gz" );
+  // a .bz2 file made of 2 concatenated streams, split halfway the text
+  string text = read_file( "simpletest.input.xml" );
+  size_t half = text.size() / 2;
+  ofstream( "simpletest.input.1", ios::binary ) << text.substr( 0, half );
+  ofstream( "simpletest.input.2", ios::binary ) << text.substr( half );
+  if ( !TiCC::bz2Compress( "simpletest.input.1", "simpletest.input.1.bz2" )
+       || !TiCC::bz2Compress( "simpletest.input.2", "simpletest.input.2.bz2" ) ){
+    return false;
+  }
+  ofstream( "simpletest.input.xml.bz2", ios::binary )
+    << read_file( "simpletest.input.1.bz2" )
+    << read_file( "simpletest.input.2.bz2" );
+  for ( const auto& name : { "simpletest.input.xml",
+			     "simpletest.input.xml.gz",
+			     "simpletest.input.gzipped",
+			     "simpletest.input.xml.bz2" } ){
+    Document in;
+    if ( !in.read_from_file( name )
+	 || in.xmlstring() != buffer ){
+      cout << name << " ";
+      return false;
+    }
+    Engine engine( name );
+    size_t count = 0;
+    while ( engine.get_node( "w" ) ){
+      ++count;
+    }
+    if ( count != in.words().size() ){
+      cout << name << " ";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool engine_flush_test(){
+  /// stream a document through an Engine that flushes its output as it goes.
+  /*!
+    the output must be the same as without flushing, and placeholders handed
+    out by Word::leftcontext() must survive the flushes.
+  */
+  const string in = "simpletest.engine.flush.xml";
+  Document doc;
+  doc.read_from_string( build_test_doc( "flush", 300 ) );
+  doc.save( in );
+  string results[2];
+  for ( int limit : { 0, 20 } ){
+    string out = "simpletest.engine.out" + to_string(limit) + ".xml";
+    Engine engine( in, out );
+    engine.set_flush_limit( limit );
+    vector<Word*> left;
+    int count = 0;
+    FoliaElement *e;
+    while ( ( e = engine.get_node( "w" ) ) ){
+      if ( left.empty() ){
+	left = dynamic_cast<Word*>(e)->leftcontext( 2, "BEGIN" );
+      }
+      if ( ++count == 700 ){
+	engine.flush();
+      }
+    }
+    engine.finish();
+    if ( count != 1500
+	 || left.size() != 2
+	 || left[0]->str() != "BEGIN" ){
+      return false;
+    }
+    results[limit > 0] = read_file( out );
+  }
+  return !results[0].empty() && results[0] == results[1];
+}
+
+void mark_pos( FoliaElement *e ){
+  /// give every Word below e a POS class derived from its text
+  for ( auto *w : e->select<Word>() ){
+    w->annotation<PosAnnotation>()->set_cls( "POS-" + w->str() );
+  }
+}
+
+bool engine_process_test(){
+  /// Engine::process() and TextEngine::process() with several threads must
+  /// give the same output as a get_node() loop, and stop cleanly on errors
+  const string in = "simpletest.engine.proc.xml";
+  Document doc;
+  doc.read_from_string( build_test_doc( "proc", 100 ) );
+  doc.save( in );
+  string ref;
+  {
+    Engine engine( in, "simpletest.engine.ref.xml" );
+    FoliaElement *e;
+    while ( ( e = engine.get_node( "s" ) ) ){
+      mark_pos( e );
+    }
+    engine.finish();
+    ref = read_file( "simpletest.engine.ref.xml" );
+  }
+  {
+    Engine engine( in, "simpletest.engine.par.xml" );
+    engine.process( "s", mark_pos, 3, 5 );
+    engine.finish();
+  }
+  {
+    TextEngine engine( in, "simpletest.engine.text.xml" );
+    engine.setup( "current", true );
+    engine.process( mark_pos, 3 );
+    engine.finish();
+  }
+  if ( ref.find( "POS-zin" ) == string::npos
+       || read_file( "simpletest.engine.par.xml" ) != ref
+       || read_file( "simpletest.engine.text.xml" ) != ref ){
+    return false;
+  }
+  // a failing handler stops the pool, and its exception is passed on
+  atomic<int> calls( 0 );
+  auto failing = [&]( FoliaElement *e ){
+    if ( ++calls == 10 ){
+      throw runtime_error( "handler failed" );
+    }
+    mark_pos( e );
+  };
+  string mess;
+  {
+    Engine engine( in, "simpletest.engine.err.xml" );
+    try {
+      engine.process( "s", failing, 3 );
+    }
+    catch ( const runtime_error& e ){
+      mess = e.what();
+    }
+  }
+  return mess == "handler failed";
+}
+
+vector<FoliaElement*> all_nodes( Engine& engine,
+				 const Engine::NodeMatcher& matcher ){
+  /// return all nodes the Engine finds with matcher
+  vector<FoliaElement*> result;
+  FoliaElement *e;
+  while ( ( e = engine.get_node( matcher ) ) ){
+    result.push_back( e );
+  }
+  return result;
+}
+
+bool node_matcher_test(){
+  /// match nodes from a '|' list with a PI, from (std::)sets of ElementTypes
+  /// and with one NodeMatcher shared by two Engines
+  const string in = "simpletest.engine.match.xml";
+  string xml = build_test_doc( "match", 5 );
+  const string text_tag = "<text xml:id=\"match.text\">";
+  xml.insert( xml.find( text_tag ) + text_tag.size(), "<?test-pi value?>" );
+  Document doc;
+  doc.read_from_string( xml );
+  doc.save( in );
+  Engine::NodeMatcher with_pi( "w|PI" );
+  Engine e1( in );
+  vector<FoliaElement*> found = all_nodes( e1, with_pi );
+  if ( !with_pi.match_pi()
+       || found.size() != 26
+       || !found[0]->isinstance( ProcessingInstruction_t )
+       || !found[1]->isinstance( Word_t ) ){
+    return false;
+  }
+  Engine::NodeMatcher from_set( set<ElementType>{ Sentence_t } );
+  Engine::NodeMatcher from_types( ElementTypeSet{ Word_t, Sentence_t } );
+  Engine e2( in );
+  Engine e3( in );
+  if ( from_set.tags() != "s"
+       || from_types.match_pi()
+       || all_nodes( e2, from_set ).size() != 5
+       || all_nodes( e3, from_types ).size() != 5 ){
+    return false;
+  }
+  // the matcher is bound to the reader of each Engine in turn
+  Engine::NodeMatcher words( "w" );
+  Engine e4( in );
+  Engine e5( in );
+  for ( int i=0; i < 26; ++i ){
+    FoliaElement *w4 = e4.get_node( words );
+    FoliaElement *w5 = e5.get_node( words );
+    if ( ( i == 25 ) != ( w4 == 0 )
+	 || ( w4 == 0 ) != ( w5 == 0 )
+	 || ( w4 && w4->id() != w5->id() ) ){
+      return false;
+    }
+  }
+  return true;
+}
+
+string index_key( const FoliaElement *e ){
+  /// the identity of an indexed node, in a Document and its re-read copy
+  return e->id() + "/" + e->str();
+}
+
+bool same_indexes( const Document& doc ){
+  /// compare the (cached) lists of doc with those of a re-read copy
+  Document fresh;
+  fresh.read_from_string( doc.xmlstring() );
+  vector<string> got;
+  vector<string> wanted;
+  for ( const auto *w : doc.words() ){
+    got.push_back( index_key( w ) );
+  }
+  for ( const auto *w : fresh.words() ){
+    wanted.push_back( index_key( w ) );
+  }
+  for ( const auto *s : doc.sentences() ){
+    got.push_back( index_key( s ) );
+  }
+  for ( const auto *s : fresh.sentences() ){
+    wanted.push_back( index_key( s ) );
+  }
+  for ( const auto *p : doc.paragraphs() ){
+    got.push_back( p->id() );
+  }
+  for ( const auto *p : fresh.paragraphs() ){
+    wanted.push_back( p->id() );
+  }
+  return got == wanted;
+}
+
+Sentence *new_sentence( Document& doc,
+			const string& id,
+			const vector<string>& words ){
+  /// create a detached Sentence with some Words
+  Sentence *sent = new Sentence( getArgs( "xml:id='" + id + "'" ), &doc );
+  for ( size_t i=0; i < words.size(); ++i ){
+    KWargs args;
+    args["xml:id"] = id + ".w." + to_string(i+1);
+    args["text"] = words[i];
+    sent->addWord( args );
+  }
+  return sent;
+}
+
+bool index_edit_test( size_t sentences ){
+  /// edit a Document after its Word, Sentence and Paragraph lists are
+  /// built, and check the lists after every step
+  Document doc;
+  doc.read_from_string( build_test_doc( "idx", sentences ) );
+  if ( doc.words().size() != 5 * sentences
+       || doc.sentences().size() != sentences
+       || doc.paragraphs().size() != 1 ){
+    cout << "wrong initial lists" << endl;
+    return false;
+  }
+  FoliaElement *par = doc.paragraphs(0);
+  // annotations don't touch the lists
+  for ( auto *w : doc.words() ){
+    KWargs args;
+    args["class"] = "N";
+    args["set"] = "adhocpos";
+    w->addPosAnnotation( args );
+  }
+  if ( !same_indexes( doc ) ){
+    cout << "annotations" << endl;
+    return false;
+  }
+  // append a Sentence at the end
+  par->append( new_sentence( doc, "idx.end", { "aan", "het", "eind" } ) );
+  if ( !same_indexes( doc ) || doc.rwords(0)->str() != "eind" ){
+    cout << "append at the end" << endl;
+    return false;
+  }
+  // append a Word to the first Sentence
+  KWargs args;
+  args["xml:id"] = "idx.extra";
+  args["text"] = "extra";
+  doc.sentences(0)->addWord( args );
+  if ( !same_indexes( doc ) || doc.words(5)->str() != "extra" ){
+    cout << "append in the middle" << endl;
+    return false;
+  }
+  // insert a Sentence after the second one
+  par->insert_after( doc.sentences(1),
+		     new_sentence( doc, "idx.ins", { "ingevoegd" } ) );
+  if ( !same_indexes( doc ) || doc.sentences(2)->id() != "idx.ins" ){
+    cout << "insert_after" << endl;
+    return false;
+  }
+  // replace a Word
+  Word *old = doc.words(3);
+  args["xml:id"] = "idx.new";
+  args["text"] = "nieuw";
+  Word *repl = new Word( args, &doc );
+  old->parent()->replace( old, repl );
+  old->destroy();
+  if ( !same_indexes( doc ) || doc.words(3) != repl ){
+    cout << "replace" << endl;
+    return false;
+  }
+  // remove a Sentence in the middle
+  Sentence *gone = doc.sentences(1);
+  par->remove( gone );
+  gone->destroy();
+  if ( !same_indexes( doc ) ){
+    cout << "remove" << endl;
+    return false;
+  }
+  // add a Paragraph at the end
+  Paragraph *extra = new Paragraph( getArgs( "xml:id='idx.p.2'" ), &doc );
+  extra->append( new_sentence( doc, "idx.p.2.s", { "nieuwe", "alinea" } ) );
+  par->parent()->append( extra );
+  if ( !same_indexes( doc ) || doc.paragraphs().back() != extra ){
+    cout << "new paragraph" << endl;
+    return false;
+  }
+  return true;
+}
+
+/// a FoLiA document with Sentences inside Quotes, and Words directly in a
+/// Quote
+const string buffer_quotes = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<FoLiA xmlns=\"http://ilk.uvt.nl/folia\" xml:id=\"nav\" version=\"2.5\">"
+  "<metadata type=\"native\"><annotations><token-annotation/>"
+  "<text-annotation/><sentence-annotation/><paragraph-annotation/>"
+  "<quote-annotation/></annotations></metadata>"
+  "<text xml:id=\"nav.text\"><p xml:id=\"nav.p.1\">"
+  "<s xml:id=\"nav.s.1\">"
+  "<w xml:id=\"nav.w.1\"><t>Hij</t></w><w xml:id=\"nav.w.2\"><t>zei</t></w>"
+  "<quote xml:id=\"nav.q.1\"><s xml:id=\"nav.q.1.s.1\">"
+  "<w xml:id=\"nav.w.3\"><t>kom</t></w><w xml:id=\"nav.w.4\"><t>hier</t></w>"
+  "</s></quote>"
+  "<w xml:id=\"nav.w.5\"><t>en</t></w><w xml:id=\"nav.w.6\"><t>ging</t></w>"
+  "</s>"
+  "<s xml:id=\"nav.s.2\">"
+  "<quote xml:id=\"nav.q.2\"><w xml:id=\"nav.w.7\"><t>ja</t></w></quote>"
+  "<w xml:id=\"nav.w.8\"><t>dus</t></w>"
+  "</s></p></text></FoLiA>";
+
+vector<Word*> expected_context( const vector<Word*>& words, size_t pos,
+				size_t left, size_t right ){
+  /// the words around words[pos], padded with 0 at both ends
+  vector<Word*> result;
+  for ( size_t i=0; i < left + right + 1; ++i ){
+    size_t index = pos + i;
+    result.push_back( ( index >= left && index - left < words.size() )
+		      ? words[index - left] : 0 );
+  }
+  return result;
+}
+
+bool navigation_ok( const Document& doc ){
+  /// compare Word::next(), previous() and the contexts with a search in
+  /// the words of the Sentence and of the Document
+  vector<Word*> words = doc.words();
+  for ( size_t i=0; i < words.size(); ++i ){
+    Word *w = words[i];
+    vector<Word*> in_sent = w->sentence()->words();
+    auto it = find( in_sent.begin(), in_sent.end(), w );
+    Word *prev = ( it == in_sent.begin() ) ? 0 : *(it-1);
+    Word *next = ( it+1 == in_sent.end() ) ? 0 : *(it+1);
+    if ( w->previous() != prev || w->next() != next ){
+      cout << "wrong neighbours for " << w->id() << endl;
+      return false;
+    }
+    vector<Word*> context = expected_context( words, i, 2, 2 );
+    vector<Word*> left( context.begin(), context.begin() + 2 );
+    vector<Word*> right( context.begin() + 3, context.end() );
+    if ( w->context( 2 ) != context
+	 || w->leftcontext( 2 ) != left
+	 || w->rightcontext( 2 ) != right ){
+      cout << "wrong context for " << w->id() << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+string next_str( const Document& doc, const string& id ){
+  /// the text of the next Word of id, or "-" when there is none
+  Word *next = dynamic_cast<Word*>( doc[id] )->next();
+  return next ? next->str() : "-";
+}
+
+bool word_navigation_test(){
+  /// check the navigation between Words in nested Quotes, and after
+  /// editing the Document
+  Document doc;
+  doc.read_from_string( buffer_quotes );
+  if ( !navigation_ok( doc ) ){
+    return false;
+  }
+  // the Word before the Quote continues into it, the last Word of the
+  // quoted Sentence doesn't continue out of it
+  if ( next_str( doc, "nav.w.2" ) != "kom"
+       || next_str( doc, "nav.w.4" ) != "-"
+       || next_str( doc, "nav.w.6" ) != "-"
+       || next_str( doc, "nav.w.7" ) != "dus"
+       || dynamic_cast<Word*>( doc["nav.w.3"] )->previous() != 0 ){
+    cout << "unexpected neighbours in nested quotes" << endl;
+    return false;
+  }
+  // append a Word to the quoted Sentence
+  KWargs args;
+  args["xml:id"] = "nav.w.9";
+  args["text"] = "nu";
+  dynamic_cast<Sentence*>( doc["nav.q.1.s.1"] )->addWord( args );
+  if ( !navigation_ok( doc ) || next_str( doc, "nav.w.4" ) != "nu" ){
+    cout << "after addWord" << endl;
+    return false;
+  }
+  // insert a Word in front of the Quote. insert_after() leaves setting
+  // the parent to the caller, like Sentence::insertword() does
+  args["xml:id"] = "nav.w.10";
+  args["text"] = "luid";
+  Word *loud = new Word( args, &doc );
+  loud->set_parent( doc["nav.s.1"] );
+  doc["nav.s.1"]->insert_after( doc["nav.w.2"], loud );
+  if ( !navigation_ok( doc ) || next_str( doc, "nav.w.10" ) != "kom" ){
+    cout << "after insert_after" << endl;
+    return false;
+  }
+  // remove the first quoted Word
+  FoliaElement *gone = doc["nav.w.3"];
+  gone->parent()->remove( gone );
+  gone->destroy();
+  if ( !navigation_ok( doc ) || next_str( doc, "nav.w.10" ) != "hier" ){
+    cout << "after remove" << endl;
+    return false;
+  }
+  // insert a Sentence with a Quote between the two Sentences
+  Sentence *sent = new_sentence( doc, "nav.s.3", { "toen" } );
+  Quote *quote = new Quote( getArgs( "xml:id='nav.q.3'" ), &doc );
+  quote->append( new_sentence( doc, "nav.q.3.s.1", { "stil", "!" } ) );
+  sent->append( quote );
+  sent->set_parent( doc["nav.p.1"] );
+  doc["nav.p.1"]->insert_after( doc["nav.s.1"], sent );
+  if ( !navigation_ok( doc )
+       || next_str( doc, "nav.s.3.w.1" ) != "stil"
+       || next_str( doc, "nav.q.3.s.1.w.2" ) != "-"
+       || next_str( doc, "nav.w.6" ) != "-" ){
+    cout << "after inserting a Sentence" << endl;
+    return false;
+  }
+  return same_indexes( doc );
+}
+
 int main() {
   cout << "checking sanity" << endl;
   cout << "Type Hierarchy" << endl;
@@ -150,6 +815,412 @@ int main() {
     return EXIT_FAILURE;
   }
 
+  cout << " Reading a document in arena mode: ";
+  string buffer = d.xmlstring();
+  Document *ad = new Document();
+  ad->setmode( "arena" );
+  ad->read_from_string( buffer );
+  if ( ad->words().size() != 5 || ad->xmlstring() != buffer ){
+    cout << "arena document differs from the original" << endl;
+    return EXIT_FAILURE;
+  }
+  ad->words(2)->destroy();
+  // Words added after parsing live on the heap, in the same tree
+  KWargs heap_args;
+  heap_args["text"] = "erbij";
+  ad->sentences(0)->addWord( heap_args );
+  delete ad;
+  cout << "OK" << endl;
+
+  cout << " Reading plain, mapped and compressed files: ";
+  if ( !file_input_test( buffer ) ){
+    cout << "differs from the original" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Lazy selection: ";
+  vector<Word*> wv = d.doc()->select<Word>();
+  size_t pos = 0;
+  for ( auto *w : d.doc()->iter<Word>() ){
+    if ( pos >= wv.size() || w != wv[pos++] ){
+      cout << "iter<Word>() differs from select<Word>()" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( pos != wv.size()
+       || d.doc()->iter<Word>( SELECT_FLAGS::LOCAL ).begin()
+       != d.doc()->iter<Word>( SELECT_FLAGS::LOCAL ).end() ){
+    cout << "iter<Word>() differs from select<Word>()" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Concurrent parsing in 16 threads: ";
+  vector<string> corpus = { buffer,
+			    build_test_doc( "small", 3 ),
+			    build_test_doc( "large", 200 ) };
+  if ( !concurrent_parse_test( corpus ) ){
+    cout << "results differ from a serial run" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Releasing interned values: ";
+  if ( !string_pool_test() ){
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Loading fragments through a FragmentIndex: ";
+  if ( !fragment_index_test( build_test_doc( "fragments", 100 ) ) ){
+    cout << "fragments differ from the full document" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " TextEngine text parents in a single pass: ";
+  if ( !text_engine_test() ){
+    cout << "single pass and full scan differ" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Flushing Engine output: ";
+  if ( !engine_flush_test() ){
+    cout << "flushed output differs" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Processing Engine nodes in 3 threads: ";
+  if ( !engine_process_test() ){
+    cout << "results differ from a get_node() loop" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Matching Engine nodes with a NodeMatcher: ";
+  if ( !node_matcher_test() ){
+    cout << "wrong nodes matched" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Reloading a binary snapshot: ";
+  {
+    Document doc;
+    doc.read_from_string( build_test_doc( "binary", 20 ) );
+    doc.save_binary( "simpletest.bin" );
+    Document copy;
+    copy.read_binary( "simpletest.bin" );
+    if ( copy.xmlstring() != doc.xmlstring()
+	 || copy.words().size() != doc.words().size() ){
+      cout << "the reloaded document differs" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " Querying a DocumentView: ";
+  {
+    Document doc;
+    doc.read_from_string( build_test_doc( "view", 20 ) );
+    DocumentView::write( doc, "simpletest.view" );
+    DocumentView view( "simpletest.view" );
+    vector<Word*> words = doc.words();
+    vector<DocumentView::Node> vwords = view.words();
+    Sentence *last = doc.sentences().back();
+    DocumentView::Node vlast = view.index( last->id() );
+    if ( vwords.size() != words.size()
+	 || vwords[7].id() != words[7]->id()
+	 || vwords[7].text() != words[7]->str()
+	 || view.sentences().size() != doc.sentences().size()
+	 || !vlast
+	 || vlast.text() != last->str()
+	 || vlast.select( PosAnnotation_t ).size() != 5
+	 || vlast.select( PosAnnotation_t )[0].cls() != "WORD"
+	 || vlast.select( PosAnnotation_t, "adhocpos" ).size() != 5
+	 || vlast.parent().element_id() != Paragraph_t
+	 || view.index( "nonexisting" ) ){
+      cout << "the view differs from the document" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " Type lookup tables: ";
+  for ( const auto& [tag,et] : s_et_map ){
+    if ( stringToElementType( tag ) != et
+	 || toString( et ) != tag ){
+      cout << "lookup of '" << tag << "' failed" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( stringToElementType( "alignment" ) != Relation_t
+       || !isSubClass( Word_t, AbstractStructureElement_t )
+       || isSubClass( Word_t, AbstractSpanAnnotation_t ) ){
+    cout << "the type tables are inconsistent" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " KWargs lookups: ";
+  {
+    KWargs args = getArgs( "set='s', class='c', xml:id='x.1'" );
+    args.insert( make_pair( string("class"), string("ignored") ) );
+    args["annotator"] = "me";
+    string order;
+    for ( const auto& [att,val] : args ){
+      order += att + "=" + val + ";";
+    }
+    if ( order != "annotator=me;class=c;set=s;xml:id=x.1;"
+	 || args.extract( "set" ) != "s"
+	 || args.is_present( "set" )
+	 || args.count( "xml:id" ) != 1
+	 || args.size() != 3 ){
+      cout << "unexpected KWargs content: " << order << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " ElementTypeSet filters: ";
+  {
+    Document doc;
+    doc.read_from_string( build_test_doc( "ets", 3 ) );
+    const set<ElementType> old_style = { Word_t, Sentence_t };
+    ElementTypeSet types = { Sentence_t, Word_t };
+    vector<ElementType> order( types.begin(), types.end() );
+    if ( order != vector<ElementType>{ Sentence_t, Word_t }
+	 || !types.contains( Word_t )
+	 || types.contains( Paragraph_t )
+	 || doc.doc()->select_set( types, "", default_ignore ).size()
+	 != doc.doc()->select_set( old_style, "", {} ).size()
+	 || doc.doc()->select<Word>( set<ElementType>{ Original_t } ).size()
+	 != doc.words().size() ){
+      cout << "ElementTypeSet selection differs" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " Cached text after edits: ";
+  {
+    Document doc;
+    doc.set_textcache( true );
+    doc.read_from_string( build_test_doc( "cache", 2 ) );
+    Paragraph *par = doc.paragraphs()[0];
+    Sentence *sent = doc.sentences()[1];
+    string before = par->str();
+    if ( before != par->str() ){
+      cout << "cached text differs" << endl;
+      return EXIT_FAILURE;
+    }
+    Word *extra = sent->addWord( getArgs( "text='extra'" ) );
+    string added = par->str();
+    sent->remove( extra );
+    extra->destroy();
+    if ( added != before + " extra"
+	 || sent->str() != "Dit is zin 1 ."
+	 || par->str() != before ){
+      cout << "stale text after edits: '" << added << "'" << endl;
+      return EXIT_FAILURE;
+    }
+    // changing attributes must also drop the cached text
+    Document plain;
+    plain.setmode( "nochecktext" );
+    plain.read_from_string( build_test_doc( "cache", 2 ) );
+    doc.setmode( "nochecktext" );
+    for ( Document *d : { &doc, &plain } ){
+      Sentence *s = d->sentences()[1];
+      s->words()[0]->index(0)->set_cls( "other" );
+      s->words()[2]->set_space( false );
+    }
+    vector<string> cached = { par->str(), sent->str(),
+			      sent->words()[0]->str() };
+    vector<string> uncached = { plain.paragraphs()[0]->str(),
+				plain.sentences()[1]->str(),
+				plain.sentences()[1]->words()[0]->str() };
+    if ( cached != uncached
+	 || cached[1] != "is zin1 ." ){
+      cout << "stale text after attribute changes: '" << cached[1]
+	   << "' instead of '" << uncached[1] << "'" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " Text validation of a whole document: ";
+  {
+    Document doc;
+    doc.setmode( "nochecktext" );
+    doc.read_from_string( buffer_bad_text );
+    string mess;
+    try {
+      doc.validate_text();
+    }
+    catch ( const InconsistentText& e ){
+      mess = e.what();
+    }
+    if ( mess.find( "3 inconsistencies" ) == string::npos
+	 || mess.find( "s.2" ) == string::npos
+	 || mess.find( "s.3" ) == string::npos ){
+      cout << "not all failures reported: " << mess << endl;
+      return EXIT_FAILURE;
+    }
+    Document good;
+    good.read_from_string( build_test_doc( "valid", 3 ) );
+    good.validate_text();
+  }
+  cout << "OK" << endl;
+
+  cout << " Only changed text is checked on output: ";
+  {
+    Document doc;
+    doc.read_from_string( build_test_doc( "dirty", 2 ) );
+    Sentence *first = doc.sentences()[0];
+    Sentence *second = doc.sentences()[1];
+    if ( !first->text_checked() || !doc.paragraphs()[0]->text_checked() ){
+      cout << "parsed text not marked as checked" << endl;
+      return EXIT_FAILURE;
+    }
+    first->addWord( getArgs( "text='extra'" ) );
+    if ( first->text_checked()
+	 || doc.paragraphs()[0]->text_checked()
+	 || !second->text_checked() ){
+      cout << "wrong nodes marked as changed" << endl;
+      return EXIT_FAILURE;
+    }
+    doc.xmlstring();
+    if ( !first->text_checked() ){
+      cout << "output didn't check the changed sentence" << endl;
+      return EXIT_FAILURE;
+    }
+    Document bad;
+    bad.setmode( "nochecktext" );
+    bad.read_from_string( buffer_bad_text );
+    bad.set_checktext( true );
+    bool failed = false;
+    try {
+      bad.xmlstring();
+    }
+    catch ( const InconsistentText& ){
+      failed = true;
+    }
+    bad.set_trusted_output( true );
+    if ( !failed || bad.xmlstring().empty() ){
+      cout << "TRUSTEDOUTPUT mode not respected" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " Offset validation in document order: ";
+  {
+    string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<FoLiA xmlns=\"http://ilk.uvt.nl/folia\" xml:id=\"off\" version=\"2.5\">"
+      "<metadata type=\"native\"><annotations><token-annotation/>"
+      "<text-annotation/><sentence-annotation/></annotations></metadata>"
+      "<text xml:id=\"off.text\">";
+    for ( int i=0; i < 500; ++i ){
+      string sid = "s." + to_string(i);
+      // two words with a wrong offset, only the first one is reported
+      string off = ( i == 321 || i == 400 ) ? "5" : "4";
+      xml += "<s xml:id=\"" + sid + "\"><t>aap noot</t>"
+	"<w xml:id=\"" + sid + ".w.1\"><t offset=\"0\">aap</t></w>"
+	"<w xml:id=\"" + sid + ".w.2\"><t offset=\"" + off + "\">noot</t></w>"
+	"</s>";
+    }
+    xml += "</text></FoLiA>";
+    string mess;
+    try {
+      Document doc;
+      doc.read_from_string( xml );
+    }
+    catch ( const UnresolvableTextContent& e ){
+      mess = e.what();
+    }
+    if ( mess.find( "ID=s.321.w.2" ) == string::npos ){
+      cout << "wrong offset error: " << mess << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " Id index: ";
+  {
+    Document doc;
+    doc.read_from_string( buffer );
+    FoliaElement *text = doc.sentences(0)->parent();
+    for ( int i=0; i < 3000; ++i ){
+      KWargs args;
+      args["xml:id"] = "extra.s." + to_string(i);
+      text->append( new Sentence( args, &doc ) );
+    }
+    string_view key = "extra.s.1234 and more";
+    FoliaElement *s = doc[key.substr( 0, 12 )];
+    if ( !s || s->id() != "extra.s.1234" || doc.index( "extra.s.3000" ) ){
+      cout << "wrong lookup" << endl;
+      return EXIT_FAILURE;
+    }
+    bool dup = false;
+    try {
+      new Sentence( getArgs( "xml:id='extra.s.17'" ), &doc );
+    }
+    catch ( const DuplicateIDError& ){
+      dup = true;
+    }
+    if ( !dup || doc["extra.s.17"]->parent() != text ){
+      cout << "duplicate id not detected" << endl;
+      return EXIT_FAILURE;
+    }
+    s->destroy();
+    if ( doc["extra.s.1234"] ){
+      cout << "destroyed node still indexed" << endl;
+      return EXIT_FAILURE;
+    }
+    FoliaElement *again = new Sentence( getArgs( "xml:id='extra.s.1234'" ),
+					&doc );
+    text->append( again );
+    if ( doc["extra.s.1234"] != again
+	 || doc["extra.s.2999"]->id() != "extra.s.2999" ){
+      cout << "id not re-usable" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  cout << "OK" << endl;
+
+  cout << " Word index after edits: ";
+  Document ed;
+  ed.read_from_string( buffer );
+  if ( ed.words().size() != 5 ){
+    cout << "wrong number of words" << endl;
+    return EXIT_FAILURE;
+  }
+  kw.clear();
+  kw["text"] = "extra";
+  ed.sentences(0)->addWord( kw );
+  Word *first = ed.words(0);
+  first->parent()->remove( first );
+  first->destroy();
+  if ( ed.words().size() != 5
+       || ed.rwords(0)->str() != "extra"
+       || ed.words(0)->str() != "site" ){
+    cout << "stale word index" << endl;
+    return EXIT_FAILURE;
+  }
+  if ( !index_edit_test( 4 ) || !index_edit_test( 400 ) ){
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
+  cout << " Word navigation in nested quotes: ";
+  if ( !word_navigation_test() ){
+    return EXIT_FAILURE;
+  }
+  cout << "OK" << endl;
+
   assert( ( isSubClass<AbstractWord,Word>() == 0 ) );
   assert( ( isSubClass<Word,AbstractWord>() == 1 ) );
   assert( ( isSubClass<AbstractStructureElement,Word>() == 0 ) );